@@ -0,0 +1,62 @@
+//-----------------------------------------------------------------------------
+// custard/audio.hpp
+//-----------------------------------------------------------------------------
+// Each mixing operation mixes 512 samples at 32768 Hz, 15.6 ms of output.
+// The rate printed is milliseconds of voice output mixed per millisecond,
+// i.e. the number of voices this machine could mix in real time. Decoding
+// is timed per 1K block of IMA-ADPCM, 2041 samples.
+//-----------------------------------------------------------------------------
+
+#include <custard/audio.hpp>
+
+#include "bench.hpp"
+
+using namespace custard;
+
+static int16_t wave16[4096];
+static uint8_t wave8[4096];
+static int16_t left[512], right[512];
+
+// Looping voices of both widths, at rates from 8 to 48 kHz
+template <int Voices> static void mix(long n) {
+  static audio::mixer<Voices> m(32768);
+  if (!m.playing(0)) {
+    for (int i = 0; i < 4096; ++i) {
+      uint32_t r = uint32_t(i) * 2654435761u;
+      wave16[i] = int16_t(r >> 16);
+      wave8[i] = uint8_t(r >> 24);
+    }
+    audio::clip c16 = {wave16, 8192, 4096, 0, 1, 16, audio::pcm, 2};
+    audio::clip c8 = {wave8, 4096, 4096, 0, 1, 8, audio::pcm, 1};
+    for (int v = 0; v < Voices; ++v) {
+      audio::clip& c = v & 1 ? c8 : c16;
+      c.rate = 8000 + v * 40000 / Voices;
+      m.play(c, 64 + v * 4, v * 8 & 127, true, 100);
+    }
+  }
+  for (long i = 0; i < n; ++i) {
+    m.mix(left, right, 512);
+    bench::keep(left);
+    bench::keep(right);
+  }
+  bench::rate(Voices * 512 / 32.768, "voices/ms");
+}
+
+BENCH(audio, mix_1_voice) { mix<1>(n); }
+BENCH(audio, mix_16_voices) { mix<16>(n); }
+BENCH(audio, mix_64_voices) { mix<64>(n); }
+
+BENCH(audio, decode_block) {
+  static uint8_t block[1024];
+  static int16_t out[2041];
+  for (int i = 0; i < 1024; ++i)
+    block[i] = uint8_t(uint32_t(i) * 2654435761u >> 24);
+  block[2] = 30;
+  block[3] = 0;
+  for (long i = 0; i < n; ++i) {
+    bench::launder(block);
+    audio::decode_block(block, 1024, out);
+    bench::keep(out);
+  }
+  bench::rate(2041, "samples/ms");
+}
@@ -0,0 +1,107 @@
+//-----------------------------------------------------------------------------
+// custard/batch.hpp
+//-----------------------------------------------------------------------------
+// Each kernel is paired with the per-element loop over an array of vec2 that
+// it replaces, over 1024 elements; times are per element. The kernels are
+// unrolled for ldm/stm on the ARM9; at -O2 the host compiler only vectorizes
+// simple loops, so here the plain vec2 clamp can come out ahead.
+//-----------------------------------------------------------------------------
+
+#include <custard/batch.hpp>
+
+#include "bench.hpp"
+
+using namespace custard;
+
+const size_t count = 1024;
+
+static vec2_array<q12, count> soa_p, soa_v;
+static vec2<q12> aos_p[count], aos_v[count];
+
+static void fill() {
+  soa_p.clear();
+  soa_v.clear();
+  for (size_t i = 0; i < count; ++i) {
+    aos_p[i] = vec2<q12>(q12(int(i % 256)), q12(int(i / 4)));
+    aos_v[i] = vec2<q12>(q12::from_raw(int(i) * 13 - 6000), 1);
+    soa_p.push_back(aos_p[i]);
+    soa_v.push_back(aos_v[i]);
+  }
+}
+
+BENCH(batch, integrate) {
+  fill();
+  for (long i = 0; i < n; i += count) {
+    batch::integrate(soa_p, soa_v, 0.0166_q12);
+    bench::launder(soa_p);
+  }
+}
+
+BENCH(batch, integrate_vec2) {
+  fill();
+  for (long i = 0; i < n; i += count) {
+    for (size_t j = 0; j < count; ++j)
+      aos_p[j] = aos_p[j] + aos_v[j] * 0.0166_q12;
+    bench::launder(aos_p);
+  }
+}
+
+BENCH(batch, transform) {
+  fill();
+  for (long i = 0; i < n; i += count) {
+    batch::transform(soa_p, 0.99_q12, -0.01_q12, 0.01_q12, 0.99_q12,
+                     vec2<q12>(1, 1));
+    bench::launder(soa_p);
+  }
+}
+
+BENCH(batch, transform_vec2) {
+  fill();
+  q12 a = 0.99_q12, b = -0.01_q12, c = 0.01_q12, d = 0.99_q12;
+  vec2<q12> t(1, 1);
+  for (long i = 0; i < n; i += count) {
+    for (vec2<q12>& p : aos_p)
+      p = vec2<q12>(a * p.x + b * p.y, c * p.x + d * p.y) + t;
+    bench::launder(aos_p);
+  }
+}
+
+BENCH(batch, clamp) {
+  fill();
+  for (long i = 0; i < n; i += count) {
+    batch::clamp(soa_p, vec2<q12>(8, 8), vec2<q12>(248, 184));
+    bench::launder(soa_p);
+  }
+}
+
+BENCH(batch, clamp_vec2) {
+  fill();
+  vec2<q12> lo(8, 8), hi(248, 184);
+  for (long i = 0; i < n; i += count) {
+    for (vec2<q12>& p : aos_p) p = p.max(lo).min(hi);
+    bench::launder(aos_p);
+  }
+}
+
+BENCH(batch, bounds) {
+  fill();
+  vec2<q12> lo, hi;
+  for (long i = 0; i < n; i += count) {
+    batch::bounds(soa_p, lo, hi);
+    bench::launder(soa_p);
+  }
+  bench::keep(lo);
+  bench::keep(hi);
+}
+
+BENCH(batch, bounds_vec2) {
+  fill();
+  vec2<q12> lo, hi;
+  for (long i = 0; i < n; i += count) {
+    lo = hi = aos_p[0];
+    for (vec2<q12> p : aos_p) { lo = lo.min(p); hi = hi.max(p); }
+    bench::launder(aos_p);
+  }
+  bench::keep(lo);
+  bench::keep(hi);
+}
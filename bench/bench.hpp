@@ -0,0 +1,82 @@
+//-----------------------------------------------------------------------------
+// Custard host benchmark framework
+//-----------------------------------------------------------------------------
+// A benchmark is a function registered with BENCH that performs an operation
+// n times; the runner picks n so that a run lasts long enough to time, and
+// reports the best of several runs in nanoseconds per operation. Results
+// must be passed to bench::keep so that the compiler cannot discard the
+// work. Set-up done before the loop is included in the time, so keep it
+// small or amortize it over n. A benchmark may also report one other
+// quantity with bench::metric, or a throughput with bench::rate.
+//
+//   BENCH(q12, multiply) {
+//     q12 a = 1.001_q12, x = 1;
+//     for (long i = 0; i < n; ++i) x = x * a;
+//     bench::keep(x);
+//   }
+//-----------------------------------------------------------------------------
+
+#ifndef CUSTARD_BENCH_HPP
+#define CUSTARD_BENCH_HPP
+
+#include <cstring>
+
+namespace bench {
+
+  struct benchmark {
+    const char* group;
+    const char* name;
+    void (*run)(long n);
+    benchmark* next;
+  };
+
+  inline benchmark* first = nullptr;
+  inline benchmark** last = &first;
+
+  struct registrar {
+    registrar(benchmark& b) { *last = &b; last = &b.next; }
+  };
+
+  inline double metric_value = 0;
+  inline const char* metric_unit = nullptr;
+  inline bool metric_per_ms = false;
+
+  /// \brief Report a quantity other than time, e.g. bytes per frame, to be
+  /// printed with the result (it is not compared with the baseline)
+  inline void metric(double value, const char* unit) {
+    metric_value = value;
+    metric_unit = unit;
+    metric_per_ms = false;
+  }
+  /// \brief Report \p amount of work done per operation, to be printed as
+  /// a rate per millisecond, e.g. rate(16, "voices/ms")
+  inline void rate(double amount, const char* unit) {
+    metric(amount, unit);
+    metric_per_ms = true;
+  }
+
+  /// Make the compiler assume that \p v is used
+  template <class T> inline void keep(const T& v) {
+    asm volatile("" : : "r,m"(v) : "memory");
+  }
+  /// Make the compiler forget what it knows about \p v
+  template <class T> inline void launder(T& v) {
+    if constexpr (sizeof(T) <= sizeof(long)) {
+      long r = 0;
+      std::memcpy(&r, &v, sizeof(T));
+      asm volatile("" : "+r"(r));
+      std::memcpy(static_cast<void*>(&v), &r, sizeof(T));
+    }
+    else asm volatile("" : : "r"(&v) : "memory");
+  }
+}
+
+#define BENCH(group, name) \
+  static void bench_##group##_##name(long n); \
+  static bench::benchmark bench_##group##_##name##_b = \
+    {#group, #name, bench_##group##_##name, nullptr}; \
+  static bench::registrar bench_##group##_##name##_r( \
+    bench_##group##_##name##_b); \
+  static void bench_##group##_##name(long n)
+
+#endif
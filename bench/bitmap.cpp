@@ -0,0 +1,123 @@
+//-----------------------------------------------------------------------------
+// custard/bitmap.hpp
+//-----------------------------------------------------------------------------
+// Each operation is one pixel drawn, so 1000 / (ns/op) is the fill rate in
+// Mpixel/s. The *_pixels cases draw the same pixels one at a time through
+// canvas::pixel, the loop the word-at-a-time rows replace.
+//-----------------------------------------------------------------------------
+
+#include <custard/bitmap.hpp>
+
+#include "bench.hpp"
+
+using namespace custard;
+
+alignas(32) static uint16_t surface[256 * 192];
+alignas(32) static uint16_t sprite[64 * 64];
+
+static bitmap::image sprite_image() {
+  for (int i = 0; i < 64 * 64; ++i) sprite[i] = uint16_t(i % 61 ? i : 0);
+  return {sprite, 64, 64, 64};
+}
+
+BENCH(bitmap, clear) {
+  bitmap::canvas c(surface);
+  for (long i = 0; i < n; i += 256 * 192) {
+    c.clear(uint16_t(i));
+    bench::launder(surface);
+  }
+  bench::keep(surface);
+}
+
+BENCH(bitmap, clear_pixels) {
+  bitmap::canvas c(surface);
+  for (long i = 0; i < n; i += 256 * 192) {
+    for (int y = 0; y < 192; ++y)
+      for (int x = 0; x < 256; ++x) c.pixel(x, y, uint16_t(i));
+    bench::launder(surface);
+  }
+  bench::keep(surface);
+}
+
+// A 61x40 rectangle at an odd x, so that both ends of each row are halfwords
+BENCH(bitmap, fill_odd) {
+  bitmap::canvas c(surface);
+  for (long i = 0; i < n; i += 61 * 40) {
+    c.fill(int(i / (61 * 40) % 64) * 2 + 1, 20, 61, 40, uint16_t(i));
+    bench::launder(surface);
+  }
+  bench::keep(surface);
+}
+
+BENCH(bitmap, blit) {
+  bitmap::canvas c(surface);
+  bitmap::image s = sprite_image();
+  for (long i = 0; i < n; i += 64 * 64) {
+    c.blit(s, int(i / (64 * 64) % 64) * 2, 50);
+    bench::launder(surface);
+  }
+  bench::keep(surface);
+}
+
+BENCH(bitmap, blit_misaligned) {
+  bitmap::canvas c(surface);
+  bitmap::image s = sprite_image();
+  for (long i = 0; i < n; i += 64 * 64) {
+    c.blit(s, int(i / (64 * 64) % 64) * 2 + 1, 50);
+    bench::launder(surface);
+  }
+  bench::keep(surface);
+}
+
+BENCH(bitmap, blit_pixels) {
+  bitmap::canvas c(surface);
+  bitmap::image s = sprite_image();
+  for (long i = 0; i < n; i += 64 * 64) {
+    int x0 = int(i / (64 * 64) % 64) * 2;
+    for (int y = 0; y < 64; ++y)
+      for (int x = 0; x < 64; ++x)
+        c.pixel(x0 + x, 50 + y, s.pixels[y * 64 + x]);
+    bench::launder(surface);
+  }
+  bench::keep(surface);
+}
+
+BENCH(bitmap, blit_keyed) {
+  bitmap::canvas c(surface);
+  bitmap::image s = sprite_image();
+  for (long i = 0; i < n; i += 64 * 64) {
+    c.blit(s, int(i / (64 * 64) % 128), 50, 0);
+    bench::launder(surface);
+  }
+  bench::keep(surface);
+}
+
+BENCH(bitmap, blend) {
+  bitmap::canvas c(surface);
+  bitmap::image s = sprite_image();
+  for (long i = 0; i < n; i += 64 * 64) {
+    c.blend(s, int(i / (64 * 64) % 128), 50, 12);
+    bench::launder(surface);
+  }
+  bench::keep(surface);
+}
+
+BENCH(bitmap, tint) {
+  bitmap::canvas c(surface);
+  for (long i = 0; i < n; i += 64 * 64) {
+    c.tint(int(i / (64 * 64) % 128), 50, 64, 64, 0x7c00, 8);
+    bench::launder(surface);
+  }
+  bench::keep(surface);
+}
+
+// 100 pixels per line
+BENCH(bitmap, line) {
+  bitmap::canvas c(surface);
+  for (long i = 0; i < n; i += 100) {
+    int x = int(i / 100 % 128);
+    c.line(x, 10, x + 60, 109, uint16_t(i));
+    bench::launder(surface);
+  }
+  bench::keep(surface);
+}
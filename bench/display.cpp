@@ -0,0 +1,48 @@
+//-----------------------------------------------------------------------------
+// custard/display.hpp, custard/vram.hpp
+//-----------------------------------------------------------------------------
+
+#include <custard/display.hpp>
+
+#include "bench.hpp"
+
+using namespace custard;
+
+BENCH(display, config_set_main) {
+  display::config c;
+  c.mask = 0;
+  for (long i = 0; i < n; ++i) {
+    c.graphics_TTAE();
+    c.bg2_enable = i & 1;
+    c.set_main();
+  }
+  bench::keep(c);
+}
+
+// One frame of a scrolling layer: scroll two backgrounds, present, commit
+BENCH(display, shadow_frame) {
+  display::shadow s(display::main_io());
+  for (long i = 0; i < n; ++i) {
+    int x = int(i);
+    s.bg_scroll(0, x, x >> 1);
+    s.bg_scroll(1, x >> 1, x >> 2);
+    s.present();
+    bench::keep(s.commit());
+  }
+}
+
+BENCH(vram, map_banks) {
+  for (long i = 0; i < n; ++i) {
+    vram::main::bg::AB_256();
+    vram::sub::CH_BG128X_DI_S128X();
+  }
+}
+
+BENCH(vram, plan_apply) {
+  using p = vram::plan<
+    vram::map<vram::bank::A, vram::region::main_bg, 0>,
+    vram::map<vram::bank::B, vram::region::main_sprite>,
+    vram::map<vram::bank::C, vram::region::sub_bg>,
+    vram::map<vram::bank::D, vram::region::sub_sprite>>;
+  for (long i = 0; i < n; ++i) p::apply();
+}
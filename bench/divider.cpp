@@ -0,0 +1,52 @@
+//-----------------------------------------------------------------------------
+// custard/divider.hpp
+//-----------------------------------------------------------------------------
+// On the host the divider is emulated through custard/host.hpp, so these
+// time the emulation against plain 64-bit division; the overlap the batch
+// gains on the DS cannot show here.
+//-----------------------------------------------------------------------------
+
+#include <custard/divider.hpp>
+
+#include "bench.hpp"
+
+using namespace custard;
+
+static q12 num[256], den[256], out[256];
+
+static void fill() {
+  for (int i = 0; i < 256; ++i) {
+    num[i] = q12::from_raw(i * 7919 - 1000000);
+    den[i] = q12::from_raw(i * 31 + 4096);
+  }
+}
+
+BENCH(divider, batch) {
+  fill();
+  for (long i = 0; i < n; i += 256) {
+    divider::divide(num, den, out, 256);
+    bench::launder(out[0]);
+  }
+  bench::keep(out);
+}
+
+BENCH(divider, split_phase) {
+  fill();
+  for (long i = 0; i < n; i += 256) {
+    for (int j = 0; j < 256; ++j)
+      out[j] = divider::start(num[j], den[j]).result();
+    bench::launder(out[0]);
+  }
+  bench::keep(out);
+}
+
+BENCH(divider, software) {
+  fill();
+  for (long i = 0; i < n; i += 256) {
+    for (int j = 0; j < 256; ++j)
+      out[j] = q12::from_raw(
+        int32_t(int64_t(num[j].raw()) * 4096 / den[j].raw()));
+    bench::launder(out[0]);
+  }
+  bench::keep(out);
+}
@@ -0,0 +1,108 @@
+//-----------------------------------------------------------------------------
+// Custard host benchmark runner
+//-----------------------------------------------------------------------------
+// Runs every registered benchmark, or those whose names contain the filter,
+// and prints nanoseconds per operation:
+//
+//   bench [--write file] [--compare file] [--slack percent] [filter]
+//
+// --write stores the results as a baseline. --compare reads a baseline and
+// marks each result that is more than the slack (25% by default) slower than
+// it, after measuring it twice more to rule out a busy machine; the exit
+// status is then 1 if any was.
+//-----------------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include <custard/host.hpp>
+
+#include "bench.hpp"
+
+// Best time of several runs, in nanoseconds per operation
+static double measure(void (*run)(long)) {
+  typedef std::chrono::steady_clock clock;
+  auto time = [run](long n) {
+    auto t0 = clock::now();
+    run(n);
+    return std::chrono::duration<double, std::nano>(clock::now() - t0)
+      .count();
+  };
+  long n = 1;
+  while (time(n) < 3e7 && n < (1L << 40)) n *= 2;
+  double best = time(n);
+  for (int i = 0; i < 6; ++i) {
+    double t = time(n);
+    if (t < best) best = t;
+  }
+  return best / n;
+}
+
+int main(int argc, char** argv) {
+  const char *write = nullptr, *compare = nullptr, *filter = nullptr;
+  double slack = 25;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--write") && i + 1 < argc) write = argv[++i];
+    else if (!std::strcmp(argv[i], "--compare") && i + 1 < argc)
+      compare = argv[++i];
+    else if (!std::strcmp(argv[i], "--slack") && i + 1 < argc)
+      slack = std::atof(argv[++i]);
+    else filter = argv[i];
+  }
+
+  std::map<std::string, double> baseline;
+  if (compare) {
+    std::ifstream in(compare);
+    if (!in) std::fprintf(stderr, "%s: no baseline\n", compare);
+    std::string name;
+    double ns;
+    while (in >> name >> ns) baseline[name] = ns;
+  }
+
+  std::FILE* out = nullptr;
+  if (write && !(out = std::fopen(write, "w"))) {
+    std::perror(write);
+    return 2;
+  }
+
+  int regressions = 0;
+  for (bench::benchmark* b = bench::first; b; b = b->next) {
+    std::string name = std::string(b->group) + "." + b->name;
+    if (filter && name.find(filter) == std::string::npos) continue;
+    custard::host::reset();
+    bench::metric_unit = nullptr;
+    double ns = measure(b->run);
+    auto base = baseline.find(name);
+    // measure a suspected regression again, in case the machine was busy
+    for (int retry = 0; retry < 2 && base != baseline.end()
+         && ns > base->second * (1 + slack / 100); ++retry) {
+      double again = measure(b->run);
+      if (again < ns) ns = again;
+    }
+    std::printf("%-32s %10.2f ns/op", name.c_str(), ns);
+    if (base != baseline.end()) {
+      double change = 100 * (ns / base->second - 1);
+      bool slower = change > slack;
+      regressions += slower;
+      std::printf("  %+6.1f%%%s", change, slower ? "  REGRESSION" : "");
+    }
+    else if (compare) std::printf("  (new)");
+    if (bench::metric_unit)
+      std::printf("  [%.1f %s]", bench::metric_per_ms
+                  ? bench::metric_value * 1e6 / ns : bench::metric_value,
+                  bench::metric_unit);
+    std::printf("\n");
+    if (out) std::fprintf(out, "%s %.3f\n", name.c_str(), ns);
+  }
+
+  if (out) std::fclose(out);
+  if (regressions)
+    std::printf("%d benchmarks more than %g%% slower than the baseline\n",
+                regressions, slack);
+  return regressions ? 1 : 0;
+}
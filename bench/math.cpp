@@ -0,0 +1,99 @@
+//-----------------------------------------------------------------------------
+// custard/math.hpp
+//-----------------------------------------------------------------------------
+// Each function is paired with the float version it replaces. On the host
+// the float versions run on an FPU, so the comparison flatters them; on the
+// ARM9 they are soft-float calls.
+//-----------------------------------------------------------------------------
+
+#include <cmath>
+
+#include <custard/math.hpp>
+
+#include "bench.hpp"
+
+using namespace custard;
+
+BENCH(math, sin) {
+  q12 sum = 0;
+  for (long i = 0; i < n; ++i) sum += sin(angle(i * 37));
+  bench::keep(sum);
+}
+
+BENCH(math, sin_float) {
+  float sum = 0;
+  for (long i = 0; i < n; ++i) sum += std::sin(float(i) * 0.0071f);
+  bench::keep(sum);
+}
+
+BENCH(math, atan2) {
+  angle sum = 0;
+  for (long i = 0; i < n; ++i)
+    sum += atan2(q12::from_raw(int(i & 0xffff) - 0x8000),
+                 q12::from_raw(int(i >> 4 & 0xffff) + 1));
+  bench::keep(sum);
+}
+
+BENCH(math, atan2_float) {
+  float sum = 0;
+  for (long i = 0; i < n; ++i)
+    sum += std::atan2(float(int(i & 0xffff) - 0x8000),
+                      float(int(i >> 4 & 0xffff) + 1));
+  bench::keep(sum);
+}
+
+BENCH(math, sqrt) {
+  q12 sum = 0;
+  for (long i = 0; i < n; ++i) sum += sqrt(q12::from_raw(int(i) | 1));
+  bench::keep(sum);
+}
+
+BENCH(math, sqrt_float) {
+  float sum = 0;
+  for (long i = 0; i < n; ++i) sum += std::sqrt(float(int(i) | 1));
+  bench::keep(sum);
+}
+
+BENCH(math, rsqrt) {
+  q12 sum = 0;
+  for (long i = 0; i < n; ++i) sum += rsqrt(q12::from_raw(int(i) | 1));
+  bench::keep(sum);
+}
+
+BENCH(math, rsqrt_float) {
+  float sum = 0;
+  for (long i = 0; i < n; ++i) sum += 1 / std::sqrt(float(int(i) | 1));
+  bench::keep(sum);
+}
+
+BENCH(math, recip) {
+  q12 sum = 0;
+  for (long i = 0; i < n; ++i) sum += recip(q12::from_raw(int(i) | 1));
+  bench::keep(sum);
+}
+
+BENCH(math, recip_float) {
+  float sum = 0;
+  for (long i = 0; i < n; ++i) sum += 1 / float(int(i) | 1);
+  bench::keep(sum);
+}
+
+BENCH(math, normalize) {
+  vec2<q12> sum;
+  for (long i = 0; i < n; ++i)
+    sum = sum + normalize(vec2<q12>(q12::from_raw(int(i) | 1),
+                                    q12::from_raw(int(i * 7))));
+  bench::keep(sum);
+}
+
+BENCH(math, normalize_float) {
+  float sx = 0, sy = 0;
+  for (long i = 0; i < n; ++i) {
+    float x = float(int(i) | 1), y = float(int(i * 7));
+    float r = 1 / std::sqrt(x * x + y * y);
+    sx += x * r;
+    sy += y * r;
+  }
+  bench::keep(sx);
+  bench::keep(sy);
+}
@@ -0,0 +1,108 @@
+//-----------------------------------------------------------------------------
+// custard/memory.hpp
+//-----------------------------------------------------------------------------
+// Each operation is one frame of a typical allocation pattern, against the
+// same pattern through malloc/free or new/delete:
+//   scratch   64 blocks of 16 to 256 bytes, all freed at the end of the frame
+//   particles 256 live objects, of which 32 die and are replaced each frame
+//   vector    a container filled with 200 elements, dropped at frame end
+// The host's allocator is much faster than newlib's on the DS, so these
+// understate the difference there.
+//-----------------------------------------------------------------------------
+
+#include <cstdlib>
+#include <vector>
+
+#include <custard/memory.hpp>
+
+#include "bench.hpp"
+
+using namespace custard;
+
+static int block_size(int i) { return 16 + (i * 37 & 15) * 16; }
+
+BENCH(memory, scratch_arena) {
+  alignas(16) static uint8_t buffer[0x4000];
+  arena a(buffer, sizeof buffer);
+  for (long f = 0; f < n; ++f) {
+    for (int i = 0; i < 64; ++i) {
+      auto p = static_cast<uint8_t*>(a.allocate(size_t(block_size(i))));
+      p[0] = uint8_t(i);
+      bench::keep(p);
+    }
+    a.reset();
+  }
+}
+
+BENCH(memory, scratch_malloc) {
+  void* blocks[64];
+  for (long f = 0; f < n; ++f) {
+    for (int i = 0; i < 64; ++i) {
+      auto p = static_cast<uint8_t*>(std::malloc(size_t(block_size(i))));
+      p[0] = uint8_t(i);
+      bench::keep(p);
+      blocks[i] = p;
+    }
+    for (void* p : blocks) std::free(p);
+  }
+}
+
+namespace {
+  struct particle {
+    int x, y, dx, dy, life;
+    uint16_t tile, palette;
+  };
+}
+
+// Slot of the k-th particle to die in frame f
+static int victim(long f, int k) { return int((f * 97 + k * 8) & 255); }
+
+BENCH(memory, particles_pool) {
+  static pool<particle, 256> p;
+  particle* live[256];
+  for (int i = 0; i < 256; ++i)
+    live[i] = p.create(particle{i, i, 1, 1, i, 0, 0});
+  for (long f = 0; f < n; ++f)
+    for (int k = 0; k < 32; ++k) {
+      int v = victim(f, k);
+      p.destroy(live[v]);
+      live[v] = p.create(particle{v, k, 1, -1, 60, 0, 0});
+      bench::keep(live[v]);
+    }
+  for (particle* q : live) p.destroy(q);
+}
+
+BENCH(memory, particles_new) {
+  particle* live[256];
+  for (int i = 0; i < 256; ++i)
+    live[i] = new particle{i, i, 1, 1, i, 0, 0};
+  for (long f = 0; f < n; ++f)
+    for (int k = 0; k < 32; ++k) {
+      int v = victim(f, k);
+      delete live[v];
+      live[v] = new particle{v, k, 1, -1, 60, 0, 0};
+      bench::keep(live[v]);
+    }
+  for (particle* q : live) delete q;
+}
+
+BENCH(memory, vector_arena) {
+  alignas(16) static uint8_t buffer[0x4000];
+  arena a(buffer, sizeof buffer);
+  for (long f = 0; f < n; ++f) {
+    {
+      std::vector<int, arena_allocator<int>> v{arena_allocator<int>(a)};
+      for (int i = 0; i < 200; ++i) v.push_back(i);
+      bench::keep(v.data());
+    }
+    a.reset();
+  }
+}
+
+BENCH(memory, vector_new) {
+  for (long f = 0; f < n; ++f) {
+    std::vector<int> v;
+    for (int i = 0; i < 200; ++i) v.push_back(i);
+    bench::keep(v.data());
+  }
+}
@@ -0,0 +1,70 @@
+//-----------------------------------------------------------------------------
+// custard/pack.hpp, tools/pack.hpp
+//-----------------------------------------------------------------------------
+// Each operation decodes (or encodes) 1K of data, so 1000 / (ns/op) is the
+// throughput in MB/s. The decoder writes to host memory rather than VRAM.
+//-----------------------------------------------------------------------------
+
+#include <cstring>
+
+#include "../tools/pack.hpp"
+#include "bench.hpp"
+
+using namespace custard;
+
+static pack::bytes tiles() {
+  pack::bytes v(65536);
+  for (size_t i = 0; i < v.size(); ++i) {
+    uint32_t t = uint32_t(i / 64 * 5 % 23 * 64 + i % 64) * 2654435761u;
+    v[i] = uint8_t(t >> 28);
+  }
+  return v;
+}
+
+static pack::bytes runs() {
+  pack::bytes v(65536);
+  for (size_t i = 0; i < v.size(); ++i) v[i] = uint8_t(i / 50 % 4);
+  return v;
+}
+
+// Encoded once, outside the timed runs
+struct packed {
+  size_t size;
+  std::vector<uint32_t> blob;
+  double ratio;
+
+  explicit packed(const pack::bytes& in) : size(in.size()) {
+    pack::bytes b = pack::encode(in, 4096);
+    blob.resize((b.size() + 3) / 4);
+    std::memcpy(blob.data(), b.data(), b.size());
+    ratio = 100. * b.size() / in.size();
+  }
+};
+
+static void decode(long n, const packed& p) {
+  static std::vector<uint32_t> out(65536 / 4);
+  bench::metric(p.ratio, "% of input");
+  for (long i = 0; i < n; i += 64) {
+    pack::unpack(p.blob.data(), out.data());
+    bench::launder(out[0]);
+  }
+  bench::keep(out[1]);
+}
+
+BENCH(pack, decode_lz77) {
+  static const packed p(tiles());
+  decode(n, p);
+}
+
+BENCH(pack, decode_rle) {
+  static const packed p(runs());
+  decode(n, p);
+}
+
+BENCH(pack, encode) {
+  pack::bytes in = tiles();
+  for (long i = 0; i < n; i += 64) {
+    pack::bytes b = pack::encode(in, 4096);
+    bench::keep(b.size());
+  }
+}
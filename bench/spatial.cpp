@@ -0,0 +1,73 @@
+//-----------------------------------------------------------------------------
+// custard/spatial.hpp
+//-----------------------------------------------------------------------------
+// Each operation is one frame of 256 moving entities on a 512x384 pixel
+// field: moving every box in the grid and finding all overlapping pairs,
+// against testing every pair of boxes.
+//-----------------------------------------------------------------------------
+
+#include <custard/spatial.hpp>
+
+#include "bench.hpp"
+
+using namespace custard;
+using spatial::box;
+
+static box boxes[256];
+
+static box at(int i, long frame) {
+  int x = int((i * 97 + frame * (i % 7 - 3)) & 511) - 16;
+  int y = int((i * 61 + frame * (i % 5 - 2)) % 384 + 384) % 384 - 16;
+  int s = 8 + i % 16;
+  return {vec2<q12>(q12(x), q12(y)), vec2<q12>(q12(x + s), q12(y + s))};
+}
+
+BENCH(spatial, grid_frame) {
+  static spatial::grid<256> g(vec2<q12>(), 5);
+  g.clear();
+  for (int i = 0; i < 256; ++i) g.insert(at(i, 0));
+  int pairs = 0;
+  for (long f = 0; f < n; ++f) {
+    for (int i = 0; i < 256; ++i) g.move(i, at(i, f));
+    g.pairs([&](int, int) { ++pairs; });
+  }
+  bench::keep(pairs);
+}
+
+BENCH(spatial, brute_force_frame) {
+  int pairs = 0;
+  for (long f = 0; f < n; ++f) {
+    for (int i = 0; i < 256; ++i) boxes[i] = at(i, f);
+    bench::launder(boxes);
+    for (int a = 0; a < 256; ++a)
+      for (int b = a + 1; b < 256; ++b)
+        pairs += boxes[a].overlaps(boxes[b]);
+  }
+  bench::keep(pairs);
+}
+
+// One query of a 64x64 pixel region among the 256 entities
+BENCH(spatial, grid_query) {
+  static spatial::grid<256> g(vec2<q12>(), 5);
+  g.clear();
+  for (int i = 0; i < 256; ++i) g.insert(at(i, 0));
+  int found = 0;
+  for (long k = 0; k < n; ++k) {
+    int x = int(k * 37 % 448);
+    box q = {vec2<q12>(q12(x), q12(100)), vec2<q12>(q12(x + 64), q12(164))};
+    g.query(q, [&](int) { ++found; });
+  }
+  bench::keep(found);
+}
+
+BENCH(spatial, brute_force_query) {
+  for (int i = 0; i < 256; ++i) boxes[i] = at(i, 0);
+  int found = 0;
+  for (long k = 0; k < n; ++k) {
+    int x = int(k * 37 % 448);
+    box q = {vec2<q12>(q12(x), q12(100)), vec2<q12>(q12(x + 64), q12(164))};
+    bench::launder(q);
+    for (const box& b : boxes) found += b.overlaps(q);
+  }
+  bench::keep(found);
+}
@@ -0,0 +1,56 @@
+//-----------------------------------------------------------------------------
+// custard/sprite.hpp
+//-----------------------------------------------------------------------------
+// Operations are per sprite: sorting 128 depth keys with the radix sort and
+// with std::stable_sort, and building a multiplexed frame of 256 sprites.
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+
+#include <custard/host.hpp>
+#include <custard/sprite.hpp>
+
+#include "bench.hpp"
+
+using namespace custard;
+
+static uint16_t keys[128];
+
+static void fill() {
+  for (int i = 0; i < 128; ++i) keys[i] = uint16_t(i * 40503 >> 3);
+}
+
+BENCH(sprite, radix_sort) {
+  fill();
+  uint16_t order[128], scratch[128];
+  for (long i = 0; i < n; i += 128) {
+    sprite::radix_sort(keys, order, scratch, 128);
+    bench::launder(order[0]);
+  }
+  bench::keep(order);
+}
+
+BENCH(sprite, stable_sort) {
+  fill();
+  uint16_t order[128];
+  for (long i = 0; i < n; i += 128) {
+    for (int j = 0; j < 128; ++j) order[j] = uint16_t(j);
+    std::stable_sort(order, order + 128,
+                     [](int a, int b) { return keys[a] < keys[b]; });
+    bench::launder(order[0]);
+  }
+  bench::keep(order);
+}
+
+BENCH(sprite, multiplex) {
+  sprite::oam o;
+  sprite::multiplexer<256> m;
+  for (long i = 0; i < n; i += 256) {
+    for (int j = 0; j < 256; ++j)
+      m.add({uint16_t((j * 37 + i) % 192), uint16_t(j), 0, 0});
+    m.build(o, 0, 64);
+    bench::keep(m.scheduled());
+    m.vblank();
+  }
+  bench::keep(o);
+}
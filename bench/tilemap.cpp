@@ -0,0 +1,51 @@
+//-----------------------------------------------------------------------------
+// custard/tilemap.hpp
+//-----------------------------------------------------------------------------
+// Each operation is one frame of a camera panning over a 256x256 tile map,
+// with the bytes written to the hardware map per frame reported alongside.
+// The streaming map is compared with copying the visible 33x25 tiles every
+// frame, the simplest alternative.
+//-----------------------------------------------------------------------------
+
+#include <custard/tilemap.hpp>
+
+#include "bench.hpp"
+
+using namespace custard;
+
+static uint16_t world[256 * 256];
+static uint16_t hw[4096];
+
+// Camera path: diagonal pan at (dx, dy) pixels per frame, bouncing off the
+// edges of the map
+static ivec2 camera(long frame, int dx, int dy) {
+  auto bounce = [](long p, int range) {
+    p %= 2 * range;
+    return int(p < range ? p : 2 * range - p);
+  };
+  return ivec2(bounce(frame * dx, 2048 - 256), bounce(frame * dy, 2048 - 192));
+}
+
+static void stream(long n, int dx, int dy) {
+  display::streaming_map m(world, ivec2(256, 256), hw);
+  m.load(camera(0, dx, dy));
+  int start = m.total_bytes();
+  for (long i = 1; i <= n; ++i) m.update(camera(i, dx, dy));
+  bench::metric(double(m.total_bytes() - start) / n, "bytes/frame");
+  bench::keep(hw);
+}
+
+BENCH(tilemap, stream_2px) { stream(n, 2, 1); }
+BENCH(tilemap, stream_8px) { stream(n, 8, 5); }
+
+BENCH(tilemap, copy_view_8px) {
+  for (long i = 1; i <= n; ++i) {
+    ivec2 t = camera(i, 8, 5) >> 3;
+    for (int y = t.y; y < t.y + 25; ++y)
+      for (int x = t.x; x < t.x + 33; ++x)
+        hw[(y & 31) << 5 | (x & 31)] = world[y * 256 + x];
+    bench::launder(hw[0]);
+  }
+  bench::metric(33 * 25 * 2, "bytes/frame");
+  bench::keep(hw);
+}
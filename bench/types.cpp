@@ -0,0 +1,119 @@
+//-----------------------------------------------------------------------------
+// custard/types.hpp
+//-----------------------------------------------------------------------------
+
+#include <custard/types.hpp>
+
+#include "bench.hpp"
+
+using namespace custard;
+
+BENCH(q12, add) {
+  q12 x = 0, d = 0.001_q12;
+  for (long i = 0; i < n; ++i) { x += d; bench::launder(x); }
+  bench::keep(x);
+}
+
+BENCH(q12, multiply) {
+  q12 x = 1, a = 1.0001_q12;
+  for (long i = 0; i < n; ++i) { x *= a; bench::launder(x); }
+  bench::keep(x);
+}
+
+BENCH(q12, divide) {
+  q12 x = 1000, a = 1.0001_q12;
+  for (long i = 0; i < n; ++i) { x /= a; bench::launder(x); }
+  bench::keep(x);
+}
+
+BENCH(q16, multiply) {
+  q16 x = 1, a = 1.0001_q16;
+  for (long i = 0; i < n; ++i) { x *= a; bench::launder(x); }
+  bench::keep(x);
+}
+
+BENCH(q15, saturating_add) {
+  q15 x = 0, d = 0.001_q15;
+  for (long i = 0; i < n; ++i) { x += d; bench::launder(x); }
+  bench::keep(x);
+}
+
+BENCH(fixed, mixed_multiply) {
+  q12 x = 1000;
+  q15 g = 0.9999_q15;
+  for (long i = 0; i < n; ++i) { x = mul<q12>(x, g); bench::launder(x); }
+  bench::keep(x);
+}
+
+BENCH(fixed, convert) {
+  q16 x = 1;
+  for (long i = 0; i < n; ++i) {
+    x = q16(q8(q12(x) + 0.25_q12));
+    bench::launder(x);
+  }
+  bench::keep(x);
+}
+
+BENCH(vec2, add_scale) {
+  vec2<q12> p, v(0.5_q12, 0.25_q12);
+  q12 dt = 0.016_q12;
+  for (long i = 0; i < n; ++i) { p = p + v * dt; bench::launder(p); }
+  bench::keep(p);
+}
+
+BENCH(vec2, min_max) {
+  vec2<q12> p(-3, 7), lo(-1, -1), hi(4, 4);
+  for (long i = 0; i < n; ++i) {
+    p = p.max(lo).min(hi);
+    bench::launder(p);
+  }
+  bench::keep(p);
+}
+
+// Per point of a 32x32 rectangle
+BENCH(range, ivec2_row_major) {
+  int sum = 0;
+  for (long i = 0; i < n; i += 1024) {
+    for (ivec2 v : range<ivec2>(ivec2(32, 32))) sum += v.x ^ v.y;
+    bench::launder(sum);
+  }
+  bench::keep(sum);
+}
+
+// Per pixel of a 256x192 8bpp image laid out in 8x8 tiles, as in VRAM
+static uint8_t tiled_image[192 * 256];
+
+static int pixel(ivec2 v) {
+  return tiled_image[(v.y >> 3) * 2048 + (v.x >> 3) * 64 + (v.y & 7) * 8
+                     + (v.x & 7)];
+}
+
+BENCH(range, image_row_major) {
+  int sum = 0;
+  bench::launder(tiled_image);
+  for (long i = 0; i < n; i += 192 * 256) {
+    for (ivec2 v : range<ivec2>(ivec2(256, 192))) sum += pixel(v);
+    bench::launder(sum);
+  }
+  bench::keep(sum);
+}
+
+BENCH(range, image_tiled) {
+  int sum = 0;
+  bench::launder(tiled_image);
+  for (long i = 0; i < n; i += 192 * 256) {
+    for (ivec2 v : range<ivec2>(ivec2(256, 192)).tiles()) sum += pixel(v);
+    bench::launder(sum);
+  }
+  bench::keep(sum);
+}
+
+BENCH(range, image_z_order) {
+  int sum = 0;
+  bench::launder(tiled_image);
+  for (long i = 0; i < n; i += 192 * 256) {
+    for (ivec2 v : range<ivec2>(ivec2(256, 192)).z_order()) sum += pixel(v);
+    bench::launder(sum);
+  }
+  bench::keep(sum);
+}
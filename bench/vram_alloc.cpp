@@ -0,0 +1,48 @@
+//-----------------------------------------------------------------------------
+// custard/vram_alloc.hpp
+//-----------------------------------------------------------------------------
+// Each operation is one allocation or release in a churn of mixed sizes over
+// a half-full allocator, the pattern of graphics loaded and unloaded as
+// sprites come and go.
+//-----------------------------------------------------------------------------
+
+#include <custard/vram_alloc.hpp>
+
+#include "bench.hpp"
+
+using namespace custard;
+
+BENCH(vram_alloc, churn) {
+  vram::block_allocator<1024> a;
+  int live[64];
+  for (int i = 0; i < 64; ++i) live[i] = a.alloc(1 + (i & 7) * 2, 1 + (i & 3));
+  for (long i = 0; i < n; i += 2) {
+    int k = int(i >> 1) & 63;
+    a.release(live[k]);
+    live[k] = a.alloc(1 + (k * 5 & 15), 1 + (k & 3));
+    bench::launder(live[k]);
+  }
+  bench::keep(live);
+}
+
+BENCH(vram_alloc, top_down) {
+  vram::bg_allocator<> bg;
+  for (int i = 0; i < 8; ++i) bg.screen(2);
+  for (long i = 0; i < n; i += 2) {
+    int b = bg.chars(0x4000 + (i & 0x7fff));
+    bench::launder(b);
+    bg.release_chars(b);
+  }
+  bench::keep(bg);
+}
+
+BENCH(vram_alloc, report) {
+  vram::block_allocator<1024> a;
+  for (int i = 0; i < 100; ++i) a.alloc(1 + i % 9, 1);
+  for (int i = 0; i < 100; i += 3) a.release(i * 5);
+  for (long i = 0; i < n; ++i) {
+    auto s = a.report();
+    bench::launder(s);
+  }
+  bench::keep(a);
+}
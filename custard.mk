@@ -88,6 +88,34 @@ $(BUILD)/%_wav.h: %.wav
 	@mkdir -p $(dir $@)
 	$(bin2h)
 
+#------------------------------------------------------------------------------
+# compressed assets
+#------------------------------------------------------------------------------
+# Any file with the extension .bin may be packed into a compressed blob (see
+# custard/pack.hpp) and linked in, e.g. the binary output of grit (-ftb). The
+# packer is built for the host from the Custard sources on first use; set
+# CUSTARD to the Custard directory, and HOSTCXX if g++ is not the host C++
+# compiler. PACKFLAGS may set the chunk size, e.g. -c 2048.
+#------------------------------------------------------------------------------
+
+HOSTCXX   ?= g++
+PACK      := $(BUILD)/custard-pack
+
+$(PACK): $(CUSTARD)/tools/pack.cpp $(CUSTARD)/tools/pack.hpp \
+         $(CUSTARD)/include/custard/pack.hpp
+	@mkdir -p $(dir $@)
+	$(HOSTCXX) -std=c++17 -O2 -I$(CUSTARD)/include $< -o $@
+
+$(BUILD)/%.pak: %.bin $(PACK)
+	@mkdir -p $(dir $@)
+	$(PACK) $(PACKFLAGS) $< $@
+
+$(BUILD)/%.pak.o: $(BUILD)/%.pak
+	bin2s $< | $(AS) -o $@
+
+$(BUILD)/%_pak.h: $(BUILD)/%.pak
+	$(bin2h)
+
 $(BUILD)/%.s $(BUILD)/%.h: %.png %.grit
 	@mkdir -p $(dir $@)
 	grit $< -fts -o$(BUILD)/$*
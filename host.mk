@@ -0,0 +1,76 @@
+#------------------------------------------------------------------------------
+# Custard host targets
+#------------------------------------------------------------------------------
+# These targets build custard for the development machine, against
+# custard/host.hpp instead of libnds, so they need no devkitARM. The Makefile
+# includes this file; it may also be used on its own (make -f host.mk test).
+#
+# host           : compile each header on its own
+# test           : build and run the tests in test/, and check that the code
+#                  in test/no_float compiles without floating point
+# bench          : run the benchmarks in bench/ and compare them with the
+#                  stored baseline, failing if any is more than BENCH_SLACK
+#                  percent slower
+# bench-baseline : run the benchmarks and store the results as the baseline
+#
+# The baseline is only meaningful on the machine that recorded it; record a
+# new one before comparing on another machine.
+#------------------------------------------------------------------------------
+
+HOSTCXX       ?= g++
+HOSTBUILD     ?= build/host
+HOSTFLAGS     := -std=c++17 -Wall -Wextra -Iinclude
+BENCH_SLACK   ?= 25
+BASELINE      := bench/baseline.txt
+
+# Flags that take the floating point unit away from the host compiler, so
+# that any float operation left in an object is an error or a soft-float call
+HOSTARCH      := $(shell $(HOSTCXX) -dumpmachine)
+ifneq ($(filter x86_64% i386% i686%,$(HOSTARCH)),)
+NOFLOAT_FLAGS ?= -mno-sse -mno-80387
+else ifneq ($(filter aarch64%,$(HOSTARCH)),)
+NOFLOAT_FLAGS ?= -mgeneral-regs-only
+else
+NOFLOAT_FLAGS ?= -msoft-float
+endif
+
+HEADERS       := $(shell find include -name '*.hpp')
+TOOL_HEADERS  := $(wildcard tools/*.hpp)
+TEST_SOURCES  := $(wildcard test/*.cpp)
+BENCH_SOURCES := $(wildcard bench/*.cpp)
+
+.PHONY: host test bench bench-baseline
+
+host:
+	@for h in $(HEADERS); do \
+	  echo "#include <$${h#include/}>" | $(HOSTCXX) $(HOSTFLAGS) \
+	    -fsyntax-only -x c++ - || exit 1; \
+	done
+
+# The tests check the allocation counters, which are off by default
+$(HOSTBUILD)/test: $(TEST_SOURCES) test/test.hpp $(HEADERS) $(TOOL_HEADERS)
+	@mkdir -p $(dir $@)
+	$(HOSTCXX) $(HOSTFLAGS) -DCUSTARD_MEMORY_STATS -O1 -g $(TEST_SOURCES) \
+	  -o $@
+
+# Fixed-point code must compile to integer code even without optimization
+$(HOSTBUILD)/no_float.o: test/no_float/literals.cpp $(HEADERS)
+	@mkdir -p $(dir $@)
+	$(HOSTCXX) $(HOSTFLAGS) -O0 $(NOFLOAT_FLAGS) -c $< -o $@
+	@if nm -u $@ | grep -E '__(aeabi_[fd]|[a-z]+[sdt]f[0-9]?)'; then \
+	  echo "$<: references soft-float routines"; rm -f $@; exit 1; \
+	fi
+
+test: $(HOSTBUILD)/test $(HOSTBUILD)/no_float.o
+	$(HOSTBUILD)/test
+
+$(HOSTBUILD)/bench: $(BENCH_SOURCES) bench/bench.hpp $(HEADERS) \
+                   $(TOOL_HEADERS)
+	@mkdir -p $(dir $@)
+	$(HOSTCXX) $(HOSTFLAGS) -O2 $(BENCH_SOURCES) -o $@
+
+bench: $(HOSTBUILD)/bench
+	$(HOSTBUILD)/bench --compare $(BASELINE) --slack $(BENCH_SLACK)
+
+bench-baseline: $(HOSTBUILD)/bench
+	$(HOSTBUILD)/bench --write $(BASELINE)
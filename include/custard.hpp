@@ -1,3 +1,20 @@
+#include <custard/batch.hpp>
 #include <custard/display.hpp>
+#include <custard/divider.hpp>
+#include <custard/math.hpp>
 #include <custard/types.hpp>
 #include <custard/vram.hpp>
+#include <custard/vram_alloc.hpp>
+#include <custard/raster.hpp>
+#include <custard/sprite.hpp>
+#include <custard/tilemap.hpp>
+#include <custard/pack.hpp>
+#include <custard/palette.hpp>
+#include <custard/profile.hpp>
+#include <custard/bitmap.hpp>
+#include <custard/memory.hpp>
+#include <custard/gx.hpp>
+#include <custard/spatial.hpp>
+#include <custard/audio.hpp>
+#include <custard/upload.hpp>
+#include <custard/affine.hpp>
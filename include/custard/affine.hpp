@@ -0,0 +1,252 @@
+#ifndef CUSTARD_AFFINE_HPP
+#define CUSTARD_AFFINE_HPP
+
+#include <cstdint>
+
+#include <custard/display.hpp>
+#include <custard/math.hpp>
+#include <custard/types.hpp>
+
+namespace custard {
+
+// Hardware formats
+//-----------------------------------------------------------------------------
+/// Round to the 8.8 format of affine parameters PA-PD, saturating
+constexpr int16_t to_8_8(q12 q) {
+  int32_t r = (int64_t(q.raw()) + 8) >> 4;
+  return int16_t(r < -32768 ? -32768 : r > 32767 ? 32767 : r);
+}
+/// Round to the 20.8 format of the reference point BGxX/BGxY (28 bits used)
+constexpr int32_t to_20_8(q12 q) {
+  return int32_t((int64_t(q.raw()) + 8) >> 4);
+}
+//-----------------------------------------------------------------------------
+
+// INTERNAL: n 2^shift / d rounded to nearest, with the divider, saturated
+// to 32 bits. d is rounded to 31 significant bits and n scaled alike, which
+// loses nothing that the quotient can hold unless it nearly saturates.
+inline int32_t _div_round(int64_t n, int64_t d, int shift) {
+  bool negative = (n < 0) != (d < 0);
+  uint64_t an = n < 0 ? -uint64_t(n) : uint64_t(n);
+  uint64_t ad = d < 0 ? -uint64_t(d) : uint64_t(d);
+  int e = 0;
+  while (ad >> e > INT32_MAX) ++e;
+  while (shift > e && an >> (62 - (shift - e))) ++e;
+  if (e) ad = (ad + (uint64_t(1) << (e - 1))) >> e;
+  if (shift >= e) an <<= shift - e;
+  else an = (an + (uint64_t(1) << (e - shift - 1))) >> (e - shift);
+  if (!ad || (an + ad / 2) >> 31 >= ad)
+    return negative ? INT32_MIN : INT32_MAX;
+  int32_t q = _div64(int64_t(an + ad / 2), int32_t(ad));
+  return negative ? -q : q;
+}
+
+// 2x2 Matrix
+//-----------------------------------------------------------------------------
+/// \brief The matrix (a b; c d), for affine backgrounds and sprites.
+/// \details
+/// Matrices compose by multiplication, so `rotation(t) * scaling(s)` scales
+/// and then rotates. For the hardware, the matrix maps screen offsets to
+/// texture offsets, i.e. it is the inverse of the transform applied to the
+/// image (see \ref transform, which computes it).
+//-----------------------------------------------------------------------------
+struct mat2 {
+//-----------------------------------------------------------------------------
+  q12 a, b, c, d;
+
+  constexpr mat2() : a(1), b(), c(), d(1) {}
+  constexpr mat2(q12 a, q12 b, q12 c, q12 d) : a(a), b(b), c(c), d(d) {}
+
+  /// Anticlockwise rotation (for y up) by \p t
+  static mat2 rotation(angle t) {
+    q12 co = cos(t), si = sin(t);
+    return mat2(co, -si, si, co);
+  }
+  /// Scaling by \p s.x horizontally and \p s.y vertically
+  static constexpr mat2 scaling(vec2<q12> s) {
+    return mat2(s.x, 0, 0, s.y);
+  }
+  /// \brief Shear by \p s.y vertically and then \p s.x horizontally, i.e.
+  /// (x, y) goes to (x + s.x (y + s.y x), y + s.y x)
+  static constexpr mat2 shear(vec2<q12> s) {
+    return mat2(1, s.x, 0, 1) * mat2(1, 0, s.y, 1);
+  }
+
+  constexpr mat2 operator*(const mat2& m) const {
+    return mat2(a * m.a + b * m.c, a * m.b + b * m.d,
+                c * m.a + d * m.c, c * m.b + d * m.d);
+  }
+  constexpr vec2<q12> operator*(vec2<q12> v) const {
+    return vec2<q12>(a * v.x + b * v.y, c * v.x + d * v.y);
+  }
+  constexpr q12 det() const { return a * d - b * c; }
+  /// \brief Inverse, dividing by the determinant with the divider. \details
+  /// Each entry is rounded to nearest from the exact quotient, and saturates
+  /// if it is beyond the q12 range; a singular matrix gives the zero matrix.
+  mat2 inverse() const {
+    int64_t det = int64_t(a.raw()) * d.raw() - int64_t(b.raw()) * c.raw();
+    if (!det) return mat2(0, 0, 0, 0);
+    // Entries over the 8.24 determinant, in 20.12
+    auto entry = [det](int64_t x) {
+      return q12::from_raw(_div_round(x, det, 24));
+    };
+    return mat2(entry(d.raw()), entry(-int64_t(b.raw())),
+                entry(-int64_t(c.raw())), entry(a.raw()));
+  }
+
+  constexpr bool operator==(const mat2& m) const {
+    return a == m.a && b == m.b && c == m.c && d == m.d;
+  }
+  constexpr bool operator!=(const mat2& m) const { return !(*this == m); }
+
+  /// PA and PB (low half) packed for one 32-bit store
+  constexpr uint32_t pa_pb() const {
+    return uint16_t(to_8_8(a)) | uint32_t(uint16_t(to_8_8(b))) << 16;
+  }
+  /// PC and PD (low half) packed for one 32-bit store
+  constexpr uint32_t pc_pd() const {
+    return uint16_t(to_8_8(c)) | uint32_t(uint16_t(to_8_8(d))) << 16;
+  }
+};
+
+/// \brief Write \p n matrices to the affine groups of OAM at \p oam (e.g.
+/// OAM or OAM_SUB), starting at group \p first
+inline void write_affine(volatile uint16_t* oam, const mat2* m, int first,
+                         int n) {
+  for (int g = first; g < first + n; ++g, ++m) {
+    volatile uint16_t* p = oam + 16 * g + 3;
+    p[0] = uint16_t(to_8_8(m->a));
+    p[4] = uint16_t(to_8_8(m->b));
+    p[8] = uint16_t(to_8_8(m->c));
+    p[12] = uint16_t(to_8_8(m->d));
+  }
+}
+
+/// \brief Affine registers (BGxPA to BGxY) of background \p bg (2 or 3) of
+/// the main or sub engine, as four words
+inline volatile uint32_t* bg_affine_io(int bg, bool sub = false) {
+  return (sub ? display::sub_io() : display::main_io()) + 4 * bg;
+}
+
+// 2D Transform
+//-----------------------------------------------------------------------------
+/// \brief Places an image on screen by scale, shear and rotation about a
+/// pivot, and computes the affine parameters for it. \details
+///
+///     transform t;
+///     t.set_pivot(vec2<q12>(128, 128));  // texture point to turn about
+///     t.set_position(vec2<q12>(128, 96)); // where it appears on screen
+///     ...
+///     t.set_rotation(a);
+///     t.write(bg_affine_io(2));          // in vertical blanking
+///
+/// The image is scaled, then sheared, then rotated about the pivot, which is
+/// then moved to the position. The hardware parameters are the inverse
+/// matrix and the texture point shown at the screen origin; they are
+/// recomputed only when read after a setter changed a value. The inverse is
+/// built from the inverses of the parts, and divided last, with the
+/// divider. Each parameter is within 1 LSB (2^-12) of the exact inverse of
+/// `mat2::rotation(t) * mat2::shear(h) * mat2::scaling(s)`, at any scale;
+/// parameters beyond the q12 range saturate, and a zero scale is taken as
+/// 2^-12. No intermediate overflows for shear factors within +-128 and
+/// positions within +-2048 pixels.
+//-----------------------------------------------------------------------------
+class transform {
+//-----------------------------------------------------------------------------
+  vec2<q12> scale_ = vec2<q12>(1, 1), shear_, pivot_, position_;
+  angle rotation_ = 0;
+  bool changed = true;
+  mat2 inverse_;
+  vec2<q12> origin_;
+
+  template <class T> void assign(T& field, const T& value) {
+    if (field.x != value.x || field.y != value.y) {
+      field = value;
+      changed = true;
+    }
+  }
+
+  void update() {
+    if (!changed) return;
+    changed = false;
+    // (R Hx Hy S)^-1 = S^-1 Hy^-1 Hx^-1 R(-t) / (c^2 + s^2), since the q12
+    // sine and cosine are not exactly of unit length. The rows of
+    // P = Hy^-1 Hx^-1 R(-t) are computed exactly, in 8.24 and 8.36, and
+    // divided last, by the scale factor times c^2 + s^2, so that each entry
+    // is rounded once.
+    int64_t c = cos(rotation_).raw(), s = sin(rotation_).raw();
+    int64_t hx = shear_.x.raw(), hy = shear_.y.raw();
+    int64_t k = 4096 * 4096 + hx * hy; // 1 + hx hy, in 8.24
+    int64_t p[4] = {
+      c * 4096 + hx * s, s * 4096 - hx * c,  // 8.24
+      -hy * c * 4096 - k * s, k * c - hy * s * 4096 }; // 8.36
+    // A zero scale is taken as the smallest, rather than dividing by zero
+    int64_t n = c * c + s * s; // 8.24
+    int64_t dx = n * (scale_.x.raw() ? scale_.x.raw() : 1); // 28.36
+    int64_t dy = n * (scale_.y.raw() ? scale_.y.raw() : 1);
+    inverse_ = mat2(q12::from_raw(_div_round(p[0], dx, 24)),
+                    q12::from_raw(_div_round(p[1], dx, 24)),
+                    q12::from_raw(_div_round(p[2], dy, 12)),
+                    q12::from_raw(_div_round(p[3], dy, 12)));
+    // origin = pivot - (R H S)^-1 position, again dividing last. The second
+    // row times the position, in 8.48, is split to be summed in 8.36.
+    int64_t x = position_.x.raw(), y = position_.y.raw();
+    int64_t row0 = p[0] * x + p[1] * y;
+    int64_t row1 = (p[2] >> 12) * x + (p[3] >> 12) * y
+      + (((p[2] & 4095) * x + (p[3] & 4095) * y + 2048) >> 12);
+    origin_ = vec2<q12>(pivot_.x - q12::from_raw(_div_round(row0, dx, 12)),
+                        pivot_.y - q12::from_raw(_div_round(row1, dy, 12)));
+  }
+
+public:
+  /// Scale factors, horizontal and vertical
+  void set_scale(vec2<q12> s) { assign(scale_, s); }
+  /// \brief Shear factors, horizontal and vertical, applied as
+  /// \ref mat2::shear (vertically first)
+  void set_shear(vec2<q12> s) { assign(shear_, s); }
+  /// Anticlockwise rotation (for y up)
+  void set_rotation(angle t) {
+    if (t == rotation_) return;
+    rotation_ = t;
+    changed = true;
+  }
+  /// Texture point the image is scaled and rotated about
+  void set_pivot(vec2<q12> p) { assign(pivot_, p); }
+  /// Screen point at which the pivot appears
+  void set_position(vec2<q12> p) { assign(position_, p); }
+
+  vec2<q12> scale() const { return scale_; }
+  vec2<q12> shear() const { return shear_; }
+  angle rotation() const { return rotation_; }
+  vec2<q12> pivot() const { return pivot_; }
+  vec2<q12> position() const { return position_; }
+
+  /// Matrix mapping screen offsets to texture offsets (PA-PD)
+  const mat2& matrix() { update(); return inverse_; }
+  /// Texture point shown at the screen origin (BGxX, BGxY)
+  vec2<q12> origin() { update(); return origin_; }
+
+  /// Write the parameters to background affine registers \p io
+  void write(volatile uint32_t* io) {
+    update();
+    io[0] = inverse_.pa_pb();
+    io[1] = inverse_.pc_pd();
+    io[2] = uint32_t(to_20_8(origin_.x));
+    io[3] = uint32_t(to_20_8(origin_.y));
+  }
+  /// Set the parameters of background \p bg (2 or 3) in shadow \p s
+  void write(display::shadow& s, int bg) {
+    update();
+    auto r = [bg](display::shadow::reg base) {
+      return display::shadow::reg(base + 0x10 * (bg - 2));
+    };
+    s.set32(r(display::shadow::BG2PA), inverse_.pa_pb());
+    s.set32(r(display::shadow::BG2PC), inverse_.pc_pd());
+    s.set32(r(display::shadow::BG2X), uint32_t(to_20_8(origin_.x)));
+    s.set32(r(display::shadow::BG2Y), uint32_t(to_20_8(origin_.y)));
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,461 @@
+#ifndef CUSTARD_AUDIO_HPP
+#define CUSTARD_AUDIO_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <custard/types.hpp>
+
+#ifdef ARM9
+#include <nds/arm9/cache.h>
+#include <nds/arm9/sound.h>
+#include <nds/timers.h>
+#endif
+
+/// \brief First of the two cascaded hardware timers used to follow playback
+/// of \ref custard::audio::output
+#ifndef CUSTARD_AUDIO_TIMER
+#define CUSTARD_AUDIO_TIMER 2
+#endif
+
+namespace custard {
+
+/// Software audio mixing
+//-----------------------------------------------------------------------------
+/// This namespace contains a mixer that combines any number of voices into
+/// one stereo stream on the ARM9, played through two hardware channels, so
+/// that the number of sounds at once is not limited by the 16 channels and
+/// long tracks can be streamed rather than held in RAM:
+///
+///     audio::mixer<16> mix(32768);
+///     audio::output<> out;
+///     audio::clip jump;
+///     audio::parse(jump_wav, jump_wav_size, jump); // from a _wav.h header
+///     out.start(mix);
+///     ...
+///     mix.play(jump, 128, 64);
+///     out.update(mix); // once per frame
+///
+/// Voices play mono 8-bit or 16-bit PCM, as linked in by the `.wav` rules in
+/// custard.mk, at any sample rate, with linear interpolation. Gains are 8-bit
+/// fractions, as in q8, and are summed in 32-bit accumulators with headroom
+/// for 256 voices at full volume; the sum is saturated to 16 bits.
+///
+/// \ref stream decodes IMA-ADPCM from a file, e.g. on NitroFS, a chunk at a
+/// time into a small ring buffer that a voice plays in a loop.
+//-----------------------------------------------------------------------------
+  namespace audio {
+//-----------------------------------------------------------------------------
+
+    /// Sample encodings, as in the format tag of a WAV file
+    enum encoding { pcm = 1, ima_adpcm = 0x11 };
+
+    /// \brief Sound data. \details 8-bit PCM is unsigned, as in WAV files;
+    /// 16-bit PCM is signed.
+    struct clip {
+      const void* data;
+      uint32_t bytes, samples; ///< Size of data; samples per channel
+      int rate, channels, bits;
+      int encoding, block;     ///< Format tag and block size in bytes
+    };
+
+    // INTERNAL: little-endian fields at any alignment
+    inline uint32_t _u16(const uint8_t* p) { return p[0] | p[1] << 8; }
+    inline uint32_t _u32(const uint8_t* p) {
+      return _u16(p) | _u16(p + 2) << 16;
+    }
+
+    /// \brief Describe the \p size bytes of WAV file at \p file in \p c.
+    /// Returns false if no format or data chunk is found. \details
+    /// If the file is truncated, the data is cut to the bytes present, so
+    /// that a file header can be parsed from its first few hundred bytes.
+    inline bool parse(const void* file, size_t size, clip& c) {
+      auto p = static_cast<const uint8_t*>(file), end = p + size;
+      if (size < 12 || _u32(p) != 0x46464952 || _u32(p + 8) != 0x45564157)
+        return false; // "RIFF", "WAVE"
+      bool format = false;
+      for (p += 12; end - p >= 8; ) {
+        uint32_t id = _u32(p), n = _u32(p + 4);
+        p += 8;
+        if (id == 0x20746d66 && n >= 16 && end - p >= 16) { // "fmt "
+          c.encoding = _u16(p);
+          c.channels = _u16(p + 2);
+          c.rate = _u32(p + 4);
+          c.block = _u16(p + 12);
+          c.bits = _u16(p + 14);
+          format = c.channels > 0 && c.block > 0;
+        }
+        else if (id == 0x61746164 && format) { // "data"
+          c.data = p;
+          c.bytes = uint32_t(end - p) < n ? uint32_t(end - p) : n;
+          if (c.encoding == ima_adpcm) {
+            uint32_t per_block = (c.block / c.channels - 4) * 2 + 1;
+            c.samples = c.bytes / c.block * per_block;
+          }
+          else c.samples = c.bytes / c.block;
+          return true;
+        }
+        if (uint32_t(end - p) < n) break;
+        p += n + (n & 1);
+      }
+      return false;
+    }
+
+    // IMA-ADPCM
+    //-------------------------------------------------------------------------
+
+    // INTERNAL
+    constexpr int16_t _ima_steps[89] = {
+      7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37,
+      41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173,
+      190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+      724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+      2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+      7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818,
+      18500, 20350, 22385, 24623, 27086, 29794, 32767 };
+    constexpr int8_t _ima_index[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+    /// \brief Decode the mono IMA-ADPCM block of \p bytes bytes at \p src,
+    /// writing sample k to out[(at + k) & mask]. Returns the number of
+    /// samples, 2 * (bytes - 4) + 1.
+    inline int decode_block(const uint8_t* src, int bytes, int16_t* out,
+                            uint32_t at = 0, uint32_t mask = ~0u) {
+      if (bytes < 4) return 0;
+      int predictor = int16_t(_u16(src));
+      int index = custard::min<int>(src[2], 88);
+      out[at++ & mask] = int16_t(predictor);
+      for (int i = 4; i < bytes; ++i)
+        for (int nibble = src[i] & 15, k = 0; k < 2;
+             nibble = src[i] >> 4, ++k) {
+          int step = _ima_steps[index], diff = step >> 3;
+          if (nibble & 1) diff += step >> 2;
+          if (nibble & 2) diff += step >> 1;
+          if (nibble & 4) diff += step;
+          predictor += nibble & 8 ? -diff : diff;
+          predictor = custard::min(custard::max(predictor, -32768), 32767);
+          index = custard::min(custard::max(index + _ima_index[nibble & 7],
+                                            0), 88);
+          out[at++ & mask] = int16_t(predictor);
+        }
+      return 2 * (bytes - 4) + 1;
+    }
+
+// ADPCM Stream
+//-----------------------------------------------------------------------------
+/// \brief Streams a mono IMA-ADPCM WAV file into a ring of \p Ring samples,
+/// reading \p Chunk bytes at a time. \details
+///
+///     audio::stream<> music;
+///     music.open(fopen("nitro:/music.wav", "rb"), true);
+///     int v = mix.play(music.source(), 128, 64, true);
+///     ...
+///     music.update(mix.position(v)); // once per frame, before mixing
+///
+/// \ref update decodes blocks into the part of the ring the voice has
+/// already played, so the ring must hold more than the samples mixed between
+/// updates plus one block. Once a file that does not loop is exhausted, or
+/// a looping one turns out to hold no whole block, the rest of the ring is
+/// filled with silence and \ref finished becomes true.
+//-----------------------------------------------------------------------------
+    template <uint32_t Ring = 8192, int Chunk = 1024>
+    class stream {
+//-----------------------------------------------------------------------------
+      static_assert(!(Ring & (Ring - 1)), "ring size is a power of two");
+      static_assert(Chunk >= 512, "a chunk holds the file header");
+
+      alignas(4) int16_t ring[Ring];
+      uint8_t chunk[Chunk];
+      FILE* file = nullptr;
+      clip format = {};
+      long begin = 0;           // file offset of the data
+      uint32_t remaining = 0;   // data bytes not yet read
+      int pos = 0, len = 0;     // unread bytes in chunk
+      uint32_t write = 0;       // next ring index to decode into
+      bool looping = false, end = true;
+
+      // Make a whole block available in chunk, reading if needed. A looping
+      // stream rewinds at most once, so that an empty or truncated data
+      // chunk ends the stream instead of rewinding forever.
+      bool next_block() {
+        for (bool rewound = false; ; rewound = true) {
+          if (len - pos >= format.block) return true;
+          for (int i = pos; i < len; ++i) chunk[i - pos] = chunk[i];
+          len -= pos;
+          pos = 0;
+          uint32_t n = custard::min<uint32_t>(Chunk - len, remaining);
+          n = fread(chunk + len, 1, n, file);
+          len += n;
+          remaining -= n;
+          if (len >= format.block) return true;
+          if (!looping || rewound || fseek(file, begin, SEEK_SET))
+            return false;
+          remaining = format.bytes;
+          len = pos = 0;
+        }
+      }
+
+    public:
+      /// \brief Start streaming \p f (the stream does not close it). Returns
+      /// false if \p f is not a mono IMA-ADPCM WAV file with blocks of at
+      /// most \p Chunk bytes.
+      bool open(FILE* f, bool loop = false) {
+        file = f;
+        end = true;
+        if (!f) return false;
+        size_t n = fread(chunk, 1, Chunk, f);
+        if (!parse(chunk, n, format) || format.encoding != ima_adpcm
+            || format.channels != 1 || format.block > Chunk
+            || 2 * (format.block - 4) + 1 >= int(Ring)) return false;
+        begin = long(static_cast<const uint8_t*>(format.data) - chunk);
+        uint32_t size = _u32(chunk + begin - 4);
+        format.bytes = size - size % format.block;
+        pos = int(begin);
+        len = int(custard::min<size_t>(n, begin + format.bytes));
+        remaining = format.bytes - (len - pos);
+        looping = loop;
+        end = false;
+        write = 0;
+        update(0);
+        return true;
+      }
+
+      /// \brief Decode into the ring up to, but not including, index \p read,
+      /// the position of the voice playing it
+      void update(uint32_t read) {
+        int per_block = 2 * (format.block - 4) + 1;
+        while ((read - write - 1) % Ring >= uint32_t(per_block)) {
+          if (end || !next_block()) {
+            end = true;
+            while ((read - write - 1) % Ring) ring[write++ % Ring] = 0;
+            return;
+          }
+          write += decode_block(chunk + pos, format.block, ring, write,
+                                Ring - 1);
+          pos += format.block;
+        }
+      }
+
+      /// The ring, to play in a loop
+      clip source() const {
+        return {ring, Ring * 2, Ring, format.rate, 1, 16, pcm, 2};
+      }
+      /// Sample rate of the file
+      int rate() const { return format.rate; }
+      /// Has all of the file been decoded?
+      bool finished() const { return end; }
+    };
+
+// Mixer
+//-----------------------------------------------------------------------------
+/// \brief Mixes up to \p Voices voices into stereo output at a fixed rate,
+/// \p Samples samples at a time. \details
+/// Volume is 0-128 and pan 0 (left) to 127 (right), as for hardware
+/// channels. Voice positions advance by a 20.12 fixed-point step per output
+/// sample, so a voice can be resampled by a factor of up to several thousand.
+/// The remainder of the step is carried, so a position is always the exact
+/// one rounded down to 1/4096 of a sample and never drifts.
+//-----------------------------------------------------------------------------
+    template <int Voices = 16, int Samples = 256>
+    class mixer {
+//-----------------------------------------------------------------------------
+      struct voice {
+        const uint8_t* data;
+        uint32_t length, loop;  // samples; loop start, or length if none
+        uint32_t index, frac;   // position, 20.12
+        uint32_t step;          // samples per output sample, 20.12
+        uint32_t rest, carry;   // remainder of step, and its sum, / out_rate
+        int volume, pan;
+        int left, right;        // gains, 8-bit fractions
+        uint8_t bits;
+        bool active;
+      } voices[Voices] = {};
+      int32_t acc[2 * Samples];
+      int out_rate;
+
+      static void gains(voice& v) {
+        v.left = v.volume * (127 - v.pan) >> 6;
+        v.right = v.volume * v.pan >> 6;
+      }
+
+      template <class T, int Bias>
+      void mix_voice(voice& v, int32_t* a, int n) const {
+        auto s = reinterpret_cast<const T*>(v.data);
+        uint32_t i = v.index, frac = v.frac, carry = v.carry;
+        uint32_t rate = uint32_t(out_rate);
+        bool loops = v.loop < v.length;
+        for (int k = 0; k < n; ++k) {
+          uint32_t j = i + 1 < v.length ? i + 1 : loops ? v.loop : i;
+          constexpr int scale = 1 << (16 - 8 * sizeof(T));
+          int x0 = (s[i] - Bias) * scale, x1 = (s[j] - Bias) * scale;
+          int x = x0 + ((x1 - x0) * int(frac) >> 12);
+          a[2 * k] += x * v.left;
+          a[2 * k + 1] += x * v.right;
+          frac += v.step;
+          carry += v.rest;
+          if (carry >= rate) { carry -= rate; ++frac; }
+          i += frac >> 12;
+          frac &= 0xfff;
+          if (i >= v.length) {
+            if (!loops) { v.active = false; break; }
+            i = v.loop + (i - v.length) % (v.length - v.loop);
+          }
+        }
+        v.index = i;
+        v.frac = frac;
+        v.carry = carry;
+      }
+
+    public:
+      static constexpr int none = -1; ///< Returned when no voice is free
+
+      /// Mix at \p rate samples per second
+      explicit mixer(int rate = 32768) : out_rate(rate) {}
+      /// Output sample rate
+      int rate() const { return out_rate; }
+
+      /// \brief Play mono PCM clip \p c, from \p loop_start to the end and
+      /// then from \p loop_start again if \p loop, returning its voice or
+      /// \ref none
+      int play(const clip& c, int volume = 128, int pan = 64,
+               bool loop = false, uint32_t loop_start = 0) {
+        if (c.encoding != pcm || c.channels != 1 || !c.samples
+            || (c.bits != 8 && c.bits != 16)) return none;
+        for (int i = 0; i < Voices; ++i) {
+          voice& v = voices[i];
+          if (v.active) continue;
+          v.data = static_cast<const uint8_t*>(c.data);
+          v.length = c.samples;
+          v.loop = loop && loop_start < c.samples ? loop_start : c.samples;
+          v.index = v.frac = v.carry = 0;
+          v.bits = uint8_t(c.bits);
+          v.volume = volume;
+          v.pan = pan;
+          gains(v);
+          v.active = true;
+          pitch(i, c.rate);
+          return i;
+        }
+        return none;
+      }
+
+      /// Stop voice \p v
+      void stop(int v) { voices[v].active = false; }
+      /// Stop all voices
+      void stop() { for (voice& v : voices) v.active = false; }
+      /// Is voice \p v playing?
+      bool playing(int v) const { return voices[v].active; }
+      /// Sample index of voice \p v in its clip
+      uint32_t position(int v) const { return voices[v].index; }
+      /// Set the volume (0-128) of voice \p v
+      void volume(int v, int volume) {
+        voices[v].volume = volume;
+        gains(voices[v]);
+      }
+      /// Set the pan (0-127) of voice \p v
+      void pan(int v, int pan) {
+        voices[v].pan = pan;
+        gains(voices[v]);
+      }
+      /// Play voice \p v at \p rate source samples per second
+      void pitch(int v, int rate) {
+        voices[v].step = uint32_t((uint64_t(rate) << 12) / out_rate);
+        voices[v].rest = uint32_t((uint64_t(rate) << 12) % out_rate);
+      }
+
+      /// \brief Mix the next \p n samples of each channel to \p left and
+      /// \p right
+      void mix(int16_t* left, int16_t* right, int n) {
+        for (int done = 0; done < n; done += Samples) {
+          int m = custard::min(n - done, Samples);
+          for (int k = 0; k < 2 * m; ++k) acc[k] = 0;
+          for (voice& v : voices) {
+            if (!v.active) continue;
+            if (v.bits == 8) mix_voice<uint8_t, 128>(v, acc, m);
+            else mix_voice<int16_t, 0>(v, acc, m);
+          }
+          for (int k = 0; k < m; ++k) {
+            int l = acc[2 * k] >> 8, r = acc[2 * k + 1] >> 8;
+            left[done + k] = int16_t(custard::min(custard::max(l, -32768),
+                                                  32767));
+            right[done + k] = int16_t(custard::min(custard::max(r, -32768),
+                                                   32767));
+          }
+        }
+      }
+    };
+
+#ifdef ARM9
+// Hardware Output
+//-----------------------------------------------------------------------------
+/// \brief Plays a mixer through two hardware channels panned left and right,
+/// from rings of two halves of \p Samples samples each. \details
+/// While the hardware plays one half, \ref update mixes the other. Playback
+/// is followed with the timers \ref CUSTARD_AUDIO_TIMER and the next, run at
+/// exactly the rate of the sound channels; \ref update must be called before
+/// a half has played, e.g. once per frame for the default of 1024 samples at
+/// 32768 Hz. The output object must be in main RAM, where the ARM7 can read
+/// it.
+//-----------------------------------------------------------------------------
+    template <int Samples = 1024>
+    class output {
+//-----------------------------------------------------------------------------
+      static_assert(!(Samples & (Samples - 1)) && Samples <= 32768,
+                    "half size is a power of two");
+      alignas(32) int16_t rings[2][2 * Samples]; // left, right
+      int channels[2] = {-1, -1};
+      uint16_t halves = 0;                        // halves mixed
+
+      template <class M> void refill(M& m, int half) {
+        int16_t* l = rings[0] + half * Samples;
+        int16_t* r = rings[1] + half * Samples;
+        m.mix(l, r, Samples);
+        DC_FlushRange(l, Samples * 2);
+        DC_FlushRange(r, Samples * 2);
+      }
+
+    public:
+      /// Start playing \p m
+      template <class M> void start(M& m) {
+        constexpr int t = CUSTARD_AUDIO_TIMER;
+        refill(m, 0);
+        refill(m, 1);
+        halves = 2;
+        soundEnable();
+        TIMER_CR(t) = TIMER_CR(t + 1) = 0;
+        // Sound timers tick at half the ARM9 timer rate
+        TIMER_DATA(t) = uint16_t(-2 * (0x1000000 / m.rate()));
+        TIMER_DATA(t + 1) = 0;
+        TIMER_CR(t + 1) = TIMER_ENABLE | TIMER_CASCADE;
+        channels[0] = soundPlaySample(rings[0], SoundFormat_16Bit,
+                                      sizeof rings[0], m.rate(), 127, 0,
+                                      true, 0);
+        channels[1] = soundPlaySample(rings[1], SoundFormat_16Bit,
+                                      sizeof rings[1], m.rate(), 127, 127,
+                                      true, 0);
+        TIMER_CR(t) = TIMER_ENABLE | TIMER_DIV_1;
+      }
+
+      /// Mix into each half that has finished playing
+      template <class M> void update(M& m) {
+        constexpr int t = CUSTARD_AUDIO_TIMER;
+        uint16_t played = uint16_t(TIMER_DATA(t + 1) / Samples + 2);
+        constexpr uint16_t wrap = 65536 / Samples;
+        uint16_t behind = uint16_t(played - halves) % wrap;
+        if (behind > 2) halves = uint16_t(played - 2); // underrun
+        for (; halves % wrap != played % wrap; ++halves)
+          refill(m, halves & 1);
+      }
+
+      /// Stop playing
+      void stop() {
+        constexpr int t = CUSTARD_AUDIO_TIMER;
+        for (int& c : channels) if (c >= 0) soundKill(c), c = -1;
+        TIMER_CR(t) = TIMER_CR(t + 1) = 0;
+      }
+    };
+#endif
+  }
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef CUSTARD_BATCH_HPP
+#define CUSTARD_BATCH_HPP
+
+#include <cstddef>
+
+#include <custard/types.hpp>
+
+namespace custard {
+
+// Structure-of-arrays vector container
+//-----------------------------------------------------------------------------
+/// \brief A fixed-capacity array of vec2, stored as separate arrays of x and y
+/// components. \details
+///
+/// Storing the components separately lets the kernels in custard::batch stream
+/// through memory with multiple-word loads and stores, instead of loading and
+/// storing each vec2 in turn. Both arrays are aligned to the 32-byte cache
+/// lines of the ARM946E-S.
+///
+/// Elements are unordered: \ref erase moves the last element into the gap, so
+/// that removing an entity is O(1).
+//-----------------------------------------------------------------------------
+template <class T, size_t N> class vec2_array {
+//-----------------------------------------------------------------------------
+  size_t n = 0;
+public:
+  alignas(32) T x[N]; ///< x components of elements [0, size)
+  alignas(32) T y[N]; ///< y components of elements [0, size)
+
+  size_t size() const { return n; }
+  static constexpr size_t capacity() { return N; }
+  bool empty() const { return !n; }
+  bool full() const { return n == N; }
+  void clear() { n = 0; }
+
+  vec2<T> operator[](size_t i) const { return vec2<T>(x[i], y[i]); }
+  void set(size_t i, vec2<T> v) { x[i] = v.x; y[i] = v.y; }
+
+  /// Append an element and return its index (the array must not be full)
+  size_t push_back(vec2<T> v) { set(n, v); return n++; }
+  /// Remove an element by moving the last element into its place
+  void erase(size_t i) { --n; x[i] = x[n]; y[i] = y[n]; }
+};
+
+/// Batched kernels for arrays of scalars and vec2_array
+//-----------------------------------------------------------------------------
+/// Each kernel processes four elements per iteration, loading all four before
+/// storing any, so that on the ARM9 the compiler can merge the accesses into
+/// ldm/stm bursts and use the DSP multiplies for q12, and on the host it can
+/// vectorize the loop.
+//-----------------------------------------------------------------------------
+  namespace batch {
+//-----------------------------------------------------------------------------
+
+    /// x[i] += a * y[i] for i in [0, n)
+    template <class T>
+    inline void axpy(T* __restrict x, const T* __restrict y, T a, size_t n) {
+      size_t i = 0;
+      for (; i + 4 <= n; i += 4) {
+        T y0 = y[i], y1 = y[i + 1], y2 = y[i + 2], y3 = y[i + 3];
+        T x0 = x[i], x1 = x[i + 1], x2 = x[i + 2], x3 = x[i + 3];
+        x[i] = x0 + a * y0; x[i + 1] = x1 + a * y1;
+        x[i + 2] = x2 + a * y2; x[i + 3] = x3 + a * y3;
+      }
+      for (; i < n; ++i) x[i] += a * y[i];
+    }
+
+    /// x[i] = min(max(x[i], lo), hi) for i in [0, n)
+    template <class T>
+    inline void clamp(T* __restrict x, T lo, T hi, size_t n) {
+      size_t i = 0;
+      for (; i + 4 <= n; i += 4) {
+        T x0 = x[i], x1 = x[i + 1], x2 = x[i + 2], x3 = x[i + 3];
+        x[i] = min(max(x0, lo), hi); x[i + 1] = min(max(x1, lo), hi);
+        x[i + 2] = min(max(x2, lo), hi); x[i + 3] = min(max(x3, lo), hi);
+      }
+      for (; i < n; ++i) x[i] = min(max(x[i], lo), hi);
+    }
+
+    /// Find the least and greatest of x[i] for i in [0, n), with n > 0
+    template <class T>
+    inline void bounds(const T* __restrict x, size_t n, T& lo, T& hi) {
+      T l0 = x[0], l1 = x[0], h0 = x[0], h1 = x[0];
+      size_t i = 1;
+      for (; i + 2 <= n; i += 2) {
+        T x0 = x[i], x1 = x[i + 1];
+        l0 = min(l0, x0); h0 = max(h0, x0);
+        l1 = min(l1, x1); h1 = max(h1, x1);
+      }
+      if (i < n) { l0 = min(l0, x[i]); h0 = max(h0, x[i]); }
+      lo = min(l0, l1);
+      hi = max(h0, h1);
+    }
+
+    /// Integrate positions: p[i] += v[i] * dt
+    template <class T, size_t N> inline
+    void integrate(vec2_array<T, N>& p, const vec2_array<T, N>& v, T dt) {
+      axpy(p.x, v.x, dt, p.size());
+      axpy(p.y, v.y, dt, p.size());
+    }
+
+    /// \brief Apply an affine transform: p[i] = M p[i] + t \details
+    /// The matrix M is given by rows as (a b; c d).
+    template <class T, size_t N>
+    inline void transform(vec2_array<T, N>& p, T a, T b, T c, T d, vec2<T> t) {
+      T* __restrict x = p.x;
+      T* __restrict y = p.y;
+      size_t i = 0, n = p.size();
+      for (; i + 4 <= n; i += 4) {
+        T x0 = x[i], x1 = x[i + 1], x2 = x[i + 2], x3 = x[i + 3];
+        T y0 = y[i], y1 = y[i + 1], y2 = y[i + 2], y3 = y[i + 3];
+        x[i] = a * x0 + b * y0 + t.x; x[i + 1] = a * x1 + b * y1 + t.x;
+        x[i + 2] = a * x2 + b * y2 + t.x; x[i + 3] = a * x3 + b * y3 + t.x;
+        y[i] = c * x0 + d * y0 + t.y; y[i + 1] = c * x1 + d * y1 + t.y;
+        y[i + 2] = c * x2 + d * y2 + t.y; y[i + 3] = c * x3 + d * y3 + t.y;
+      }
+      for (; i < n; ++i) {
+        T x0 = x[i], y0 = y[i];
+        x[i] = a * x0 + b * y0 + t.x;
+        y[i] = c * x0 + d * y0 + t.y;
+      }
+    }
+
+    /// Clamp each element to the rectangle [lo, hi] (inclusive)
+    template <class T, size_t N>
+    inline void clamp(vec2_array<T, N>& p, vec2<T> lo, vec2<T> hi) {
+      clamp(p.x, lo.x, hi.x, p.size());
+      clamp(p.y, lo.y, hi.y, p.size());
+    }
+
+    /// \brief Find the bounding rectangle [lo, hi] (inclusive) of a non-empty
+    /// array
+    template <class T, size_t N>
+    inline void bounds(const vec2_array<T, N>& p, vec2<T>& lo, vec2<T>& hi) {
+      bounds(p.x, p.size(), lo.x, hi.x);
+      bounds(p.y, p.size(), lo.y, hi.y);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,318 @@
+#ifndef CUSTARD_BITMAP_HPP
+#define CUSTARD_BITMAP_HPP
+
+#include <cstdint>
+
+#include <custard/display.hpp>
+#include <custard/types.hpp>
+#include <custard/vram.hpp>
+
+/// \brief Placement of the drawing routines in custard/bitmap.hpp \details
+/// Define this before including custard to place the span, blit and blend
+/// loops in a particular memory section, e.g.
+/// `#define CUSTARD_BITMAP_CODE ITCM_CODE` to run them from ITCM. The loops
+/// are then never inlined, since an inlined copy would run from the section
+/// of its caller. By default they are ordinary inline functions.
+#ifdef CUSTARD_BITMAP_CODE
+#define _CUSTARD_BITMAP_ROW CUSTARD_BITMAP_CODE __attribute__((noinline))
+#else
+#define _CUSTARD_BITMAP_ROW
+#endif
+
+namespace custard {
+
+/// Direct colour bitmap drawing
+//-----------------------------------------------------------------------------
+/// This namespace contains a software rasterizer for 256x192 direct colour
+/// (RGB15) surfaces, such as a VRAM bank displayed in framebuffer mode (see
+/// \ref framebuffer) or a 16-bit extended rotation background.
+///
+/// Every operation clips to the surface. Runs of pixels are written as
+/// aligned 32-bit words, eight words per loop iteration, so that the ARM9
+/// writes them with stm bursts; only an odd pixel at either end of a run is
+/// written on its own. VRAM ignores byte writes, and no operation makes any.
+//-----------------------------------------------------------------------------
+  namespace bitmap {
+//-----------------------------------------------------------------------------
+
+    constexpr int width = 256, height = 192;
+
+    /// \brief Mix RGB15 colours \p a and \p b, giving \p alpha / 32 of \p b
+    /// (bit 15 is cleared)
+    inline uint16_t blend(uint32_t a, uint32_t b, int alpha) {
+      int k = 32 - alpha;
+      uint32_t rb = ((a & 0x7c1f) * k + (b & 0x7c1f) * alpha) >> 5 & 0x7c1f;
+      uint32_t g = ((a & 0x03e0) * k + (b & 0x03e0) * alpha) >> 5 & 0x03e0;
+      return uint16_t(rb | g);
+    }
+
+    /// A read-only rectangle of RGB15 pixels, \p pitch pixels per row
+    struct image {
+      const uint16_t* pixels;
+      int width, height, pitch;
+
+      /// The \p w by \p h rectangle at (\p x, \p y), e.g. a sprite's frame
+      image sub(int x, int y, int w, int h) const {
+        return {pixels + y * pitch + x, w, h, pitch};
+      }
+    };
+
+    // INTERNAL: row loops
+    //-------------------------------------------------------------------------
+
+    // Pairs of pixels, accessed as words
+    typedef uint32_t __attribute__((may_alias)) _word;
+
+    _CUSTARD_BITMAP_ROW
+    inline void _fill_row(uint16_t* d, int n, uint16_t c) {
+      if (n <= 0) return;
+      if (uintptr_t(d) & 2) { *d++ = c; --n; }
+      uint32_t w = c | uint32_t(c) << 16;
+      _word* p = reinterpret_cast<_word*>(d);
+      int words = n >> 1;
+      for (; words >= 8; words -= 8, p += 8) {
+        p[0] = w; p[1] = w; p[2] = w; p[3] = w;
+        p[4] = w; p[5] = w; p[6] = w; p[7] = w;
+      }
+      for (words &= 7; words--; ) *p++ = w; // the mask bounds the tail
+      if (n & 1) *reinterpret_cast<uint16_t*>(p) = c;
+    }
+
+    _CUSTARD_BITMAP_ROW
+    inline void _copy_row(uint16_t* d, const uint16_t* s, int n) {
+      if (n <= 0) return;
+      if ((uintptr_t(d) ^ uintptr_t(s)) & 2) { // misaligned: halfwords
+        for (; n >= 4; n -= 4, d += 4, s += 4) {
+          uint16_t a = s[0], b = s[1], c = s[2], e = s[3];
+          d[0] = a; d[1] = b; d[2] = c; d[3] = e;
+        }
+        while (n--) *d++ = *s++;
+        return;
+      }
+      if (uintptr_t(d) & 2) { *d++ = *s++; --n; }
+      _word* p = reinterpret_cast<_word*>(d);
+      const _word* q = reinterpret_cast<const _word*>(s);
+      int words = n >> 1;
+      for (; words >= 8; words -= 8, p += 8, q += 8) {
+        uint32_t a = q[0], b = q[1], c = q[2], e = q[3];
+        uint32_t f = q[4], g = q[5], h = q[6], i = q[7];
+        p[0] = a; p[1] = b; p[2] = c; p[3] = e;
+        p[4] = f; p[5] = g; p[6] = h; p[7] = i;
+      }
+      for (words &= 7; words--; ) *p++ = *q++;
+      if (n & 1) *reinterpret_cast<uint16_t*>(p) = s[2 * (n >> 1)];
+    }
+
+    _CUSTARD_BITMAP_ROW
+    inline void _key_row(uint16_t* d, const uint16_t* s, int n,
+                         uint16_t key) {
+      for (; n >= 2; n -= 2, d += 2, s += 2) {
+        uint16_t a = s[0], b = s[1];
+        if (a != key) d[0] = a;
+        if (b != key) d[1] = b;
+      }
+      if (n && *s != key) *d = *s;
+    }
+
+    _CUSTARD_BITMAP_ROW
+    inline void _blend_row(uint16_t* d, const uint16_t* s, int n, int alpha) {
+      if (n <= 0) return;
+      if (uintptr_t(d) & 2) { *d = blend(*d, *s++, alpha); ++d; --n; }
+      _word* p = reinterpret_cast<_word*>(d);
+      for (; n >= 2; n -= 2, ++p, s += 2) {
+        uint32_t w = *p;
+        *p = blend(w, s[0], alpha)
+          | uint32_t(blend(w >> 16, s[1], alpha)) << 16;
+      }
+      if (n) *reinterpret_cast<uint16_t*>(p) = blend(uint16_t(*p), *s, alpha);
+    }
+
+    _CUSTARD_BITMAP_ROW
+    inline void _tint_row(uint16_t* d, int n, uint16_t c, int alpha) {
+      if (n <= 0) return;
+      if (uintptr_t(d) & 2) { *d = blend(*d, c, alpha); ++d; --n; }
+      _word* p = reinterpret_cast<_word*>(d);
+      for (; n >= 2; n -= 2, ++p) {
+        uint32_t w = *p;
+        *p = blend(w, c, alpha) | uint32_t(blend(w >> 16, c, alpha)) << 16;
+      }
+      if (n) *reinterpret_cast<uint16_t*>(p) = blend(uint16_t(*p), c, alpha);
+    }
+
+// Drawing Surface
+//-----------------------------------------------------------------------------
+/// \brief Draws on a 256x192 RGB15 surface \details
+/// The surface must be halfword aligned, and is best word aligned. Pixel
+/// rows are 256 pixels apart.
+//-----------------------------------------------------------------------------
+    class canvas {
+//-----------------------------------------------------------------------------
+      uint16_t* p;
+
+      // Clip the w by h rectangle at (x, y) to the surface; sx and sy receive
+      // the offset of the visible part. Returns false if nothing is visible.
+      static bool clip(int& x, int& y, int& w, int& h, int& sx, int& sy) {
+        sx = x < 0 ? -x : 0;
+        sy = y < 0 ? -y : 0;
+        x += sx; y += sy; w -= sx; h -= sy;
+        if (x + w > width) w = width - x;
+        if (y + h > height) h = height - y;
+        return w > 0 && h > 0;
+      }
+
+    public:
+      /// Draw on the surface at \p pixels
+      explicit canvas(uint16_t* pixels) : p(pixels) {}
+      /// \brief Draw on the surface at \p pixels (e.g. VRAM_A) \details
+      /// The qualifier is dropped so that runs can be written in bursts.
+      /// That is safe for VRAM, where reads and writes have no side effects
+      /// and the order of writes within a frame does not matter, as long as
+      /// nothing else, such as a DMA transfer, writes the same pixels
+      /// meanwhile. Do not use it for registers.
+      explicit canvas(volatile uint16_t* pixels)
+        : p(const_cast<uint16_t*>(pixels)) {}
+
+      /// The surface's pixels, row by row
+      uint16_t* pixels() const { return p; }
+      /// The surface as an image, e.g. to blit part of it elsewhere
+      image view() const { return {p, width, height, width}; }
+
+      /// Colour of pixel (\p x, \p y), which must be on the surface
+      uint16_t get(int x, int y) const { return p[y * width + x]; }
+      /// Set pixel (\p x, \p y) if it is on the surface
+      void pixel(int x, int y, uint16_t c) {
+        if (unsigned(x) < unsigned(width) && unsigned(y) < unsigned(height))
+          p[y * width + x] = c;
+      }
+
+      /// Fill pixels [\p x0, \p x1) of row \p y
+      void span(int x0, int x1, int y, uint16_t c) {
+        if (unsigned(y) >= unsigned(height)) return;
+        x0 = max(x0, 0);
+        x1 = min(x1, width);
+        _fill_row(p + y * width + x0, x1 - x0, c);
+      }
+
+      /// Fill the \p w by \p h rectangle at (\p x, \p y)
+      void fill(int x, int y, int w, int h, uint16_t c) {
+        int sx, sy;
+        if (!clip(x, y, w, h, sx, sy)) return;
+        for (uint16_t* d = p + y * width + x; h--; d += width)
+          _fill_row(d, w, c);
+      }
+      /// Fill the whole surface
+      void clear(uint16_t c) { _fill_row(p, width * height, c); }
+
+      /// \brief Blend \p c over the \p w by \p h rectangle at (\p x, \p y),
+      /// with opacity \p alpha / 32
+      void tint(int x, int y, int w, int h, uint16_t c, int alpha) {
+        int sx, sy;
+        if (!clip(x, y, w, h, sx, sy)) return;
+        for (uint16_t* d = p + y * width + x; h--; d += width)
+          _tint_row(d, w, c, alpha);
+      }
+
+      /// Draw a line from (\p x0, \p y0) to (\p x1, \p y1), both included
+      void line(int x0, int y0, int x1, int y1, uint16_t c) {
+        if (y0 == y1) {
+          span(min(x0, x1), max(x0, x1) + 1, y0, c);
+          return;
+        }
+        int dx = abs(x1 - x0), dy = -abs(y1 - y0);
+        int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+        bool inside = unsigned(x0) < unsigned(width)
+          && unsigned(x1) < unsigned(width) && unsigned(y0) < unsigned(height)
+          && unsigned(y1) < unsigned(height);
+        uint16_t* d = p + y0 * width + x0;
+        int step = sy * width;
+        for (int e = dx + dy; ; ) {
+          if (inside) *d = c;
+          else pixel(x0, y0, c);
+          if (x0 == x1 && y0 == y1) break;
+          int e2 = 2 * e;
+          if (e2 >= dy) { e += dy; x0 += sx; d += sx; }
+          if (e2 <= dx) { e += dx; y0 += sy; d += step; }
+        }
+      }
+
+      /// Draw \p src with its top left corner at (\p x, \p y)
+      void blit(const image& src, int x, int y) {
+        int w = src.width, h = src.height, sx, sy;
+        if (!clip(x, y, w, h, sx, sy)) return;
+        const uint16_t* s = src.pixels + sy * src.pitch + sx;
+        for (uint16_t* d = p + y * width + x; h--; d += width, s += src.pitch)
+          _copy_row(d, s, w);
+      }
+
+      /// \brief Draw \p src at (\p x, \p y), leaving the pixels whose colour
+      /// is \p key transparent
+      void blit(const image& src, int x, int y, uint16_t key) {
+        int w = src.width, h = src.height, sx, sy;
+        if (!clip(x, y, w, h, sx, sy)) return;
+        const uint16_t* s = src.pixels + sy * src.pitch + sx;
+        for (uint16_t* d = p + y * width + x; h--; d += width, s += src.pitch)
+          _key_row(d, s, w, key);
+      }
+
+      /// Blend \p src over the surface at (\p x, \p y), with opacity
+      /// \p alpha / 32
+      void blend(const image& src, int x, int y, int alpha) {
+        int w = src.width, h = src.height, sx, sy;
+        if (!clip(x, y, w, h, sx, sy)) return;
+        const uint16_t* s = src.pixels + sy * src.pitch + sx;
+        for (uint16_t* d = p + y * width + x; h--; d += width, s += src.pitch)
+          _blend_row(d, s, w, alpha);
+      }
+    };
+
+// Double-Buffered Framebuffer
+//-----------------------------------------------------------------------------
+/// \brief Displays one of VRAM banks A and B in framebuffer mode on the main
+/// engine while the other is drawn. \details
+///
+/// Both banks are mapped to LCDC, where the CPU can write them. \ref flip,
+/// called during vertical blanking, exchanges the banks by changing DISPCNT
+/// vram_block:
+///
+///     bitmap::framebuffer fb;
+///     while (true) {
+///       bitmap::canvas c = fb.back();
+///       ... // draw
+///       swiWaitForVBlank();
+///       fb.flip();
+///     }
+//-----------------------------------------------------------------------------
+    class framebuffer {
+//-----------------------------------------------------------------------------
+      int front = 0; // bank displayed: 0 = A, 1 = B
+
+      static volatile uint16_t* bank(int b) {
+        return vram::_pointer<uint16_t>(
+          vram::_lcdc_address(b ? vram::bank::B : vram::bank::A));
+      }
+
+    public:
+      /// Map banks A and B to LCDC and display bank A
+      framebuffer() {
+        vram::lcdc::A();
+        vram::lcdc::B();
+        display::set_main_vram_A();
+      }
+
+      /// Canvas for the bank not displayed
+      canvas back() const { return canvas(bank(front ^ 1)); }
+      /// Canvas for the bank displayed
+      canvas shown() const { return canvas(bank(front)); }
+
+      /// \brief Display the back bank. Call during vertical blanking, after
+      /// drawing is complete.
+      void flip() {
+        front ^= 1;
+        if (front) display::set_main_vram_B();
+        else display::set_main_vram_A();
+      }
+    };
+  }
+}
+
+#endif
@@ -1,7 +1,14 @@
 #ifndef CUSTARD_DISPLAY_HPP
 #define CUSTARD_DISPLAY_HPP
 
+#ifdef ARM9
 #include <nds/arm9/video.h>
+#include <nds/interrupts.h>
+#else
+#include <custard/host.hpp>
+#endif
+
+#include <custard/vram.hpp>
 
 namespace custard {
 
@@ -244,6 +251,347 @@ namespace custard {
     /// \brief Set the main (A) rendering engine to display an RGB15 frame
     /// buffer in main memory by DMA transfer
     inline void set_main_fifo() { REG_DISPCNT = 3 << 16; }
+
+// Compile-Time Configuration Presets
+//-----------------------------------------------------------------------------
+/// \brief A display control register value built at compile time. \details
+///
+/// The methods mirror the configuration methods of \ref config and
+/// \ref main_config, but each returns a new preset, so that a complete
+/// configuration is a constant expression:
+///
+///     constexpr auto title = display::preset::graphics_TTTE()
+///       .bg(0).bg(3).obj().obj_tiles_1d(64);
+///
+///     using title_mode = display::main_mode<title.mask(), level_vram>;
+///     title_mode::apply(); // one store of a constant
+///
+/// A \ref mode checks the value against a VRAM plan with static_assert.
+//-----------------------------------------------------------------------------
+    class preset {
+//-----------------------------------------------------------------------------
+      uint32_t bits;
+      constexpr preset with(uint32_t set, uint32_t clear = 0) const {
+        return preset((bits & ~clear) | set);
+      }
+      static constexpr preset graphics(int mode, bool three_d) {
+        return preset(1 << 16 | (three_d ? 8 : 0) | mode);
+      }
+
+    public:
+      /// Preset with the value \p mask, e.g. from a \ref config
+      explicit constexpr preset(uint32_t mask = 0) : bits(mask) {}
+
+      // 2D graphics display modes
+      static constexpr preset graphics_TTTT() { return graphics(0, false); }
+      static constexpr preset graphics_TTTA() { return graphics(1, false); }
+      static constexpr preset graphics_TTAA() { return graphics(2, false); }
+      static constexpr preset graphics_TTTE() { return graphics(3, false); }
+      static constexpr preset graphics_TTAE() { return graphics(4, false); }
+      static constexpr preset graphics_TTEE() { return graphics(5, false); }
+
+      // Main engine only: large bitmap and 3D graphics display modes
+      static constexpr preset graphics_Bmp() { return graphics(6, false); }
+      static constexpr preset graphics_3dTTT() { return graphics(0, true); }
+      static constexpr preset graphics_3dTTA() { return graphics(1, true); }
+      static constexpr preset graphics_3dTAA() { return graphics(2, true); }
+      static constexpr preset graphics_3dTTE() { return graphics(3, true); }
+      static constexpr preset graphics_3dTAE() { return graphics(4, true); }
+      static constexpr preset graphics_3dTEE() { return graphics(5, true); }
+      static constexpr preset graphics_3dBmp() { return graphics(6, true); }
+
+      /// \brief Main engine only: display an RGB15 frame buffer at the base
+      /// of VRAM bank \p B (A-D), which must be mapped to its LCDC address
+      template <vram::bank B>
+      static constexpr preset frame_buffer() {
+        static_assert(B <= vram::bank::D, "frame buffers are in banks A-D");
+        return preset(2 << 16 | int(B) << 18);
+      }
+
+      /// Enable display of background \p n
+      constexpr preset bg(int n) const { return with(0x100 << n); }
+      /// Enable display of sprites
+      constexpr preset obj() const { return with(1 << 12); }
+      /// Map tile sprites in 2D
+      constexpr preset obj_tiles_2d() const { return with(0, 0x300010); }
+      /// \brief Map tile sprites in 1D, with tile numbers in units of
+      /// \p stride bytes (32, 64, 128 or 256)
+      constexpr preset obj_tiles_1d(int stride = 32) const {
+        int b = stride >= 256 ? 3 : stride >= 128 ? 2 : stride >= 64 ? 1 : 0;
+        return with(0x10 | b << 20, 0x300000);
+      }
+      /// \brief Map bitmap sprites in 2D, in a bitmap \p width pixels wide
+      /// (128 or 256)
+      constexpr preset obj_bitmaps_2d(int width = 128) const {
+        return with(width >= 256 ? 0x20 : 0, 0x400060);
+      }
+      /// \brief Map bitmap sprites in 1D, with tile numbers in units of
+      /// \p stride bytes (128 or 256)
+      constexpr preset obj_bitmaps_1d(int stride = 128) const {
+        return with(0x40 | (stride >= 256 ? 0x400000 : 0), 0x400060);
+      }
+      /// Enable windows 0 and 1 and the sprite window
+      constexpr preset windows(bool w0, bool w1 = false,
+                               bool obj = false) const {
+        return with(w0 << 13 | w1 << 14 | obj << 15);
+      }
+      /// Enable background and sprite extended palettes
+      constexpr preset ext_palettes(bool bg, bool obj = false) const {
+        return with(uint32_t(bg) << 30 | uint32_t(obj) << 31);
+      }
+      /// \brief Main engine only: add global tile and map base offsets, in
+      /// units of 64K
+      constexpr preset bases(int char_base, int screen_base) const {
+        return with((char_base & 7) << 24 | (screen_base & 7) << 27,
+                    0x3f000000);
+      }
+      /// Allow access to OAM during horizontal blanking
+      constexpr preset hblank_oam() const { return with(1 << 23); }
+      /// Force blanking
+      constexpr preset blank() const { return with(1 << 7); }
+
+      /// Value of the display control register
+      constexpr uint32_t mask() const { return bits; }
+    };
+
+    /// Rendering engines
+    enum class engine { main, sub };
+
+    /// Inconsistencies found by \ref check
+    enum class error {
+      none,
+      main_only,           ///< Feature of the main engine used on the sub
+      no_bg_memory,        ///< Backgrounds shown, no BG VRAM mapped
+      no_large_bitmap,     ///< Large bitmap mode without 512K of BG VRAM
+      no_sprite_memory,    ///< Sprites shown, no sprite VRAM mapped
+      no_bg_ext_palette,   ///< BG extended palettes without a bank
+      no_obj_ext_palette,  ///< Sprite extended palettes without a bank
+      frame_buffer_bank,   ///< Frame buffer bank not mapped to LCDC
+      tile_obj_boundary,   ///< 1D tile sprite stride with 2D mapping
+      bmp_obj_boundary,    ///< 1D bitmap sprite stride with 2D mapping
+      bmp_obj_width        ///< 2D bitmap sprite width with 1D mapping
+    };
+
+    /// \brief First inconsistency of display control value \p mask on engine
+    /// \p e with VRAM plan \p Plan, or error::none
+    template <class Plan>
+    constexpr error check(engine e, uint32_t mask) {
+      using vram::region;
+      bool sub = e == engine::sub;
+      int bg_mode = mask & 7, display_mode = mask >> 16 & 3;
+      bool three_d = mask & 8;
+      if (sub && (bg_mode > 5 || three_d || display_mode > 1
+                  || mask & 0x3f000000)) return error::main_only;
+      if (display_mode == 2
+          && !Plan::maps(vram::bank(mask >> 18 & 3), region::lcdc))
+        return error::frame_buffer_bank;
+      if (display_mode == 1) {
+        uint32_t shown = mask >> 8 & (three_d ? 0xe : 0xf);
+        region bg = sub ? region::sub_bg : region::main_bg;
+        if (shown && !Plan::extent(bg)) return error::no_bg_memory;
+        if (bg_mode == 6 && shown & 4 && Plan::extent(bg) < 0x80000)
+          return error::no_large_bitmap;
+        if (mask & 1 << 12
+            && !Plan::extent(sub ? region::sub_sprite : region::main_sprite))
+          return error::no_sprite_memory;
+      }
+      if (mask & 1 << 30 && !Plan::extent(sub ? region::sub_bg_ext_palette
+                                          : region::main_bg_ext_palette))
+        return error::no_bg_ext_palette;
+      if (mask & 1u << 31
+          && !Plan::extent(sub ? region::sub_sprite_ext_palette
+                               : region::main_sprite_ext_palette))
+        return error::no_obj_ext_palette;
+      if (!(mask & 0x10) && mask & 0x300000) return error::tile_obj_boundary;
+      if (!(mask & 0x40) && mask & 0x400000) return error::bmp_obj_boundary;
+      if (mask & 0x40 && mask & 0x20) return error::bmp_obj_width;
+      return error::none;
+    }
+
+// Validated Display Mode
+//-----------------------------------------------------------------------------
+/// \brief The display control value \p Mask for engine \p E, checked against
+/// VRAM plan \p Plan at compile time (see \ref check). \details
+/// Use the aliases \ref main_mode and \ref sub_mode.
+//-----------------------------------------------------------------------------
+    template <engine E, uint32_t Mask, class Plan> struct mode {
+//-----------------------------------------------------------------------------
+      static constexpr uint32_t mask = Mask;
+      static constexpr error status = check<Plan>(E, Mask);
+
+      static_assert(status != error::main_only,
+        "display configuration is only supported by the main engine");
+      static_assert(status != error::no_bg_memory,
+        "backgrounds are enabled but no VRAM is mapped to the BG region");
+      static_assert(status != error::no_large_bitmap,
+        "large bitmap mode needs 512K of VRAM mapped to the BG region");
+      static_assert(status != error::no_sprite_memory,
+        "sprites are enabled but no VRAM is mapped to the sprite region");
+      static_assert(status != error::no_bg_ext_palette,
+        "BG extended palettes are enabled but no bank is mapped to them");
+      static_assert(status != error::no_obj_ext_palette,
+        "sprite extended palettes are enabled but no bank is mapped to them");
+      static_assert(status != error::frame_buffer_bank,
+        "the frame buffer bank is not mapped to its LCDC address");
+      static_assert(status != error::tile_obj_boundary,
+        "a 1D tile sprite boundary is set with 2D tile sprite mapping");
+      static_assert(status != error::bmp_obj_boundary,
+        "a 1D bitmap sprite boundary is set with 2D bitmap sprite mapping");
+      static_assert(status != error::bmp_obj_width,
+        "a 2D bitmap sprite width is set with 1D bitmap sprite mapping");
+
+      /// Instate this configuration
+      static void apply() {
+        if constexpr (E == engine::main) REG_DISPCNT = Mask;
+        else REG_DISPCNT_SUB = Mask;
+      }
+    };
+
+    template <uint32_t Mask, class Plan>
+    using main_mode = mode<engine::main, Mask, Plan>;
+    template <uint32_t Mask, class Plan>
+    using sub_mode = mode<engine::sub, Mask, Plan>;
+
+// Shadowed 2D Engine Registers
+//-----------------------------------------------------------------------------
+/// \brief A double-buffered copy of the display registers of one 2D engine,
+/// written to the hardware only during vertical blanking. \details
+///
+/// The shadow covers the engine's register block from DISPCNT up to BLDY:
+/// DISPCNT, BGxCNT, BG scroll, BG2/BG3 affine parameters, windows, mosaic and
+/// blending. DISPSTAT and VCOUNT, which share this block on the main engine,
+/// are never written.
+///
+/// Subsystems write to the back buffer at any time during the frame. Each
+/// 32-bit word that changes is marked dirty. When the frame's updates are
+/// complete, \ref present hands the back buffer to the front buffer, and the
+/// vertical blank interrupt handler calls \ref commit, which stores only the
+/// dirty words to the hardware. Because the two steps are separate, an
+/// interrupt that arrives while a subsystem is halfway through an update
+/// never commits a partial update.
+///
+/// The register block to commit to is given on construction. On the DS, it is
+/// the engine's hardware registers (\ref main_io and \ref sub_io). It may be
+/// any array of \ref shadow::words words elsewhere, e.g. to record the writes
+/// in a host build.
+//-----------------------------------------------------------------------------
+    class shadow {
+//-----------------------------------------------------------------------------
+    public:
+      /// Number of 32-bit words in the register block (0x00 to 0x57)
+      static constexpr int words = 22;
+
+      /// Byte offsets of the registers within the block
+      enum reg {
+        DISPCNT = 0x00,
+        BG0CNT = 0x08, BG1CNT = 0x0A, BG2CNT = 0x0C, BG3CNT = 0x0E,
+        BG0HOFS = 0x10, BG0VOFS = 0x12, BG1HOFS = 0x14, BG1VOFS = 0x16,
+        BG2HOFS = 0x18, BG2VOFS = 0x1A, BG3HOFS = 0x1C, BG3VOFS = 0x1E,
+        BG2PA = 0x20, BG2PB = 0x22, BG2PC = 0x24, BG2PD = 0x26,
+        BG2X = 0x28, BG2Y = 0x2C,
+        BG3PA = 0x30, BG3PB = 0x32, BG3PC = 0x34, BG3PD = 0x36,
+        BG3X = 0x38, BG3Y = 0x3C,
+        WIN0H = 0x40, WIN1H = 0x42, WIN0V = 0x44, WIN1V = 0x46,
+        WININ = 0x48, WINOUT = 0x4A, MOSAIC = 0x4C,
+        BLDCNT = 0x50, BLDALPHA = 0x52, BLDY = 0x54
+      };
+
+    private:
+      volatile uint32_t* io;
+      uint32_t back[words] = {}, front[words] = {};
+      uint32_t back_dirty = 0, front_dirty = 0;
+
+      // Interrupts are disabled while the front buffer changes
+      struct lock {
+        uint32_t ime = REG_IME;
+        lock() { REG_IME = 0; }
+        ~lock() {
+          REG_IME = ime;
+#ifndef ARM9
+          host::interrupt_point();
+#endif
+        }
+      };
+
+      void word(int i, uint32_t value) {
+        if (back[i] == value) return;
+        back[i] = value;
+        back_dirty |= 1u << i;
+      }
+
+    public:
+      /// Shadow the register block at \p io
+      explicit shadow(volatile uint32_t* io) : io(io) {}
+
+      /// Set a 32-bit register in the back buffer
+      void set32(reg r, uint32_t value) { word(r >> 2, value); }
+      /// Set a 16-bit register in the back buffer
+      void set16(reg r, uint16_t value) {
+        int shift = (r & 2) * 8;
+        uint32_t w = back[r >> 2] & ~(0xffffu << shift);
+        word(r >> 2, w | uint32_t(value) << shift);
+      }
+      /// Read a 32-bit register from the back buffer
+      uint32_t get32(reg r) const { return back[r >> 2]; }
+      /// Read a 16-bit register from the back buffer
+      uint16_t get16(reg r) const { return back[r >> 2] >> (r & 2) * 8; }
+
+      /// Set DISPCNT from a configuration overlay
+      void dispcnt(const _dispcnt_overlay& c) { set32(DISPCNT, c.mask); }
+      /// Set BGxCNT for background \p bg
+      void bg_control(int bg, uint16_t value) {
+        set16(reg(BG0CNT + 2 * bg), value);
+      }
+      /// Set the scroll offset of background \p bg
+      void bg_scroll(int bg, int x, int y) {
+        word((BG0HOFS >> 2) + bg, (x & 0x1ff) | (y & 0x1ff) << 16);
+      }
+      /// Set the blending control, coefficients and brightness
+      void blend(uint16_t control, uint16_t alpha, uint16_t brightness) {
+        word(BLDCNT >> 2, control | uint32_t(alpha) << 16);
+        set16(BLDY, brightness);
+      }
+
+      /// Words changed in the back buffer since the last \ref present
+      uint32_t dirty() const { return back_dirty; }
+
+      /// \brief Hand the back buffer's changes to the front buffer, to be
+      /// written by the next \ref commit. Interrupts are disabled meanwhile,
+      /// so that a commit sees all of the changes or none.
+      void present() {
+        lock l;
+        for (uint32_t m = back_dirty; m; m &= m - 1) {
+          int i = __builtin_ctz(m);
+          front[i] = back[i];
+#ifndef ARM9
+          host::interrupt_point();
+#endif
+        }
+        front_dirty |= back_dirty;
+        back_dirty = 0;
+      }
+
+      /// \brief Write the front buffer's dirty words to the registers. Call
+      /// during vertical blanking. Returns the number of words written.
+      int commit() {
+        int n = 0;
+        for (uint32_t m = front_dirty; m; m &= m - 1, ++n) {
+          int i = __builtin_ctz(m);
+          io[i] = front[i];
+        }
+        front_dirty = 0;
+        return n;
+      }
+
+      /// Mark every word dirty, e.g. after the registers were reset
+      void invalidate() { back_dirty = ((1u << words) - 1) & ~(1u << 1); }
+    };
+
+    /// Register block of the main (A) engine, for \ref shadow
+    inline volatile uint32_t* main_io() { return &REG_DISPCNT; }
+    /// Register block of the sub (B) engine, for \ref shadow
+    inline volatile uint32_t* sub_io() { return &REG_DISPCNT_SUB; }
+
   }
 }
 
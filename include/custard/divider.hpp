@@ -0,0 +1,86 @@
+#ifndef CUSTARD_DIVIDER_HPP
+#define CUSTARD_DIVIDER_HPP
+
+#include <cstddef>
+
+#include <custard/types.hpp>
+
+#ifndef ARM9
+#include <custard/host.hpp>
+#endif
+
+namespace custard {
+
+/// Split-phase access to the hardware divider
+//-----------------------------------------------------------------------------
+/// The DS divider computes a 64/32 division in about 34 cycles while the CPU
+/// keeps running. libnds' divf32 starts a division and then busy-waits for it;
+/// the functions in this namespace separate the two steps, so independent work
+/// can be scheduled while the division is in progress:
+///
+///     auto d = divider::start(a, b);
+///     ... // anything that does not use the divider
+///     q12 q = d.result();
+///
+/// There is only one divider, so at most one division may be pending at a
+/// time, and interrupt handlers that divide must save and restore it.
+///
+/// On the host, the divider registers are emulated by custard/host.hpp, so
+/// that code written against this API behaves identically off-device.
+///
+/// \see GBATEK's documentation for the divider:
+///   http://problemkaputt.de/gbatek.htm#dsmathsdivision
+//-----------------------------------------------------------------------------
+  namespace divider {
+//-----------------------------------------------------------------------------
+
+    // INTERNAL
+    inline void _start(int64_t num, int32_t den) {
+      REG_DIVCNT = DIV_64_32;
+      REG_DIV_NUMER = num;
+      REG_DIV_DENOM_L = den;
+    }
+    inline bool _busy() { return REG_DIVCNT & DIV_BUSY; }
+    inline int32_t _result() {
+      while (REG_DIVCNT & DIV_BUSY);
+      return REG_DIV_RESULT_L;
+    }
+
+    /// A division in progress, whose quotient has type \p Q
+    template <class Q> struct pending {
+      /// Is the divider still busy?
+      bool busy() const { return _busy(); }
+      /// Wait for the division to finish and return the quotient
+      Q result() const { return Q::from_wide(_result()); }
+    };
+
+    /// Start dividing \p num by \p den
+    template <int F, class S, bool Sat> inline pending<fixed<F, S, Sat>>
+    start(fixed<F, S, Sat> num, fixed<F, S, Sat> den) {
+      _start(int64_t(num.raw()) * (int64_t(1) << F), den.raw());
+      return {};
+    }
+
+    /// \brief Divide \p n numerators by \p n denominators \details
+    /// The operands of each division are loaded while the previous one is in
+    /// progress, so the loop overhead is hidden behind the divider latency.
+    /// \p out may alias \p num or \p den.
+    template <int F, class S, bool Sat> inline
+    void divide(const fixed<F, S, Sat>* num, const fixed<F, S, Sat>* den,
+                fixed<F, S, Sat>* out, size_t n) {
+      typedef fixed<F, S, Sat> Q;
+      if (!n) return;
+      const int64_t one = int64_t(1) << F;
+      _start(num[0].raw() * one, den[0].raw());
+      for (size_t i = 1; i < n; ++i) {
+        int64_t a = num[i].raw() * one;
+        int32_t b = den[i].raw();
+        out[i - 1] = Q::from_wide(_result());
+        _start(a, b);
+      }
+      out[n - 1] = Q::from_wide(_result());
+    }
+  }
+}
+
+#endif
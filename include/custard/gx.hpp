@@ -0,0 +1,237 @@
+#ifndef CUSTARD_GX_HPP
+#define CUSTARD_GX_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef ARM9
+#include <nds/arm9/cache.h>
+#include <nds/arm9/dma.h>
+#include <nds/arm9/videoGL.h>
+#else
+#include <custard/host.hpp>
+#endif
+
+#include <custard/memory.hpp>
+#include <custard/types.hpp>
+
+namespace custard {
+
+/// Geometry command lists
+//-----------------------------------------------------------------------------
+/// This namespace contains a builder for lists of geometry engine commands in
+/// the packed format, in which one header word holds up to four command
+/// bytes and is followed by the parameters of all four commands. A packed
+/// list takes fewer words than writing each command to GXFIFO on its own, is
+/// built ahead of time (e.g. once per model), and is sent to the geometry
+/// engine by a single DMA transfer.
+///
+/// \see GBATEK's documentation for the geometry command FIFO:
+///   http://problemkaputt.de/gbatek.htm#ds3diomap
+//-----------------------------------------------------------------------------
+  namespace gx {
+//-----------------------------------------------------------------------------
+
+    /// Geometry command numbers
+    enum command_id : uint8_t {
+      MTX_MODE = 0x10, MTX_PUSH = 0x11, MTX_POP = 0x12, MTX_STORE = 0x13,
+      MTX_RESTORE = 0x14, MTX_IDENTITY = 0x15, MTX_LOAD_4x4 = 0x16,
+      MTX_LOAD_4x3 = 0x17, MTX_MULT_4x4 = 0x18, MTX_MULT_4x3 = 0x19,
+      MTX_MULT_3x3 = 0x1a, MTX_SCALE = 0x1b, MTX_TRANS = 0x1c,
+      COLOR = 0x20, NORMAL = 0x21, TEXCOORD = 0x22, VTX_16 = 0x23,
+      VTX_10 = 0x24, VTX_XY = 0x25, VTX_XZ = 0x26, VTX_YZ = 0x27,
+      VTX_DIFF = 0x28, POLYGON_ATTR = 0x29, TEXIMAGE_PARAM = 0x2a,
+      PLTT_BASE = 0x2b, DIF_AMB = 0x30, SPE_EMI = 0x31, LIGHT_VECTOR = 0x32,
+      LIGHT_COLOR = 0x33, SHININESS = 0x34, BEGIN_VTXS = 0x40,
+      END_VTXS = 0x41, SWAP_BUFFERS = 0x50, VIEWPORT = 0x60,
+      BOX_TEST = 0x70, POS_TEST = 0x71, VEC_TEST = 0x72
+    };
+
+    /// Number of parameter words taken by command \p id
+    constexpr int parameters(uint8_t id) {
+      switch (id) {
+      case MTX_PUSH: case MTX_IDENTITY: case END_VTXS: return 0;
+      case MTX_LOAD_4x4: case MTX_MULT_4x4: return 16;
+      case MTX_LOAD_4x3: case MTX_MULT_4x3: return 12;
+      case MTX_MULT_3x3: return 9;
+      case MTX_SCALE: case MTX_TRANS: case BOX_TEST: return 3;
+      case VTX_16: case POS_TEST: return 2;
+      case SHININESS: return 32;
+      default: return 1;
+      }
+    }
+
+    /// Primitive types for \ref list::begin
+    enum primitive { triangles = 0, quads = 1, triangle_strip = 2,
+                     quad_strip = 3 };
+
+    /// Matrix modes for \ref list::matrix_mode
+    enum matrix { projection = 0, position = 1, position_vector = 2,
+                  texture = 3 };
+
+    // INTERNAL: parameter formats
+    constexpr uint32_t _pair(int a, int b) {
+      return uint32_t(a & 0xffff) | uint32_t(b & 0xffff) << 16;
+    }
+    constexpr uint32_t _ten(int x, int y, int z) {
+      return uint32_t(x & 0x3ff) | uint32_t(y & 0x3ff) << 10
+        | uint32_t(z & 0x3ff) << 20;
+    }
+    constexpr int _normal(q12 v) { // 1.0.9, +1 saturates
+      return custard::min(custard::max(v.raw() >> 3, -512), 511);
+    }
+
+// Command List Builder
+//-----------------------------------------------------------------------------
+/// \brief Builds a packed command list in a buffer of 32-bit words.
+/// \details
+///
+///     gx::list l(frame_arena, 256);
+///     l.begin(gx::triangles);
+///     l.color(0x7fff);
+///     l.vertex(vec3<q12>(...)); ...
+///     l.end();
+///     l.submit();
+///
+/// Positions, normals and texture coordinates are given as q12 vectors and
+/// converted to the formats of the commands (4.12, 4.6, 1.0.9 and 12.4).
+/// Commands that do not fit in the buffer are dropped and \ref ok becomes
+/// false; the list up to that point remains valid.
+//-----------------------------------------------------------------------------
+    class list {
+//-----------------------------------------------------------------------------
+      uint32_t* words;
+      size_t capacity, n = 0, header = 0;
+      int slot = 4;         // commands in the current header
+      bool overflow = false;
+
+    public:
+      /// Build in the \p size words at \p buffer (word aligned)
+      list(uint32_t* buffer, size_t size)
+        : words(buffer), capacity(buffer ? size : 0) {}
+      /// Build in \p size words allocated from \p a
+      list(arena& a, size_t size) : list(a.allocate<uint32_t>(size), size) {}
+
+      /// \brief Append command \p id with its \p count parameters
+      /// (parameters(id), or 0 for commands without parameters)
+      void command(uint8_t id, const uint32_t* params, int count) {
+        size_t need = count + (slot == 4);
+        if (overflow || capacity - n < need) { overflow = true; return; }
+        if (slot == 4) { header = n; words[n++] = 0; slot = 0; }
+        words[header] |= uint32_t(id) << 8 * slot++;
+        for (int i = 0; i < count; ++i) words[n++] = params[i];
+      }
+      /// Append a command without parameters
+      void command(uint8_t id) { command(id, nullptr, 0); }
+      /// Append a command with one parameter
+      void command(uint8_t id, uint32_t p) { command(id, &p, 1); }
+
+      // Matrices
+      void matrix_mode(matrix m) { command(MTX_MODE, m); }
+      void push() { command(MTX_PUSH); }
+      void pop(int count = 1) { command(MTX_POP, count & 0x3f); }
+      void store(int index) { command(MTX_STORE, index & 0x1f); }
+      void restore(int index) { command(MTX_RESTORE, index & 0x1f); }
+      void identity() { command(MTX_IDENTITY); }
+      void translate(vec3<q12> v) {
+        uint32_t p[3] = {uint32_t(v.x.raw()), uint32_t(v.y.raw()),
+                         uint32_t(v.z.raw())};
+        command(MTX_TRANS, p, 3);
+      }
+      void scale(vec3<q12> v) {
+        uint32_t p[3] = {uint32_t(v.x.raw()), uint32_t(v.y.raw()),
+                         uint32_t(v.z.raw())};
+        command(MTX_SCALE, p, 3);
+      }
+      /// Multiply by the 3x3 matrix \p m, given column by column
+      void multiply_3x3(const q12* m) {
+        uint32_t p[9];
+        for (int i = 0; i < 9; ++i) p[i] = uint32_t(m[i].raw());
+        command(MTX_MULT_3x3, p, 9);
+      }
+      /// Multiply by the 4x3 matrix \p m, given column by column
+      void multiply_4x3(const q12* m) {
+        uint32_t p[12];
+        for (int i = 0; i < 12; ++i) p[i] = uint32_t(m[i].raw());
+        command(MTX_MULT_4x3, p, 12);
+      }
+
+      // Polygons
+      void begin(primitive p) { command(BEGIN_VTXS, p); }
+      void end() { command(END_VTXS); }
+      void polygon_attr(uint32_t attr) { command(POLYGON_ATTR, attr); }
+      void texture(uint32_t param) { command(TEXIMAGE_PARAM, param); }
+      void palette_base(uint32_t base) { command(PLTT_BASE, base); }
+
+      // Vertex attributes
+      void color(uint16_t rgb15) { command(COLOR, rgb15); }
+      void normal(vec3<q12> v) {
+        command(NORMAL, _ten(_normal(v.x), _normal(v.y), _normal(v.z)));
+      }
+      void texcoord(vec2<q12> t) {
+        command(TEXCOORD, _pair(t.x.raw() >> 8, t.y.raw() >> 8));
+      }
+
+      // Vertices
+      /// Vertex at full (4.12) precision
+      void vertex(vec3<q12> v) {
+        uint32_t p[2] = {_pair(v.x.raw(), v.y.raw()),
+                         uint32_t(v.z.raw()) & 0xffff};
+        command(VTX_16, p, 2);
+      }
+      /// Vertex at 4.6 precision, in one parameter word
+      void vertex10(vec3<q12> v) {
+        command(VTX_10,
+                _ten(v.x.raw() >> 6, v.y.raw() >> 6, v.z.raw() >> 6));
+      }
+      /// Vertex with z from the previous vertex
+      void vertex_xy(vec2<q12> v) {
+        command(VTX_XY, _pair(v.x.raw(), v.y.raw()));
+      }
+      /// Vertex with y from the previous vertex
+      void vertex_xz(vec2<q12> v) {
+        command(VTX_XZ, _pair(v.x.raw(), v.y.raw()));
+      }
+      /// Vertex with x from the previous vertex
+      void vertex_yz(vec2<q12> v) {
+        command(VTX_YZ, _pair(v.x.raw(), v.y.raw()));
+      }
+
+      // Frame
+      void viewport(int x1, int y1, int x2, int y2) {
+        command(VIEWPORT,
+                uint32_t(x1 | y1 << 8 | x2 << 16) | uint32_t(y2) << 24);
+      }
+      void swap_buffers(uint32_t mode = 0) { command(SWAP_BUFFERS, mode); }
+
+      /// Empty the list, keeping its buffer
+      void clear() { n = 0; slot = 4; overflow = false; }
+      /// Did every command fit?
+      bool ok() const { return !overflow; }
+      /// The packed words
+      const uint32_t* data() const { return words; }
+      /// Number of packed words
+      size_t size() const { return n; }
+
+      /// \brief Send the list to the geometry engine by DMA on \p channel,
+      /// and wait for the transfer to finish
+      void submit(int channel = 0) const {
+        if (!n) return;
+#ifdef ARM9
+        DC_FlushRange(words, n * 4);
+        while (DMA_CR(channel) & DMA_BUSY);
+        DMA_SRC(channel) = uint32_t(words);
+        DMA_DEST(channel) = uint32_t(&GFX_FIFO);
+        DMA_CR(channel) = DMA_ENABLE | DMA_32_BIT | DMA_DST_FIX
+          | DMA_START_FIFO | n;
+        while (DMA_CR(channel) & DMA_BUSY);
+#else
+        (void)channel;
+        for (size_t i = 0; i < n; ++i) GFX_FIFO = words[i];
+#endif
+      }
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef CUSTARD_HOST_HPP
+#define CUSTARD_HOST_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace custard {
+
+/// Host stand-in for the DS hardware
+//-----------------------------------------------------------------------------
+/// When custard is compiled without ARM9 defined, this header takes the place
+/// of the libnds headers: it defines the register and memory macros custard
+/// uses, backed by plain arrays, so that code written against custard
+/// compiles and runs on the host, e.g. for tests and benchmarks.
+///
+/// Memory is emulated per address range by \ref at: I/O registers, palette
+/// memory, OAM, the engines' background and sprite memory, and VRAM banks at
+/// their LCDC addresses. Writes are stored and may be read back. Registers
+/// with behaviour are the divider, whose result is computed when read, as
+/// the hardware gives it in 64/32 mode, and the DMA channels (see
+/// \ref dma_channel). Interrupts are delivered only where code calls
+/// \ref interrupt_point. VRAM bank mapping is not emulated: the engines'
+/// memory and the banks' LCDC memory are separate.
+//-----------------------------------------------------------------------------
+  namespace host {
+//-----------------------------------------------------------------------------
+
+    alignas(8) inline uint8_t io[0x1100];       ///< 0x04000000, registers
+    alignas(8) inline uint8_t palette[0x800];   ///< 0x05000000
+    alignas(8) inline uint8_t bg[0x80000];      ///< 0x06000000, main BG
+    alignas(8) inline uint8_t bg_sub[0x20000];  ///< 0x06200000, sub BG
+    alignas(8) inline uint8_t obj[0x40000];     ///< 0x06400000, main sprites
+    alignas(8) inline uint8_t obj_sub[0x20000]; ///< 0x06600000, sub sprites
+    alignas(8) inline uint8_t lcdc[0xa4000];    ///< 0x06800000, banks A-I
+    alignas(8) inline uint8_t oam[0x800];       ///< 0x07000000
+
+    /// \brief Host memory standing in for DS address \p address (nullptr if
+    /// the address is not emulated)
+    template <class T> inline volatile T* at(uint32_t address) {
+      struct { uint32_t begin; uint8_t* mem; uint32_t size; } map[] = {
+        {0x04000000, io, sizeof(io)},
+        {0x05000000, palette, sizeof(palette)},
+        {0x06000000, bg, sizeof(bg)},
+        {0x06200000, bg_sub, sizeof(bg_sub)},
+        {0x06400000, obj, sizeof(obj)},
+        {0x06600000, obj_sub, sizeof(obj_sub)},
+        {0x06800000, lcdc, sizeof(lcdc)},
+        {0x07000000, oam, sizeof(oam)} };
+      for (auto& m : map)
+        if (address - m.begin < m.size)
+          return reinterpret_cast<volatile T*>(m.mem + (address - m.begin));
+      return nullptr;
+    }
+
+    // INTERNAL: carry out the division set up in the divider registers
+    inline void _divide() {
+      int64_t num = *at<int64_t>(0x04000290);
+      int32_t den = *at<int32_t>(0x04000298);
+      *at<int32_t>(0x040002a0) = den ? int32_t(num / den) : num < 0 ? 1 : -1;
+    }
+
+    /// \brief A DMA channel, as programmed through DMA_SRC, DMA_DEST and
+    /// DMA_CR. \details
+    /// The address registers hold host pointers, so that a transfer can read
+    /// host memory standing in for main RAM: write them as uintptr_t, which
+    /// is 32-bit on the DS. A transfer started immediately is carried out
+    /// when DMA_CR is next accessed, e.g. by the wait for it to finish, which
+    /// then finds the channel idle. A transfer started by horizontal blanking
+    /// is carried out by \ref hblank; those started by other events (vertical
+    /// blanking, the geometry FIFO) are not emulated: they stay enabled and
+    /// copy nothing. Each transfer carried out is counted, with REG_VCOUNT at
+    /// the time, so that a test can check when and how memory was copied.
+    struct dma_channel {
+      uintptr_t src, dest;
+      uint32_t cr;
+      uint32_t transfers; ///< Transfers carried out
+      uint32_t units;     ///< Halfwords or words copied by the last one
+      bool words;         ///< Was the last one 32-bit?
+      uint16_t vcount;    ///< REG_VCOUNT when the last one was carried out
+      // INTERNAL: the addresses a repeating transfer has reached, loaded from
+      // src and dest by its first transfer after being enabled
+      uintptr_t next_src, next_dest;
+      bool loaded;
+    };
+
+    inline dma_channel dma[4];
+
+    // INTERNAL: carry out one transfer of channel c, from and to the
+    // addresses reached, and advance them
+    inline void _transfer(dma_channel& c) {
+      bool words = c.cr >> 26 & 1;
+      uint32_t units = c.cr & 0x1fffff ? c.cr & 0x1fffff : 0x200000;
+      int size = words ? 4 : 2;
+      // Address control: increment, decrement, fixed, increment (reload)
+      auto step = [size](uint32_t control) {
+        return control == 1 ? -size : control == 2 ? 0 : size;
+      };
+      intptr_t ds = step(c.cr >> 21 & 3), ss = step(c.cr >> 23 & 3);
+      for (uint32_t i = 0; i < units; ++i) {
+        auto s = reinterpret_cast<const volatile uint8_t*>(c.next_src);
+        auto d = reinterpret_cast<volatile uint8_t*>(c.next_dest);
+        if (words)
+          *reinterpret_cast<volatile uint32_t*>(d) =
+            *reinterpret_cast<const volatile uint32_t*>(s);
+        else
+          *reinterpret_cast<volatile uint16_t*>(d) =
+            *reinterpret_cast<const volatile uint16_t*>(s);
+        c.next_src += ss;
+        c.next_dest += ds;
+      }
+      if ((c.cr >> 21 & 3) == 3) c.next_dest = c.dest;
+      ++c.transfers;
+      c.units = units;
+      c.words = words;
+      c.vcount = *at<uint16_t>(0x04000006);
+    }
+
+    // INTERNAL: carry out the immediate transfer set up on channel n, if any
+    inline void _dma(int n) {
+      dma_channel& c = dma[n];
+      if (!(c.cr >> 31)) c.loaded = false;
+      if (!(c.cr >> 31) || c.cr >> 27 & 7) return;
+      c.next_src = c.src;
+      c.next_dest = c.dest;
+      _transfer(c);
+      c.cr &= ~(1u << 31);
+    }
+
+    /// \brief Carry out the transfers started by the horizontal blank of the
+    /// line in REG_VCOUNT. \details
+    /// To step through a frame, set REG_VCOUNT to each line in turn, check
+    /// what the line would show, and call this. As on the DS, there is no
+    /// horizontal blank transfer on lines 192 to 262. A repeating transfer
+    /// continues from the source address it reached, and reloads the
+    /// destination if DMA_DST_RESET is set; one that does not repeat ends.
+    inline void hblank() {
+      if (*at<uint16_t>(0x04000006) >= 192) return;
+      for (dma_channel& c : dma) {
+        if (!(c.cr >> 31)) c.loaded = false;
+        if (!(c.cr >> 31) || (c.cr >> 27 & 7) != 4) continue;
+        if (!c.loaded) {
+          c.next_src = c.src;
+          c.next_dest = c.dest;
+          c.loaded = true;
+        }
+        _transfer(c);
+        if (!(c.cr >> 25 & 1)) {
+          c.cr &= ~(1u << 31);
+          c.loaded = false;
+        }
+      }
+    }
+
+    /// \brief Interrupt handler run by \ref interrupt_point, e.g. a vertical
+    /// blank handler under test (nullptr for none)
+    inline void (*irq)() = nullptr;
+    /// \brief Interrupt points to pass before \ref irq is requested (0 for
+    /// no request)
+    inline int irq_after = 0;
+    // INTERNAL: requested and not yet run
+    inline bool _irq_pending = false;
+
+    /// \brief A point at which code may be interrupted. \details
+    /// Code with a critical section calls this on the host between steps
+    /// that the hardware could interrupt, and when it restores REG_IME.
+    /// Once \ref irq_after points have passed, \ref irq is run at the first
+    /// point where bit 0 of REG_IME is set, as the DS would deliver it.
+    inline void interrupt_point() {
+      if (irq_after && !--irq_after) _irq_pending = true;
+      if (_irq_pending && irq && *at<uint32_t>(0x04000208) & 1) {
+        _irq_pending = false;
+        irq();
+      }
+    }
+
+    // INTERNAL
+    template <size_t N> inline void _clear(uint8_t (&m)[N]) {
+      for (uint8_t& b : m) b = 0;
+    }
+
+    /// Clear all emulated memory and registers
+    inline void reset() {
+      _clear(io); _clear(palette); _clear(oam); _clear(lcdc);
+      _clear(bg); _clear(bg_sub); _clear(obj); _clear(obj_sub);
+      for (dma_channel& c : dma) c = {};
+      irq = nullptr;
+      irq_after = 0;
+      _irq_pending = false;
+    }
+  }
+}
+
+typedef volatile uint8_t vu8;
+typedef volatile uint16_t vu16;
+typedef volatile uint32_t vu32;
+
+#define _CUSTARD_IO(type, address) (*custard::host::at<type>(address))
+
+// Display control
+#define REG_DISPCNT      _CUSTARD_IO(uint32_t, 0x04000000)
+#define REG_DISPSTAT     _CUSTARD_IO(uint16_t, 0x04000004)
+#define REG_VCOUNT       _CUSTARD_IO(uint16_t, 0x04000006)
+#define REG_BG0HOFS      _CUSTARD_IO(uint16_t, 0x04000010)
+#define REG_DISPCNT_SUB  _CUSTARD_IO(uint32_t, 0x04001000)
+
+// Interrupts
+#define REG_IME          _CUSTARD_IO(uint32_t, 0x04000208)
+
+// VRAM bank control
+#define VRAM_CR          _CUSTARD_IO(uint32_t, 0x04000240)
+#define VRAM_A_CR        _CUSTARD_IO(uint8_t, 0x04000240)
+#define VRAM_B_CR        _CUSTARD_IO(uint8_t, 0x04000241)
+#define VRAM_C_CR        _CUSTARD_IO(uint8_t, 0x04000242)
+#define VRAM_D_CR        _CUSTARD_IO(uint8_t, 0x04000243)
+#define VRAM_E_CR        _CUSTARD_IO(uint8_t, 0x04000244)
+#define VRAM_F_CR        _CUSTARD_IO(uint8_t, 0x04000245)
+#define VRAM_G_CR        _CUSTARD_IO(uint8_t, 0x04000246)
+#define VRAM_H_CR        _CUSTARD_IO(uint8_t, 0x04000248)
+#define VRAM_I_CR        _CUSTARD_IO(uint8_t, 0x04000249)
+
+#define VRAM_ENABLE      (1 << 7)
+#define VRAM_OFFSET(n)   ((n) << 3)
+
+#define VRAM_C_SUB_BG                 4
+#define VRAM_D_SUB_SPRITE             4
+#define VRAM_E_BG_EXT_PALETTE         4
+#define VRAM_F_BG_EXT_PALETTE_SLOT01  4
+#define VRAM_F_BG_EXT_PALETTE_SLOT23  (4 | VRAM_OFFSET(1))
+#define VRAM_F_SPRITE_EXT_PALETTE     5
+#define VRAM_G_BG_EXT_PALETTE_SLOT01  4
+#define VRAM_G_BG_EXT_PALETTE_SLOT23  (4 | VRAM_OFFSET(1))
+#define VRAM_G_SPRITE_EXT_PALETTE     5
+#define VRAM_H_SUB_BG                 1
+#define VRAM_H_SUB_BG_EXT_PALETTE     2
+#define VRAM_I_SUB_BG_0x06208000      1
+#define VRAM_I_SUB_SPRITE             2
+#define VRAM_I_SUB_SPRITE_EXT_PALETTE 3
+
+// Divider
+#define REG_DIVCNT       _CUSTARD_IO(uint16_t, 0x04000280)
+#define REG_DIV_NUMER    _CUSTARD_IO(int64_t, 0x04000290)
+#define REG_DIV_DENOM_L  _CUSTARD_IO(int32_t, 0x04000298)
+#define REG_DIV_RESULT_L \
+  (custard::host::_divide(), _CUSTARD_IO(int32_t, 0x040002a0))
+#define DIV_64_32        2
+#define DIV_BUSY         (1 << 15)
+
+// DMA
+#define DMA_SRC(n)       (custard::host::dma[n].src)
+#define DMA_DEST(n)      (custard::host::dma[n].dest)
+#define DMA_CR(n)        (custard::host::_dma(n), custard::host::dma[n].cr)
+#define DMA_ENABLE       (1u << 31)
+#define DMA_BUSY         (1u << 31)
+#define DMA_START_NOW    0
+#define DMA_START_VBL    (1 << 28)
+#define DMA_START_HBL    (1 << 29)
+#define DMA_START_FIFO   (7 << 27)
+#define DMA_16_BIT       0
+#define DMA_32_BIT       (1 << 26)
+#define DMA_REPEAT       (1 << 25)
+#define DMA_SRC_INC      0
+#define DMA_SRC_DEC      (1 << 23)
+#define DMA_SRC_FIX      (1 << 24)
+#define DMA_DST_INC      0
+#define DMA_DST_DEC      (1 << 21)
+#define DMA_DST_FIX      (1 << 22)
+#define DMA_DST_RESET    (3 << 21)
+
+// Geometry engine
+#define GFX_FIFO         _CUSTARD_IO(uint32_t, 0x04000400)
+
+// Memory
+#define BG_PALETTE         custard::host::at<uint16_t>(0x05000000)
+#define SPRITE_PALETTE     custard::host::at<uint16_t>(0x05000200)
+#define BG_PALETTE_SUB     custard::host::at<uint16_t>(0x05000400)
+#define SPRITE_PALETTE_SUB custard::host::at<uint16_t>(0x05000600)
+#define BG_GFX             custard::host::at<uint16_t>(0x06000000)
+#define BG_GFX_SUB         custard::host::at<uint16_t>(0x06200000)
+#define SPRITE_GFX         custard::host::at<uint16_t>(0x06400000)
+#define SPRITE_GFX_SUB     custard::host::at<uint16_t>(0x06600000)
+#define BG_TILE_RAM(base) \
+  custard::host::at<uint16_t>(0x06000000 + (base) * 0x4000)
+#define BG_MAP_RAM(base) \
+  custard::host::at<uint16_t>(0x06000000 + (base) * 0x800)
+#define BG_TILE_RAM_SUB(base) \
+  custard::host::at<uint16_t>(0x06200000 + (base) * 0x4000)
+#define BG_MAP_RAM_SUB(base) \
+  custard::host::at<uint16_t>(0x06200000 + (base) * 0x800)
+#define VRAM_A             custard::host::at<uint16_t>(0x06800000)
+#define VRAM_B             custard::host::at<uint16_t>(0x06820000)
+#define VRAM_C             custard::host::at<uint16_t>(0x06840000)
+#define VRAM_D             custard::host::at<uint16_t>(0x06860000)
+#define VRAM_E             custard::host::at<uint16_t>(0x06880000)
+#define VRAM_F             custard::host::at<uint16_t>(0x06890000)
+#define VRAM_G             custard::host::at<uint16_t>(0x06894000)
+#define VRAM_H             custard::host::at<uint16_t>(0x06898000)
+#define VRAM_I             custard::host::at<uint16_t>(0x068a0000)
+#define OAM                custard::host::at<uint16_t>(0x07000000)
+#define OAM_SUB            custard::host::at<uint16_t>(0x07000400)
+
+#endif
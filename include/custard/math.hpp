@@ -0,0 +1,272 @@
+#ifndef CUSTARD_MATH_HPP
+#define CUSTARD_MATH_HPP
+
+#include <custard/types.hpp>
+
+/// \brief Placement of the lookup tables used by custard/math.hpp \details
+/// Define this before including custard to place the tables in a particular
+/// memory section, e.g. `#define CUSTARD_MATH_TABLE DTCM_DATA` to place them
+/// in DTCM. By default they are read-only data in main RAM.
+#ifndef CUSTARD_MATH_TABLE
+#define CUSTARD_MATH_TABLE
+#endif
+
+namespace custard {
+
+// Angles
+//-----------------------------------------------------------------------------
+/// An angle in binary units, with a full turn of 32768 as in libnds. Angles
+/// wrap, so any int is a valid angle.
+typedef int angle;
+constexpr angle turn = 1 << 15; ///< A full turn (360 degrees)
+//-----------------------------------------------------------------------------
+
+// INTERNAL: lookup table generation
+//-----------------------------------------------------------------------------
+namespace _math {
+//-----------------------------------------------------------------------------
+
+  // The tables below are generated at compile time with double precision. No
+  // floating point operation is performed at run time.
+
+  constexpr double pi = 3.14159265358979323846;
+
+  template <class T, int N> struct table { T v[N]; };
+
+  constexpr double sqrt(double x) {
+    if (x <= 0) return 0;
+    double r = x > 1 ? x : 1;
+    for (int i = 0; i < 64; ++i) r = (r + x / r) / 2;
+    return r;
+  }
+
+  constexpr double sin(double x) { // x in [0, pi/2]
+    double term = x, sum = x;
+    for (int n = 1; n < 16; ++n) {
+      term *= -x * x / ((2 * n) * (2 * n + 1));
+      sum += term;
+    }
+    return sum;
+  }
+
+  constexpr double atan(double x) { // x in [0, 1]
+    x = x / (1 + sqrt(1 + x * x)); // atan(x) = 2 atan(x / (1 + sqrt(1 + x^2)))
+    double term = x, sum = x;
+    for (int n = 1; n < 40; ++n) {
+      term *= -x * x;
+      sum += term / (2 * n + 1);
+    }
+    return 2 * sum;
+  }
+
+  constexpr int32_t round(double x) {
+    return x < 0 ? int32_t(x - 0.5) : int32_t(x + 0.5);
+  }
+
+  // sin over a quarter turn in 256 steps, as raw q12 (the last entry is only
+  // read with zero weight)
+  constexpr table<int16_t, 258> make_sin() {
+    table<int16_t, 258> t {};
+    for (int i = 0; i <= 257; ++i)
+      t.v[i] = round(4096 * sin(pi / 2 * i / 256));
+    return t;
+  }
+
+  // atan over [0, 1] in 256 steps, as angle
+  constexpr table<int16_t, 257> make_atan() {
+    table<int16_t, 257> t {};
+    for (int i = 0; i <= 256; ++i)
+      t.v[i] = round(turn * atan(i / 256.) / (2 * pi));
+    return t;
+  }
+
+  // sqrt(i) << 16 for i in [64, 256]
+  constexpr table<int32_t, 193> make_sqrt() {
+    table<int32_t, 193> t {};
+    for (int i = 0; i <= 192; ++i) t.v[i] = round(65536 * sqrt(i + 64));
+    return t;
+  }
+
+  // 2^28 / sqrt(i) for i in [64, 256]
+  constexpr table<int32_t, 193> make_rsqrt() {
+    table<int32_t, 193> t {};
+    for (int i = 0; i <= 192; ++i) t.v[i] = round((1 << 28) / sqrt(i + 64));
+    return t;
+  }
+
+  // 2^32 / i for i in [256, 512]
+  constexpr table<uint32_t, 257> make_recip() {
+    table<uint32_t, 257> t {};
+    for (int i = 0; i <= 256; ++i)
+      t.v[i] = uint32_t(4294967296. / (i + 256) + 0.5);
+    return t;
+  }
+
+  inline constexpr auto sin_table CUSTARD_MATH_TABLE = make_sin();
+  inline constexpr auto atan_table CUSTARD_MATH_TABLE = make_atan();
+  inline constexpr auto sqrt_table CUSTARD_MATH_TABLE = make_sqrt();
+  inline constexpr auto rsqrt_table CUSTARD_MATH_TABLE = make_rsqrt();
+  inline constexpr auto recip_table CUSTARD_MATH_TABLE = make_recip();
+
+  // Linearly interpolate between entries i and i+1 of a table
+  template <class T, int N>
+  inline int32_t lerp(const table<T, N>& t, int i, int f, int bits) {
+    return t.v[i] + (((int32_t(t.v[i + 1]) - int32_t(t.v[i])) * f) >> bits);
+  }
+
+  // sin of the angle within a quarter turn, in [0, turn/4]
+  inline int32_t sin_quarter(int a) {
+    return lerp(sin_table, a >> 5, a & 31, 5);
+  }
+
+  // Integer square root of a 64-bit value
+  inline uint32_t sqrt64(uint64_t v) {
+    if (!v) return 0;
+    int shift = __builtin_clzll(v) - 32; // bring the top bit to 30 or 31
+    if (shift & 1) --shift;
+    uint32_t u = shift >= 0 ? uint32_t(v << shift) : uint32_t(v >> -shift);
+    uint32_t s = lerp(sqrt_table, (u >> 24) - 64, (u >> 8) & 0xffff, 16);
+    // sqrt(v) = s * 2^(-shift/2 - 4)
+    shift = shift / 2 + 4;
+    return shift >= 0 ? (s + (1 << shift >> 1)) >> shift : s << -shift;
+  }
+}
+
+// Trigonometry
+//-----------------------------------------------------------------------------
+
+/// \brief Sine of an angle \details
+/// Table lookup with linear interpolation. The result is within 1.5 LSB
+/// (2^-12) of the true value.
+//-----------------------------------------------------------------------------
+inline q12 sin(angle a) {
+//-----------------------------------------------------------------------------
+  int p = a & (turn / 4 - 1);
+  switch ((a >> 13) & 3) {
+    case 0:  return q12::from_raw(_math::sin_quarter(p));
+    case 1:  return q12::from_raw(_math::sin_quarter(turn / 4 - p));
+    case 2:  return q12::from_raw(-_math::sin_quarter(p));
+    default: return q12::from_raw(-_math::sin_quarter(turn / 4 - p));
+  }
+}
+
+/// Cosine of an angle, within 1.5 LSB (2^-12) of the true value
+//-----------------------------------------------------------------------------
+inline q12 cos(angle a) { return sin(a + turn / 4); }
+//-----------------------------------------------------------------------------
+
+/// \brief Angle of the vector (x, y) from the positive x axis, in [0, turn)
+/// \details
+/// Octant reduction and table lookup with linear interpolation. The result is
+/// within 2 units (0.022 degrees) of the true value. Returns 0 for (0, 0).
+//-----------------------------------------------------------------------------
+inline angle atan2(q12 y, q12 x) {
+//-----------------------------------------------------------------------------
+  int32_t ax = custard::abs(x.raw()), ay = custard::abs(y.raw());
+  if (!ax && !ay) return 0;
+  bool steep = ay > ax;
+  // the ratio of the shorter side to the longer, rounded to nearest
+  int32_t t = steep ? _div64((int64_t(ax) << 12) + ay / 2, ay)
+                    : _div64((int64_t(ay) << 12) + ax / 2, ax);
+  angle a = t >= 4096 ? turn / 8
+                      : _math::lerp(_math::atan_table, t >> 4, t & 15, 4);
+  if (steep) a = turn / 4 - a;
+  if (x.raw() < 0) a = turn / 2 - a;
+  if (y.raw() < 0) a = turn - a;
+  return a & (turn - 1);
+}
+
+// Roots and reciprocals
+//-----------------------------------------------------------------------------
+
+/// \brief Square root \details
+/// Table lookup with linear interpolation. The result is within 1 LSB (2^-12)
+/// of the true value for arguments below 256, and within 0.002% of it above.
+/// Returns 0 for negative arguments.
+//-----------------------------------------------------------------------------
+inline q12 sqrt(q12 x) {
+//-----------------------------------------------------------------------------
+  if (x.raw() <= 0) return 0;
+  return q12::from_raw(_math::sqrt64(uint64_t(x.raw()) << 12));
+}
+
+/// \brief Reciprocal square root \details
+/// Table lookup with linear interpolation. The result is within 1 LSB (2^-12)
+/// of the true value. Returns the largest q12 for non-positive arguments.
+//-----------------------------------------------------------------------------
+inline q12 rsqrt(q12 x) {
+//-----------------------------------------------------------------------------
+  int32_t r = x.raw();
+  if (r <= 0) return q12::from_raw(INT32_MAX);
+  int shift = __builtin_clz(uint32_t(r)) & ~1; // top bit to 30 or 31
+  uint32_t u = uint32_t(r) << shift;
+  int32_t s =
+    _math::lerp(_math::rsqrt_table, (u >> 24) - 64, (u >> 16) & 0xff, 8);
+  // 1/sqrt(x) = s * 2^(shift/2 - 22) in raw q12 units
+  shift = 22 - shift / 2;
+  return q12::from_raw((s + (1 << shift >> 1)) >> shift);
+}
+
+/// \brief Reciprocal (1/x) without the hardware divider \details
+/// Table lookup with linear interpolation. The result is within 1 LSB (2^-12)
+/// of the true value. Returns the largest q12 for 0. Being a q12, the result
+/// has few significant bits when |x| is large, and is 0 beyond 8192.
+//-----------------------------------------------------------------------------
+inline q12 recip(q12 x) {
+//-----------------------------------------------------------------------------
+  int32_t r = x.raw();
+  if (!r) return q12::from_raw(INT32_MAX);
+  uint32_t a = r < 0 ? -uint32_t(r) : uint32_t(r);
+  int shift = __builtin_clz(a); // top bit to 31
+  uint32_t u = a << shift;
+  uint32_t i = (u >> 23) - 256, f = (u >> 15) & 0xff;
+  uint32_t t = _math::recip_table.v[i];
+  t -= ((t - _math::recip_table.v[i + 1]) * f) >> 8;
+  // 1/x = t * 2^(shift - 31) in raw q12 units
+  shift = 31 - shift;
+  int32_t q = int32_t((t + (1u << shift >> 1)) >> shift);
+  return q12::from_raw(r < 0 ? -q : q);
+}
+
+// Vector operations
+//-----------------------------------------------------------------------------
+/// Unit vector in the direction of an angle
+inline vec2<q12> direction(angle a) { return vec2<q12>(cos(a), sin(a)); }
+/// Angle of a vector from the positive x axis, in [0, turn)
+inline angle angle_of(vec2<q12> v) { return atan2(v.y, v.x); }
+/// Rotate a vector anticlockwise (for y up) by an angle
+inline vec2<q12> rotate(vec2<q12> v, angle a) {
+  q12 c = cos(a), s = sin(a);
+  return vec2<q12>(v.x * c - v.y * s, v.x * s + v.y * c);
+}
+/// \brief Euclidean length of a vector, computed without intermediate
+/// overflow; saturates if beyond the q12 range
+inline q12 length(vec2<q12> v) {
+  int64_t x = v.x.raw(), y = v.y.raw();
+  uint32_t r = _math::sqrt64(uint64_t(x * x) + uint64_t(y * y));
+  return q12::from_raw(r > INT32_MAX ? INT32_MAX : int32_t(r));
+}
+/// \brief Unit vector in the direction of a vector, within 1 LSB (2^-12) for
+/// any length, without division. Returns (0, 0) for (0, 0). \details
+/// The reciprocal square root of the 64-bit squared length is looked up with
+/// 28 significant bits, so that long vectors lose no precision (a q12
+/// reciprocal of the length would).
+inline vec2<q12> normalize(vec2<q12> v) {
+  int64_t x = v.x.raw(), y = v.y.raw();
+  uint64_t s = uint64_t(x * x) + uint64_t(y * y);
+  if (!s) return vec2<q12>();
+  int shift = (__builtin_clzll(s) - 32) & ~1; // top bit to 30 or 31
+  uint32_t u = shift >= 0 ? uint32_t(s << shift) : uint32_t(s >> -shift);
+  int64_t r =
+    _math::lerp(_math::rsqrt_table, (u >> 24) - 64, (u >> 16) & 0xff, 8);
+  // 4096 / sqrt(s) = r * 2^(shift/2 - 28)
+  shift = 28 - shift / 2;
+  int64_t half = int64_t(1) << (shift - 1);
+  return vec2<q12>(q12::from_raw(int32_t((x * r + half) >> shift)),
+                   q12::from_raw(int32_t((y * r + half) >> shift)));
+}
+//-----------------------------------------------------------------------------
+
+}
+
+#endif
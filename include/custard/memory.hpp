@@ -0,0 +1,264 @@
+#ifndef CUSTARD_MEMORY_HPP
+#define CUSTARD_MEMORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+/// \brief Size in bytes of custard::frame_arena \details
+/// Define this before including custard to change it; the memory is only
+/// reserved if the arena is used.
+#ifndef CUSTARD_FRAME_ARENA_SIZE
+#define CUSTARD_FRAME_ARENA_SIZE 0x4000
+#endif
+
+/// \brief Placement of the memory of custard::frame_arena \details
+/// Define this before including custard to place it in a particular memory
+/// section, e.g. `#define CUSTARD_FRAME_ARENA_SECTION DTCM_BSS` for DTCM,
+/// which the stack shares (reduce \ref CUSTARD_FRAME_ARENA_SIZE to suit). By
+/// default it is in main RAM.
+#ifndef CUSTARD_FRAME_ARENA_SECTION
+#define CUSTARD_FRAME_ARENA_SECTION
+#endif
+
+namespace custard {
+
+/// \brief Allocation counters of an \ref arena or \ref pool \details
+/// The counters are only updated if CUSTARD_MEMORY_STATS is defined before
+/// including custard; otherwise they stay zero and cost nothing.
+struct memory_stats {
+  size_t peak;          ///< Most bytes (arena) or objects (pool) in use
+  uint32_t allocations; ///< Successful allocations
+  uint32_t failures;    ///< Allocations that did not fit
+  uint32_t bad_frees;   ///< Frees refused as foreign or repeated (pool)
+};
+
+// Bump Allocator
+//-----------------------------------------------------------------------------
+/// \brief Hands out memory from a fixed buffer by advancing a pointer.
+/// \details
+///
+/// Allocation is a bounds check and an addition, and there is no per-block
+/// release: \ref reset frees everything at once, e.g. at the end of a frame
+/// for data that lives for one frame only. When the buffer is exhausted,
+/// \ref allocate returns nullptr.
+//-----------------------------------------------------------------------------
+class arena {
+//-----------------------------------------------------------------------------
+  uint8_t* base;
+  size_t size, top = 0;
+#ifdef CUSTARD_MEMORY_STATS
+  memory_stats counters = {};
+#endif
+
+public:
+  /// Allocate from the \p bytes bytes at \p memory
+  constexpr arena(void* memory, size_t bytes)
+    : base(static_cast<uint8_t*>(memory)), size(bytes) {}
+
+  /// \brief Allocate \p bytes bytes aligned to \p align (a power of two), or
+  /// return nullptr if there is not enough room
+  void* allocate(size_t bytes, size_t align = alignof(max_align_t)) {
+    size_t p = ((uintptr_t(base) + top + align - 1) & ~(align - 1))
+      - uintptr_t(base);
+    if (p > size || bytes > size - p) {
+#ifdef CUSTARD_MEMORY_STATS
+      ++counters.failures;
+#endif
+      return nullptr;
+    }
+    top = p + bytes;
+#ifdef CUSTARD_MEMORY_STATS
+    ++counters.allocations;
+    if (top > counters.peak) counters.peak = top;
+#endif
+    return base + p;
+  }
+  /// Allocate uninitialized room for \p n objects of type T
+  template <class T> T* allocate(size_t n) {
+    // a size that overflows cannot fit
+    size_t bytes = n > size_t(-1) / sizeof(T) ? size_t(-1) : n * sizeof(T);
+    return static_cast<T*>(allocate(bytes, alignof(T)));
+  }
+
+  /// Free everything allocated
+  void reset() { top = 0; }
+
+  size_t used() const { return top; }              ///< Bytes allocated
+  size_t capacity() const { return size; }         ///< Size of the buffer
+  size_t remaining() const { return size - top; }  ///< Bytes not allocated
+
+  /// Counters since construction (see \ref memory_stats)
+  memory_stats stats() const {
+#ifdef CUSTARD_MEMORY_STATS
+    return counters;
+#else
+    return {};
+#endif
+  }
+};
+
+// INTERNAL
+alignas(16) inline uint8_t _frame_memory[CUSTARD_FRAME_ARENA_SIZE]
+  CUSTARD_FRAME_ARENA_SECTION;
+
+/// \brief An arena for data that lives until the end of the frame \details
+/// Call `frame_arena.reset()` once per frame, e.g. at the top of the main
+/// loop, after everything allocated in the last frame is finished with.
+inline arena frame_arena(_frame_memory, sizeof(_frame_memory));
+
+// Object Pool
+//-----------------------------------------------------------------------------
+/// \brief Storage for up to \p N objects of type T, allocated and freed in
+/// any order in constant time. \details
+///
+/// Free slots are kept in a linked list threaded through the slots
+/// themselves, so the pool needs no memory beyond the objects. \ref create
+/// returns nullptr when the pool is full.
+///
+/// With CUSTARD_MEMORY_STATS, the pool also keeps a bitmap of the slots in
+/// use, and refuses (and counts in \ref memory_stats::bad_frees) a free of a
+/// pointer that is not the start of one of its slots or is already free.
+/// Without it, such a free corrupts the free list.
+//-----------------------------------------------------------------------------
+template <class T, size_t N> class pool {
+//-----------------------------------------------------------------------------
+  static_assert(N > 0, "pool must have at least one slot");
+
+  union slot {
+    slot* next;
+    alignas(T) uint8_t object[sizeof(T)];
+  } slots[N];
+  slot* free_list = slots;
+  size_t count = 0;
+
+  void push(void* p) {
+    slot* s = static_cast<slot*>(p);
+    s->next = free_list;
+    free_list = s;
+    --count;
+  }
+#ifdef CUSTARD_MEMORY_STATS
+  memory_stats counters = {};
+  uint32_t used[(N + 31) / 32] = {};
+
+  // Is p a slot in use? If so, mark it free; if not, count a bad free
+  bool release(const void* p) {
+    size_t i = (uintptr_t(p) - uintptr_t(slots)) / sizeof(slot);
+    if (!owns(p) || p != slots[i].object || !(used[i / 32] >> i % 32 & 1)) {
+      ++counters.bad_frees;
+      return false;
+    }
+    used[i / 32] &= ~(uint32_t(1) << i % 32);
+    return true;
+  }
+#endif
+
+public:
+  pool() {
+    for (size_t i = 0; i + 1 < N; ++i) slots[i].next = &slots[i + 1];
+    slots[N - 1].next = nullptr;
+  }
+  pool(const pool&) = delete;
+  pool& operator=(const pool&) = delete;
+
+  /// Uninitialized room for one object, or nullptr if the pool is full
+  void* allocate() {
+    slot* s = free_list;
+    if (!s) {
+#ifdef CUSTARD_MEMORY_STATS
+      ++counters.failures;
+#endif
+      return nullptr;
+    }
+    free_list = s->next;
+    ++count;
+#ifdef CUSTARD_MEMORY_STATS
+    used[(s - slots) / 32] |= uint32_t(1) << (s - slots) % 32;
+    ++counters.allocations;
+    if (count > counters.peak) counters.peak = count;
+#endif
+    return s->object;
+  }
+  /// Return room from \ref allocate to the pool (nullptr is ignored)
+  void deallocate(void* p) {
+    if (!p) return;
+#ifdef CUSTARD_MEMORY_STATS
+    if (!release(p)) return;
+#endif
+    push(p);
+  }
+
+  /// Construct an object from \p args, or return nullptr if the pool is full
+  template <class... A> T* create(A&&... args) {
+    void* p = allocate();
+    return p ? new (p) T(std::forward<A>(args)...) : nullptr;
+  }
+  /// Destroy an object from \ref create (nullptr is ignored)
+  void destroy(T* t) {
+    if (!t) return;
+#ifdef CUSTARD_MEMORY_STATS
+    if (!release(t)) return;
+#endif
+    t->~T();
+    push(t);
+  }
+
+  /// Does \p p point into this pool?
+  bool owns(const void* p) const {
+    return uintptr_t(p) - uintptr_t(slots) < sizeof(slots);
+  }
+  size_t size() const { return count; }             ///< Objects in use
+  static constexpr size_t capacity() { return N; }  ///< Number of slots
+  bool full() const { return !free_list; }          ///< Are all slots used?
+
+  /// Counters since construction (see \ref memory_stats)
+  memory_stats stats() const {
+#ifdef CUSTARD_MEMORY_STATS
+    return counters;
+#else
+    return {};
+#endif
+  }
+};
+
+// Standard Library Allocator
+//-----------------------------------------------------------------------------
+/// \brief Lets standard containers allocate from an \ref arena. \details
+///
+///     std::vector<int, arena_allocator<int>> v{arena_allocator<int>(a)};
+///
+/// Deallocation does nothing; the memory is reclaimed when the arena is
+/// reset, so containers using it must not outlive the reset. Containers
+/// cannot handle a failed allocation without exceptions, so running out of
+/// room aborts: size the arena, or reserve, for the worst case.
+//-----------------------------------------------------------------------------
+template <class T> struct arena_allocator {
+//-----------------------------------------------------------------------------
+  typedef T value_type;
+  arena* a;
+
+  explicit arena_allocator(arena& a) : a(&a) {}
+  template <class U>
+  arena_allocator(const arena_allocator<U>& other) : a(other.a) {}
+
+  T* allocate(size_t n) {
+    T* p = a->allocate<T>(n);
+    if (!p) std::abort();
+    return p;
+  }
+  void deallocate(T*, size_t) {}
+
+  template <class U> bool operator==(const arena_allocator<U>& o) const {
+    return a == o.a;
+  }
+  template <class U> bool operator!=(const arena_allocator<U>& o) const {
+    return a != o.a;
+  }
+};
+
+}
+
+#endif
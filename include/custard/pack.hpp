@@ -0,0 +1,198 @@
+#ifndef CUSTARD_PACK_HPP
+#define CUSTARD_PACK_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace custard {
+
+/// Compressed asset blobs
+//-----------------------------------------------------------------------------
+/// This namespace contains the format of the compressed blobs produced by the
+/// packer in tools/pack.cpp (see the `.pak` rules in custard.mk), and a
+/// decoder that streams them into VRAM.
+///
+/// A blob is split into chunks of a fixed decoded size, each compressed on
+/// its own with whichever of LZ77 and RLE gives the smaller result (or
+/// stored). Because chunks are independent, a blob can be decoded a few
+/// chunks at a time, so that a large load is spread across frames.
+///
+/// Layout, all fields little-endian:
+///
+///     header                     magic, size, chunk, count
+///     uint32_t offsets[count+1]  start of each chunk's data, from data[0]
+///     uint8_t data[]             per chunk: method byte, then payload
+///
+/// LZ77 payloads are a flag byte for each group of eight tokens, most
+/// significant bit first; a set bit marks a two-byte match of 3-18 bytes at
+/// a distance of 1-4096 within the chunk (`(len - 3) << 12 | (dist - 1)`,
+/// big-endian), a clear bit a literal byte. RLE payloads are a control byte
+/// n followed by a byte repeated (n & 0x7f) + 3 times if n & 0x80, else by
+/// (n & 0x7f) + 1 literal bytes.
+//-----------------------------------------------------------------------------
+  namespace pack {
+//-----------------------------------------------------------------------------
+
+    constexpr uint32_t magic = 0x4b415043; ///< "CPAK"
+
+    /// Compression method of a chunk
+    enum method : uint8_t { stored = 0, rle = 1, lz77 = 2 };
+
+    /// Blob header
+    struct header {
+      uint32_t magic; ///< \ref pack::magic
+      uint32_t size;  ///< Decoded size in bytes, a multiple of 4
+      uint32_t chunk; ///< Decoded bytes per chunk (the last may be shorter)
+      uint32_t count; ///< Number of chunks
+    };
+
+    /// \brief Decode one chunk of \p len bytes at \p src into \p out, which
+    /// has room for \p size bytes. Returns the number of bytes decoded,
+    /// which is short of \p size if the chunk is truncated or corrupt; no
+    /// byte past \p src + \p len is read.
+    inline size_t decode_chunk(const uint8_t* src, size_t len, uint8_t* out,
+                               size_t size) {
+      const uint8_t* end = src + len;
+      size_t n = 0;
+      if (!len) return 0;
+      switch (*src++) {
+      case stored:
+        for (; src < end && n < size; ++n) out[n] = *src++;
+        break;
+      case rle:
+        while (src < end && n < size) {
+          unsigned c = *src++;
+          if (c & 0x80) {
+            if (src == end) return n; // truncated
+            uint8_t b = *src++;
+            for (unsigned k = (c & 0x7f) + 3; k-- && n < size; ) out[n++] = b;
+          }
+          else {
+            for (unsigned k = c + 1; k-- && src < end && n < size; )
+              out[n++] = *src++;
+          }
+        }
+        break;
+      case lz77:
+        while (src < end && n < size) {
+          unsigned flags = *src++;
+          for (int bit = 7; bit >= 0 && src < end && n < size; --bit) {
+            if (flags >> bit & 1) {
+              if (end - src < 2) return n; // truncated
+              unsigned t = unsigned(src[0]) << 8 | src[1];
+              src += 2;
+              size_t dist = (t & 0xfff) + 1, k = (t >> 12) + 3;
+              if (dist > n) return n; // corrupt
+              for (; k-- && n < size; ++n) out[n] = out[n - dist];
+            }
+            else out[n++] = *src++;
+          }
+        }
+        break;
+      }
+      return n;
+    }
+
+// Streaming Decoder
+//-----------------------------------------------------------------------------
+/// \brief Decodes a blob into VRAM (or any memory) a chunk at a time.
+/// \details
+///
+/// Each chunk is decoded into a scratch buffer in main RAM, where the LZ77
+/// back-references can be read cheaply and byte stores are allowed, and then
+/// copied to the destination with 32-bit stores, since VRAM ignores byte
+/// stores. \p Chunk is the largest chunk size accepted.
+///
+///     pack::decoder<> d;
+///     d.open(level_tiles_pak, BG_TILE_RAM(4));
+///     while (!d.run(16 * 1024)) swiWaitForVBlank(); // 16K per frame
+//-----------------------------------------------------------------------------
+    template <size_t Chunk = 4096> class decoder {
+//-----------------------------------------------------------------------------
+      static_assert(Chunk % 4 == 0, "chunk size must be a multiple of 4");
+
+      alignas(32) uint8_t scratch[Chunk];
+      const header* h = nullptr;
+      const uint32_t* offsets;
+      const uint8_t* data;
+      volatile uint32_t* dest;
+      uint32_t next = 0, written = 0;
+
+    public:
+      /// \brief Start decoding \p blob to \p dest (word aligned). Returns
+      /// false if \p blob is not a blob or its chunks are too large.
+      bool open(const void* blob, volatile void* dest) {
+        const header* b = static_cast<const header*>(blob);
+        if (b->magic != magic || b->chunk > Chunk || b->chunk % 4) {
+          h = nullptr;
+          return false;
+        }
+        h = b;
+        offsets = reinterpret_cast<const uint32_t*>(b + 1);
+        data = reinterpret_cast<const uint8_t*>(offsets + b->count + 1);
+        this->dest = static_cast<volatile uint32_t*>(dest);
+        next = written = 0;
+        return true;
+      }
+
+      /// \brief Decode the next chunk, if any. Returns false if the chunk is
+      /// corrupt, after which the decoder stops.
+      bool step() {
+        if (done()) return true;
+        uint32_t size = h->size - next * h->chunk;
+        if (size > h->chunk) size = h->chunk;
+        const uint8_t* src = data + offsets[next];
+        size_t len = offsets[next + 1] - offsets[next];
+        if (decode_chunk(src, len, scratch, size) != size) {
+          h = nullptr;
+          return false;
+        }
+        const uint32_t* w = reinterpret_cast<const uint32_t*>(scratch);
+        volatile uint32_t* out = dest + written / 4;
+        for (uint32_t i = 0; i < size / 4; ++i) out[i] = w[i];
+        written += size;
+        ++next;
+        return true;
+      }
+
+      /// \brief Decode whole chunks until at least \p bytes were decoded or
+      /// the blob is finished. Returns true when the blob is finished.
+      bool run(size_t bytes) {
+        for (size_t start = written; !done() && written - start < bytes; )
+          if (!step()) return false;
+        return done();
+      }
+
+      /// Is the blob fully decoded? (Also true if none is open.)
+      bool done() const { return !h || next == h->count; }
+      /// Did the last \ref open or \ref step fail?
+      bool failed() const { return !h; }
+      /// Bytes written to the destination so far
+      uint32_t decoded() const { return written; }
+      /// Decoded size of the blob
+      uint32_t size() const { return h ? h->size : 0; }
+    };
+
+    /// \brief Decode all of \p blob to \p dest at once, using decoder \p d
+    /// and its scratch buffer. Returns false if \p blob is not a valid blob
+    /// with chunks of at most \p Chunk bytes.
+    template <size_t Chunk>
+    inline bool unpack(const void* blob, volatile void* dest,
+                       decoder<Chunk>& d) {
+      return d.open(blob, dest) && d.run(~size_t(0)) && !d.failed();
+    }
+
+    /// \brief Decode all of \p blob to \p dest at once, as above, with a
+    /// decoder of its own. \details The decoder is a function-local static,
+    /// so that a \p Chunk byte scratch buffer isn't put on the stack: it
+    /// takes \p Chunk bytes of BSS for each \p Chunk used, and the function
+    /// must not be called from an interrupt handler while it is running.
+    template <size_t Chunk = 4096>
+    inline bool unpack(const void* blob, volatile void* dest) {
+      static decoder<Chunk> d;
+      return unpack(blob, dest, d);
+    }
+  }
+}
+
+#endif
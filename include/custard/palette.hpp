@@ -0,0 +1,239 @@
+#ifndef CUSTARD_PALETTE_HPP
+#define CUSTARD_PALETTE_HPP
+
+#include <cstdint>
+
+#include <custard/vram.hpp>
+
+namespace custard {
+
+/// Palette slot management
+//-----------------------------------------------------------------------------
+/// This namespace contains a manager for the 16 palettes of an extended
+/// palette slot (256 colours each) or of standard palette memory (16 colours
+/// each), which shares identical palettes between users and uploads only the
+/// colours that change.
+///
+/// \see GBATEK's documentation for extended palettes:
+///   http://problemkaputt.de/gbatek.htm#dsvideoextendedpalettes
+//-----------------------------------------------------------------------------
+  namespace palette {
+//-----------------------------------------------------------------------------
+
+    /// FNV-1a hash of \p n colours
+    inline uint32_t hash(const uint16_t* colours, int n) {
+      uint32_t h = 2166136261u;
+      for (int i = 0; i < n; ++i) {
+        h = (h ^ (colours[i] & 0xff)) * 16777619u;
+        h = (h ^ (colours[i] >> 8)) * 16777619u;
+      }
+      return h;
+    }
+
+    /// \brief Mix RGB15 colours \p a and \p b, giving \p level / 16 of \p b
+    inline uint16_t blend(uint16_t a, uint16_t b, int level) {
+      int r = 0;
+      for (int shift = 0; shift < 15; shift += 5) {
+        int x = a >> shift & 31, y = b >> shift & 31;
+        r |= (x + ((y - x) * level >> 4)) << shift;
+      }
+      return uint16_t(r);
+    }
+
+    /// \brief Address of extended palette memory at \p offset bytes into
+    /// bank \p b, as seen by the CPU while the bank is mapped to LCDC
+    inline volatile uint16_t* ext_memory(vram::bank b, uint32_t offset = 0) {
+      return vram::_pointer<uint16_t>(vram::_lcdc_address(b) + offset);
+    }
+    /// Control register of bank \p b
+    inline volatile uint8_t* ext_control(vram::bank b) {
+      // WRAMCNT precedes VRAM_H_CR
+      return vram::_pointer<uint8_t>(
+        0x04000240 + int(b) + (b >= vram::bank::H));
+    }
+
+// Palette Manager
+//-----------------------------------------------------------------------------
+/// \brief Assigns 16 palettes of \p Colours colours each, shared by reference
+/// count, and keeps a shadow copy from which changes are uploaded. \details
+///
+/// \ref load finds a slot holding the same colours (by hash, then by
+/// comparison) and adds a reference to it, or copies the colours into a free
+/// slot. Slots return to the free pool when their last reference is
+/// released.
+///
+/// For an extended palette slot (\p Colours = 256, e.g. the 8K of sprite
+/// extended palettes in bank F), pass the bank's LCDC address and control
+/// register:
+///
+///     palette::manager<256> pal(palette::ext_memory(vram::bank::F),
+///                               palette::ext_control(vram::bank::F));
+///
+/// Extended palette memory is only accessible to the CPU while its bank is
+/// mapped to LCDC, so \ref upload maps the bank to LCDC, writes the changed
+/// colours, and restores the bank's mapping. It must be called during
+/// vertical blanking, while the engines do not read the palettes. For
+/// standard palette memory (\p Colours = 16, BG_PALETTE or SPRITE_PALETTE),
+/// omit the control register.
+///
+/// \ref fade and \ref cycle change the colours shown without changing the
+/// loaded palette, so a later \ref load of the same colours still finds the
+/// slot, and recompute and upload only the colours whose value changes. They
+/// act on the slot, so every user of a shared palette sees them; load a
+/// distinct palette for an independent effect.
+//-----------------------------------------------------------------------------
+    template <int Colours> class manager {
+//-----------------------------------------------------------------------------
+      static_assert(Colours % 2 == 0, "palettes must have an even size");
+      static_assert(Colours <= 256, "palettes have at most 256 colours");
+
+      static constexpr int words = Colours / 2, masks = (words + 31) / 32;
+      // Dirty mask covering every word of mask k
+      static constexpr uint32_t all(int k) {
+        return words - 32 * k >= 32 ? ~0u : (1u << (words - 32 * k)) - 1;
+      }
+
+      uint16_t base[16][Colours];  // loaded colours
+      uint8_t order[16][Colours];  // colour of base shown at each index
+      uint16_t shown[16][Colours]; // colours after cycling and fading
+      uint32_t dirty[16][masks] = {};
+      uint32_t hashes[16] = {};
+      uint8_t refs[16] = {};
+      struct { uint16_t colour; uint8_t level; } fades[16] = {};
+      volatile uint16_t* dest;
+      volatile uint8_t* control;
+
+      void refresh(int s, int first, int count) {
+        for (int i = first; i < first + count; ++i) {
+          uint16_t c =
+            blend(base[s][order[s][i]], fades[s].colour, fades[s].level);
+          if (c == shown[s][i]) continue;
+          shown[s][i] = c;
+          dirty[s][i >> 6] |= 1u << (i >> 1 & 31);
+        }
+      }
+
+      bool same(int s, const uint16_t* colours) const {
+        for (int i = 0; i < Colours; ++i)
+          if (base[s][i] != colours[i]) return false;
+        return true;
+      }
+
+    public:
+      static constexpr int none = -1; ///< Returned when all slots are used
+
+      /// \brief Manage the 16 palettes at \p dest, unlocking them through
+      /// bank control register \p control if given
+      explicit manager(volatile uint16_t* dest,
+                       volatile uint8_t* control = nullptr)
+        : dest(dest), control(control) {}
+
+      /// \brief Find or allocate a slot holding \p colours and add a
+      /// reference to it. Returns the slot, or \ref none.
+      int load(const uint16_t* colours) {
+        uint32_t h = hash(colours, Colours);
+        int unused = none;
+        for (int s = 0; s < 16; ++s) {
+          if (!refs[s]) { if (unused == none) unused = s; continue; }
+          if (hashes[s] == h && same(s, colours)) { retain(s); return s; }
+        }
+        if (unused == none) return none;
+        for (int i = 0; i < Colours; ++i) base[unused][i] = colours[i];
+        hashes[unused] = h;
+        refs[unused] = 1;
+        fades[unused] = {0, 0};
+        for (int k = 0; k < masks; ++k) dirty[unused][k] = all(k);
+        for (int i = 0; i < Colours; ++i) {
+          order[unused][i] = uint8_t(i);
+          shown[unused][i] = colours[i];
+        }
+        return unused;
+      }
+
+      /// \brief Add a reference to slot \p s, if it is in use. After 255
+      /// references the slot is pinned: further retains and releases are
+      /// ignored and it stays loaded.
+      void retain(int s) { if (in_use(s) && refs[s] != 255) ++refs[s]; }
+      /// \brief Drop a reference to slot \p s. Returns true if the slot was
+      /// freed.
+      bool release(int s) { return in_use(s) && refs[s] != 255 && !--refs[s]; }
+      /// Is slot \p s loaded?
+      bool in_use(int s) const { return s >= 0 && s < 16 && refs[s]; }
+      /// Reference count of slot \p s (0 if it is free)
+      int references(int s) const { return in_use(s) ? refs[s] : 0; }
+      /// Number of slots in use
+      int used() const {
+        int n = 0;
+        for (uint8_t r : refs) n += r != 0;
+        return n;
+      }
+
+      /// Colours shown in slot \p s
+      const uint16_t* colours(int s) const { return shown[s]; }
+
+      /// \brief Fade slot \p s towards \p colour, by \p level sixteenths (0
+      /// shows the palette as loaded). Ignored if the slot is free.
+      void fade(int s, uint16_t colour, int level) {
+        if (!in_use(s)) return;
+        if (fades[s].colour == colour && fades[s].level == level) return;
+        fades[s] = {colour, uint8_t(level)};
+        refresh(s, 0, Colours);
+      }
+
+      /// \brief Rotate the \p count colours shown in slot \p s from
+      /// \p first by \p step places towards the end. Ignored if the slot is
+      /// free or the range is not within the palette.
+      void cycle(int s, int first, int count, int step = 1) {
+        if (!in_use(s) || first < 0 || count < 2 || count > Colours - first)
+          return;
+        step %= count;
+        if (step < 0) step += count;
+        uint8_t* c = order[s] + first;
+        // rotate right by step, in three reversals
+        auto reverse = [](uint8_t* a, int n) {
+          for (int i = 0, j = n - 1; i < j; ++i, --j) {
+            uint8_t t = a[i]; a[i] = a[j]; a[j] = t;
+          }
+        };
+        reverse(c, count);
+        reverse(c, step);
+        reverse(c + step, count - step);
+        refresh(s, first, count);
+      }
+
+      /// \brief Write the changed colours to palette memory. Call during
+      /// vertical blanking. Returns the number of words written.
+      int upload() {
+        int n = 0;
+        uint8_t cr = 0;
+        volatile uint32_t* out = reinterpret_cast<volatile uint32_t*>(dest);
+        for (int s = 0; s < 16; ++s) {
+          const uint32_t* src = reinterpret_cast<const uint32_t*>(shown[s]);
+          for (int k = 0; k < masks; ++k) {
+            uint32_t m = dirty[s][k];
+            if (!m) continue;
+            if (!n && control) {
+              cr = *control;
+              *control = cr & 0x80; // LCDC
+            }
+            for (; m; m &= m - 1, ++n) {
+              int i = 32 * k + __builtin_ctz(m);
+              out[s * words + i] = src[i];
+            }
+            dirty[s][k] = 0;
+          }
+        }
+        if (n && control) *control = cr;
+        return n;
+      }
+
+      /// Mark every colour in use dirty, e.g. after palette memory was reset
+      void invalidate() {
+        for (int s = 0; s < 16; ++s)
+          if (refs[s]) for (int k = 0; k < masks; ++k) dirty[s][k] = all(k);
+      }
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,344 @@
+#ifndef CUSTARD_PROFILE_HPP
+#define CUSTARD_PROFILE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+#ifdef ARM9
+#include <nds/interrupts.h>
+#include <nds/system.h>
+#include <nds/timers.h>
+#else
+#include <chrono>
+#endif
+
+/// \brief First of the two cascaded hardware timers used by the profiler
+/// \details Timers n and n + 1 are used; define this before including custard
+/// to leave timers 0 and 1 to other uses.
+#ifndef CUSTARD_PROFILE_TIMER
+#define CUSTARD_PROFILE_TIMER 0
+#endif
+
+/// \brief Time the enclosing scope as zone \p name of custard::profile::global
+/// \details Zones are only recorded if CUSTARD_PROFILE is defined before
+/// including custard; otherwise this expands to nothing.
+#ifdef CUSTARD_PROFILE
+#define CUSTARD_ZONE(name) \
+  static const int _custard_zone_id = custard::profile::global.zone(name); \
+  custard::profile::scope _custard_zone(custard::profile::global, \
+                                        _custard_zone_id)
+/// Start a new frame of custard::profile::global (call at vertical blank)
+#define CUSTARD_FRAME() custard::profile::global.frame()
+#else
+#define CUSTARD_ZONE(name) do {} while (0)
+#define CUSTARD_FRAME() do {} while (0)
+#endif
+
+namespace custard {
+
+/// Frame-time profiler
+//-----------------------------------------------------------------------------
+/// This namespace contains a scoped-zone profiler. Code is instrumented with
+/// \ref CUSTARD_ZONE and the frame loop with \ref CUSTARD_FRAME:
+///
+///     void update() {
+///       CUSTARD_ZONE("update");
+///       ...
+///     }
+///
+/// For each zone entered, the profiler records the start and end time and
+/// the scanline (VCOUNT) at both, so that work running past the start of
+/// vertical blanking (line 192) is easy to spot. The last few frames are kept
+/// in a ring buffer, and the time spent in each zone per frame is summarized
+/// as minimum, average and maximum. \ref recorder::write_frame and
+/// \ref recorder::write_summary export the data as CSV, e.g. to a file on the
+/// SD card, for reading on the host.
+///
+/// Times are measured in ticks of the 33.514 MHz system clock. On the DS they
+/// come from two cascaded hardware timers (see \ref CUSTARD_PROFILE_TIMER);
+/// on the host from std::chrono, converted to the same unit, with VCOUNT
+/// derived from the time since the frame started.
+//-----------------------------------------------------------------------------
+  namespace profile {
+//-----------------------------------------------------------------------------
+
+    constexpr uint32_t clock_rate = 33513982; ///< Ticks per second
+    constexpr uint32_t line_ticks = 2130;     ///< Ticks per scanline
+    constexpr int lines = 263;                ///< Scanlines per frame
+
+    /// Convert \p ticks to microseconds
+    constexpr uint32_t microseconds(uint32_t ticks) {
+      return uint32_t(uint64_t(ticks) * 1000000 / clock_rate);
+    }
+
+#ifdef ARM9
+    /// \brief Start the clock from zero (the timers run until stopped by
+    /// other code). Recorders already in use lose their timebase: see
+    /// \ref init.
+    inline void start_clock() {
+      constexpr int t = CUSTARD_PROFILE_TIMER;
+      TIMER_CR(t) = TIMER_CR(t + 1) = 0;
+      TIMER_DATA(t) = TIMER_DATA(t + 1) = 0;
+      TIMER_CR(t + 1) = TIMER_ENABLE | TIMER_CASCADE;
+      TIMER_CR(t) = TIMER_ENABLE | TIMER_DIV_1;
+    }
+    /// Current time in ticks
+    inline uint32_t now() {
+      constexpr int t = CUSTARD_PROFILE_TIMER;
+      uint16_t hi, lo;
+      do { hi = TIMER_DATA(t + 1); lo = TIMER_DATA(t); }
+      while (hi != TIMER_DATA(t + 1));
+      return uint32_t(hi) << 16 | lo;
+    }
+    /// Current scanline; \p frame_start is ignored on the DS
+    inline int vcount(uint32_t) { return REG_VCOUNT; }
+#else
+    // INTERNAL: host time at which the clock was started
+    inline std::chrono::steady_clock::time_point _epoch =
+      std::chrono::steady_clock::now();
+
+    // INTERNAL: ticks in \p ns nanoseconds, modulo 2^32 like the timers.
+    // Whole seconds and the remainder are converted separately, so that no
+    // product overflows however long the clock has run.
+    constexpr uint32_t _ticks(uint64_t ns) {
+      return uint32_t(ns / 1000000000 * clock_rate
+                      + ns % 1000000000 * clock_rate / 1000000000);
+    }
+
+    inline void start_clock() { _epoch = std::chrono::steady_clock::now(); }
+    inline uint32_t now() {
+      auto t = std::chrono::steady_clock::now() - _epoch;
+      return _ticks(uint64_t(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(t).count()));
+    }
+    inline int vcount(uint32_t frame_start) {
+      return int((now() - frame_start) / line_ticks % lines);
+    }
+#endif
+
+    /// \brief Start the clock unless it was started by an earlier call.
+    /// \details Each recorder calls this on construction, so that all of
+    /// them share one timebase however many are created.
+    inline void init() {
+      static bool started = (start_clock(), true);
+      (void)started;
+    }
+
+// Zone Recorder
+//-----------------------------------------------------------------------------
+/// \brief Records nested zones for the current frame and the last
+/// \p Frames - 1 complete ones, with up to \p Events zone entries per frame
+/// and \p Zones distinct zones. \details
+/// Zones entered beyond the capacity of a frame are counted in the summary
+/// but not recorded individually. Zones may nest up to 16 deep; deeper zones
+/// are ignored. A zone still open when a frame ends is split between the two
+/// frames, so \ref frame may be called from an interrupt handler: it and
+/// \ref enter and \ref leave disable interrupts while they update the
+/// recorder.
+//-----------------------------------------------------------------------------
+    template <int Zones = 32, int Events = 256, int Frames = 4>
+    class recorder {
+//-----------------------------------------------------------------------------
+      static_assert(Zones <= 256, "zone ids are 8-bit");
+      static_assert(Frames >= 2, "no complete frame would be kept");
+    public:
+      /// One entry into a zone
+      struct event {
+        uint32_t begin, end;           ///< Ticks, relative to the frame
+        uint16_t begin_line, end_line; ///< VCOUNT at entry and exit
+        uint8_t zone, depth;           ///< Zone id and nesting depth
+      };
+
+      /// Time spent in one zone per frame, in ticks
+      struct stats {
+        uint32_t min, max;
+        uint64_t sum;
+        uint32_t frames; ///< Frames summarized
+        uint32_t avg() const { return frames ? uint32_t(sum / frames) : 0; }
+      };
+
+    private:
+      struct record {
+        event events[Events];
+        int count;
+        uint32_t begin, length;
+      } frames[Frames] = {};
+
+      const char* names[Zones] = {};
+      int zones = 0;
+      uint32_t totals[Zones] = {}; // ticks in each zone this frame
+      stats summary[Zones] = {};
+      int stack[16];       // event of each open zone, or -1 if not recorded
+      uint8_t ids[16];     // id of each open zone
+      uint32_t entered[16];
+      int depth = 0, lost = 0; // open zones recorded and beyond 16 deep
+      int current = 0, recorded = 0;
+
+      // Interrupts are disabled while the open zones or the frame change
+      struct lock {
+#ifdef ARM9
+        uint32_t ime = REG_IME;
+        lock() { REG_IME = 0; }
+        ~lock() { REG_IME = ime; }
+#else
+        lock() {}
+#endif
+      };
+
+    public:
+      recorder() { init(); frames[0].begin = now(); }
+
+      /// \brief Id of the zone named \p name, which is added if new. Returns
+      /// the last id if the zone table is full.
+      int zone(const char* name) {
+        for (int i = 0; i < zones; ++i)
+          if (!strcmp(names[i], name)) return i;
+        if (zones == Zones) return Zones - 1;
+        names[zones] = name;
+        summary[zones] = {~0u, 0, 0, 0};
+        return zones++;
+      }
+      /// Name of zone \p id
+      const char* name(int id) const { return names[id]; }
+      /// Number of zones
+      int size() const { return zones; }
+
+      /// Enter zone \p id
+      void enter(int id) {
+        lock l;
+        if (depth == 16) { ++lost; return; }
+        record& f = frames[current];
+        uint32_t t = now() - f.begin;
+        entered[depth] = t;
+        stack[depth] = f.count < Events ? f.count : -1;
+        if (f.count < Events) {
+          event& e = f.events[f.count++];
+          e.begin = e.end = t;
+          e.begin_line = e.end_line = uint16_t(vcount(f.begin));
+          e.zone = uint8_t(id);
+          e.depth = uint8_t(depth);
+        }
+        ids[depth++] = uint8_t(id);
+      }
+
+      /// Leave the zone entered last
+      void leave() {
+        lock l;
+        if (lost) { --lost; return; }
+        if (!depth) return;
+        --depth;
+        record& f = frames[current];
+        uint32_t t = now() - f.begin;
+        totals[ids[depth]] += t - entered[depth];
+        if (stack[depth] >= 0) {
+          event& e = f.events[stack[depth]];
+          e.end = t;
+          e.end_line = uint16_t(vcount(f.begin));
+        }
+      }
+
+      /// \brief Close the current frame, update the summary, and start a new
+      /// frame. Call once per frame, at the start of vertical blanking.
+      void frame() {
+        lock l;
+        record& f = frames[current];
+        uint32_t t = now();
+        uint16_t line = uint16_t(vcount(f.begin));
+        f.length = t - f.begin;
+        // Zones still open are split at the frame boundary
+        for (int d = 0; d < depth; ++d) {
+          totals[ids[d]] += f.length - entered[d];
+          if (stack[d] >= 0) {
+            f.events[stack[d]].end = f.length;
+            f.events[stack[d]].end_line = line;
+          }
+        }
+        for (int i = 0; i < zones; ++i) {
+          stats& s = summary[i];
+          if (totals[i] < s.min) s.min = totals[i];
+          if (totals[i] > s.max) s.max = totals[i];
+          s.sum += totals[i];
+          ++s.frames;
+          totals[i] = 0;
+        }
+        current = (current + 1) % Frames;
+        if (recorded < Frames - 1) ++recorded; // one slot is the current frame
+        record& g = frames[current];
+        g.count = 0;
+        g.begin = t;
+        line = uint16_t(vcount(t));
+        for (int d = 0; d < depth; ++d) {
+          entered[d] = 0;
+          stack[d] = d < Events ? g.count++ : -1;
+          if (stack[d] >= 0)
+            g.events[stack[d]] = {0, 0, line, line, ids[d], uint8_t(d)};
+        }
+      }
+
+      /// \brief Number of complete frames held, at most \p Frames - 1 (the
+      /// other slot holds the current frame)
+      int history() const { return recorded; }
+      /// \brief Events of the frame \p ago frames before the current one
+      /// (1 = the last complete frame)
+      const event* events(int ago, int& count) const {
+        const record& f = frames[(current + Frames - ago) % Frames];
+        count = f.count;
+        return f.events;
+      }
+      /// Summary of zone \p id
+      const stats& summarize(int id) const { return summary[id]; }
+      /// Clear the summary
+      void reset() {
+        for (int i = 0; i < zones; ++i) summary[i] = {~0u, 0, 0, 0};
+      }
+
+      /// \brief Write the frame \p ago frames before the current one as CSV,
+      /// one line per zone entry, with times in microseconds
+      void write_frame(std::ostream& out, int ago = 1) const {
+        if (ago < 1 || ago > recorded) return;
+        const record& f = frames[(current + Frames - ago) % Frames];
+        out << "zone,depth,begin_us,end_us,time_us,begin_line,end_line\n";
+        for (int i = 0; i < f.count; ++i) {
+          const event& e = f.events[i];
+          out << names[e.zone] << ',' << int(e.depth) << ','
+              << microseconds(e.begin) << ',' << microseconds(e.end) << ','
+              << microseconds(e.end - e.begin) << ',' << e.begin_line << ','
+              << e.end_line << '\n';
+        }
+        out << "frame,0,0," << microseconds(f.length) << ','
+            << microseconds(f.length) << ",,\n";
+      }
+
+      /// \brief Write the summary as CSV, one line per zone, with times per
+      /// frame in microseconds
+      void write_summary(std::ostream& out) const {
+        out << "zone,min_us,avg_us,max_us,frames\n";
+        for (int i = 0; i < zones; ++i) {
+          const stats& s = summary[i];
+          out << names[i] << ',' << microseconds(s.frames ? s.min : 0) << ','
+              << microseconds(s.avg()) << ',' << microseconds(s.max) << ','
+              << s.frames << '\n';
+        }
+      }
+    };
+
+    /// Enters a zone on construction and leaves it on destruction
+    template <class R> struct basic_scope {
+      R& r;
+      basic_scope(R& r, int id) : r(r) { r.enter(id); }
+      ~basic_scope() { r.leave(); }
+      basic_scope(const basic_scope&) = delete;
+      basic_scope& operator=(const basic_scope&) = delete;
+    };
+
+    typedef basic_scope<recorder<>> scope;
+
+#ifdef CUSTARD_PROFILE
+    /// The recorder used by \ref CUSTARD_ZONE and \ref CUSTARD_FRAME
+    inline recorder<> global;
+#endif
+  }
+}
+
+#endif
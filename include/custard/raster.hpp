@@ -0,0 +1,118 @@
+#ifndef CUSTARD_RASTER_HPP
+#define CUSTARD_RASTER_HPP
+
+#include <cstdint>
+
+#ifdef ARM9
+#include <nds/arm9/cache.h>
+#include <nds/arm9/dma.h>
+#else
+#include <custard/host.hpp>
+#endif
+
+#include <custard/display.hpp>
+
+namespace custard {
+  namespace display {
+
+// Per-Scanline Register Tables
+//-----------------------------------------------------------------------------
+/// \brief Streams a table of register values into the display registers, one
+/// row per scanline, using HBlank DMA. \details
+///
+/// Raster effects such as wavy scroll, per-line affine transforms and
+/// mid-screen mode changes need different register values on each scanline.
+/// Instead of computing them in an HBlank interrupt handler, prepare a table
+/// with \p Words 32-bit words per line during the previous frame. The words of
+/// each row are written to consecutive registers starting at the destination
+/// given on construction, e.g. `&REG_BG0HOFS` for scroll effects (as a word
+/// pointer) or \ref main_io() for DISPCNT (see \ref shadow::reg for offsets).
+///
+/// The scheduler is double-buffered:
+///
+///     raster<1> wave(reinterpret_cast<volatile uint32_t*>(&REG_BG0HOFS));
+///     ...
+///     for (int y = 0; y < 192; ++y) wave.line(y)[0] = ...; // back table
+///     wave.present();
+///     swiWaitForVBlank();
+///
+/// and the vertical blank interrupt handler calls \ref vblank, which writes
+/// row 0 directly and starts a repeating HBlank DMA for rows 1 to 191. The CPU
+/// does no work per line. Do not modify the back table between \ref present
+/// and the next \ref vblank.
+///
+/// On the host, the DMA channel is simulated by custard/host.hpp, and
+/// \ref simulate steps REG_VCOUNT through the visible lines, running the
+/// horizontal blank transfers after each, so that the values each line
+/// receives can be checked.
+//-----------------------------------------------------------------------------
+    template <int Words, int Lines = 192> class raster {
+//-----------------------------------------------------------------------------
+      static_assert(Words > 0, "raster table must have at least one word");
+      static_assert(Lines == 192,
+                    "the DMA reads one row at every visible line");
+
+      // One spare row at the end is read by the DMA at the HBlank of the last
+      // line, after which the transfer is restarted in vertical blanking.
+      uint32_t tables[2][Lines + 1][Words] = {};
+      volatile uint32_t* dest;
+      int channel;
+      int front = 0;
+      bool ready = false;
+
+    public:
+      /// \brief Stream rows into the registers at \p dest using DMA channel
+      /// \p channel (not used on the host)
+      explicit raster(volatile uint32_t* dest, int channel = 0)
+        : dest(dest), channel(channel) {}
+
+      /// Row \p y of the back table, to be filled for the next frame
+      uint32_t* line(int y) { return tables[front ^ 1][y]; }
+
+      /// \brief Make the back table current from the next vertical blank. Do
+      /// not modify it again until \ref vblank has run.
+      void present() {
+        auto& t = tables[front ^ 1];
+        for (int i = 0; i < Words; ++i) t[Lines][i] = t[0][i];
+#ifdef ARM9
+        DC_FlushRange(t, sizeof(t));
+#endif
+        ready = true;
+      }
+
+      /// \brief Start streaming the current table. Call from the vertical
+      /// blank interrupt handler.
+      void vblank() {
+        if (ready) { front ^= 1; ready = false; }
+        const uint32_t* t = tables[front][0];
+        for (int i = 0; i < Words; ++i) dest[i] = t[i];
+        DMA_CR(channel) = 0;
+        DMA_SRC(channel) = uintptr_t(t + Words);
+        DMA_DEST(channel) = uintptr_t(dest);
+        DMA_CR(channel) = DMA_ENABLE | DMA_REPEAT | DMA_START_HBL
+          | DMA_32_BIT | DMA_SRC_INC | DMA_DST_RESET | Words;
+      }
+
+      /// Stop streaming; the registers keep the last values written
+      void stop() { DMA_CR(channel) = 0; }
+
+#ifndef ARM9
+      /// \brief Run one frame of the simulated display. \details
+      /// Call after \ref vblank. For each visible line y, REG_VCOUNT is set
+      /// to y and \p visit(y, dest) is called, as if drawing line y with the
+      /// registers' values; then the horizontal blank transfers run, writing
+      /// the row for the next line. REG_VCOUNT is left at 192.
+      template <class F> void simulate(F visit) {
+        for (int y = 0; y < Lines; ++y) {
+          REG_VCOUNT = uint16_t(y);
+          visit(y, (const volatile uint32_t*)dest);
+          host::hblank();
+        }
+        REG_VCOUNT = 192;
+      }
+#endif
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef CUSTARD_SPATIAL_HPP
+#define CUSTARD_SPATIAL_HPP
+
+#include <cstdint>
+
+#include <custard/types.hpp>
+
+namespace custard {
+
+/// Spatial indexing
+//-----------------------------------------------------------------------------
+/// This namespace contains a uniform grid for finding the entities near a
+/// point or region, e.g. as the broad phase of collision detection, in time
+/// proportional to the number of nearby entities rather than all entities.
+//-----------------------------------------------------------------------------
+  namespace spatial {
+//-----------------------------------------------------------------------------
+
+    /// Axis-aligned box, including \b lo and excluding \b hi
+    struct box {
+      vec2<q12> lo, hi;
+      bool overlaps(const box& b) const {
+        return lo.x < b.hi.x && b.lo.x < hi.x && lo.y < b.hi.y
+          && b.lo.y < hi.y;
+      }
+    };
+
+// Uniform Grid
+//-----------------------------------------------------------------------------
+/// \brief Indexes up to \p Capacity boxes in a grid of \p Columns by \p Rows
+/// square cells. \details
+///
+///     spatial::grid<256> g(vec2<q12>(), 5); // 32x32 pixel cells
+///     int id = g.insert(bounds);
+///     g.move(id, new_bounds);              // every frame
+///     g.pairs([](int a, int b) { ... });   // candidate collisions
+///
+/// Each entity is linked into the cell holding the centre of its box, so
+/// moving it costs O(1), and only when it changes cells. Queries search the
+/// cells around the region, widened by the largest half-size of any box
+/// inserted, so cells should be about the size of a typical entity: larger
+/// cells hold more entities to test, while a few outsized boxes widen the
+/// search for all. Positions outside the grid fall in its edge cells.
+///
+/// All storage is inside the object; nothing is allocated.
+//-----------------------------------------------------------------------------
+    template <int Capacity, int Columns = 32, int Rows = 32>
+    class grid {
+//-----------------------------------------------------------------------------
+      static_assert(Capacity < 32768 && Columns * Rows < 32768,
+                    "indices are 16-bit");
+
+      box boxes[Capacity];
+      int16_t head[Columns * Rows]; // first entity in each cell
+      int16_t next[Capacity], prev[Capacity]; // cell lists; free list in next
+      int16_t cells[Capacity];      // cell of each entity, or -1 if free
+      int16_t free_list;
+      int count;
+      vec2<q12> origin;
+      int shift;                    // log2 of the cell size in q12 units
+      int reach;                    // largest half-size of a box, raw q12
+
+      int column(int raw) const {
+        return custard::min(custard::max(raw >> shift, 0), Columns - 1);
+      }
+      int row(int raw) const {
+        return custard::min(custard::max(raw >> shift, 0), Rows - 1);
+      }
+      // Cells searched for boxes overlapping b, inclusive
+      void cover(const box& b, ivec2& c0, ivec2& c1) const {
+        c0 = ivec2(column(b.lo.x.raw() - origin.x.raw() - reach),
+                   row(b.lo.y.raw() - origin.y.raw() - reach));
+        c1 = ivec2(column(b.hi.x.raw() - origin.x.raw() + reach),
+                   row(b.hi.y.raw() - origin.y.raw() + reach));
+      }
+      int cell_of(const box& b) const {
+        int x = (b.lo.x.raw() >> 1) + (b.hi.x.raw() >> 1) - origin.x.raw();
+        int y = (b.lo.y.raw() >> 1) + (b.hi.y.raw() >> 1) - origin.y.raw();
+        return row(y) * Columns + column(x);
+      }
+      void widen(const box& b) {
+        int cx = (b.lo.x.raw() >> 1) + (b.hi.x.raw() >> 1);
+        int cy = (b.lo.y.raw() >> 1) + (b.hi.y.raw() >> 1);
+        reach = custard::max(reach, custard::max(
+          custard::max(cx - b.lo.x.raw(), b.hi.x.raw() - cx),
+          custard::max(cy - b.lo.y.raw(), b.hi.y.raw() - cy)));
+      }
+      void link(int id, int c) {
+        cells[id] = int16_t(c);
+        prev[id] = -1;
+        next[id] = head[c];
+        if (head[c] >= 0) prev[head[c]] = int16_t(id);
+        head[c] = int16_t(id);
+      }
+      void unlink(int id) {
+        int c = cells[id];
+        if (prev[id] >= 0) next[prev[id]] = next[id];
+        else head[c] = next[id];
+        if (next[id] >= 0) prev[next[id]] = prev[id];
+      }
+
+    public:
+      static constexpr int none = -1; ///< Returned when the grid is full
+
+      /// \brief Grid with its top-left corner at \p origin and cells of
+      /// 2^\p cell_shift units (pixels, for positions in pixels)
+      grid(vec2<q12> origin = vec2<q12>(), int cell_shift = 4)
+        : origin(origin), shift(cell_shift + 12) { clear(); }
+
+      /// Remove all entities
+      void clear() {
+        for (int16_t& h : head) h = -1;
+        for (int i = 0; i < Capacity; ++i) {
+          cells[i] = -1;
+          next[i] = int16_t(i + 1 < Capacity ? i + 1 : -1);
+        }
+        free_list = 0;
+        count = reach = 0;
+      }
+
+      /// Add an entity with bounds \p b, returning its id or \ref none
+      int insert(const box& b) {
+        if (free_list < 0) return none;
+        int id = free_list;
+        free_list = next[id];
+        boxes[id] = b;
+        widen(b);
+        link(id, cell_of(b));
+        ++count;
+        return id;
+      }
+      /// Remove entity \p id
+      void remove(int id) {
+        if (cells[id] < 0) return;
+        unlink(id);
+        cells[id] = -1;
+        next[id] = free_list;
+        free_list = int16_t(id);
+        --count;
+      }
+      /// Update the bounds of entity \p id
+      void move(int id, const box& b) {
+        if (cells[id] < 0) return;
+        boxes[id] = b;
+        widen(b);
+        int c = cell_of(b);
+        if (c == cells[id]) return;
+        unlink(id);
+        link(id, c);
+      }
+
+      /// Bounds of entity \p id
+      const box& bounds(int id) const { return boxes[id]; }
+      /// Is \p id an entity?
+      bool contains(int id) const { return cells[id] >= 0; }
+      /// Number of entities
+      int size() const { return count; }
+
+      /// Call \p f(id) for each entity whose bounds overlap \p b
+      template <class F> void query(const box& b, F f) const {
+        ivec2 c0, c1;
+        cover(b, c0, c1);
+        for (ivec2 c : range<ivec2>(c0, c1 + 1))
+          for (int i = head[c.y * Columns + c.x]; i >= 0; i = next[i])
+            if (boxes[i].overlaps(b)) f(i);
+      }
+
+      /// \brief Call \p f(a, b) once for each pair of entities whose bounds
+      /// overlap, with a < b
+      template <class F> void pairs(F f) const {
+        for (int a = 0; a < Capacity; ++a) {
+          if (cells[a] < 0) continue;
+          ivec2 c0, c1;
+          cover(boxes[a], c0, c1);
+          for (ivec2 c : range<ivec2>(c0, c1 + 1))
+            for (int i = head[c.y * Columns + c.x]; i >= 0; i = next[i])
+              if (i > a && boxes[i].overlaps(boxes[a])) f(a, i);
+        }
+      }
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,287 @@
+#ifndef CUSTARD_SPRITE_HPP
+#define CUSTARD_SPRITE_HPP
+
+#include <cstdint>
+
+#include <custard/types.hpp>
+
+namespace custard {
+
+/// Sprite attribute management
+//-----------------------------------------------------------------------------
+/// This namespace contains a shadow copy of the sprite attribute memory (OAM)
+/// with slot allocation, shared affine matrices and dirty tracking, a radix
+/// sort for ordering sprites by depth, and a multiplexer for displaying more
+/// than 128 sprites by reusing slots further down the screen.
+///
+/// \see GBATEK's documentation for sprite attributes:
+///   http://problemkaputt.de/gbatek.htm#lcdobjoamattributes
+//-----------------------------------------------------------------------------
+  namespace sprite {
+//-----------------------------------------------------------------------------
+
+    /// \brief One OAM entry, in the hardware layout. \details
+    /// The fourth halfword of each entry belongs to the affine parameter
+    /// groups interleaved with the sprite attributes: entries 4n to 4n+3 hold
+    /// PA, PB, PC and PD of affine group n.
+    struct entry {
+      uint16_t attr0, attr1, attr2, affine;
+
+      int y() const { return attr0 & 0xff; }
+      int x() const { return attr1 & 0x1ff; }
+      /// Height in pixels, including the double-size flag of affine sprites
+      int height() const {
+        static constexpr uint8_t h[3][4] = {
+          {8, 16, 32, 64}, {8, 8, 16, 32}, {16, 32, 32, 64} };
+        int shape = attr0 >> 14, size = attr1 >> 14;
+        int v = shape < 3 ? h[shape][size] : 8;
+        return (attr0 & 0x300) == 0x300 ? 2 * v : v;
+      }
+    };
+
+    /// Attribute 0 of a hidden sprite
+    constexpr uint16_t hidden = 0x200;
+
+    // Radix sort
+    //-------------------------------------------------------------------------
+
+    /// \brief Stable sort of \p n indices by 16-bit \p keys, in two 8-bit
+    /// counting passes. \details
+    /// On return, order[0..n) lists the indices of keys in ascending order.
+    /// \p scratch must have room for \p n indices. Use keys with the BG
+    /// priority in the top bits and depth below, so that sprites are ordered
+    /// as the hardware draws them: a lower OAM index is drawn on top.
+    template <class Index>
+    inline void radix_sort(const uint16_t* keys, Index* order, Index* scratch,
+                           int n) {
+      int count[256];
+      for (int i = 0; i < n; ++i) scratch[i] = Index(i);
+      for (int shift = 0; shift < 16; shift += 8) {
+        for (int& c : count) c = 0;
+        for (int i = 0; i < n; ++i) ++count[keys[scratch[i]] >> shift & 0xff];
+        for (int i = 0, sum = 0; i < 256; ++i) {
+          int c = count[i];
+          count[i] = sum;
+          sum += c;
+        }
+        for (int i = 0; i < n; ++i)
+          order[count[keys[scratch[i]] >> shift & 0xff]++] = scratch[i];
+        if (!shift) for (int i = 0; i < n; ++i) scratch[i] = order[i];
+      }
+    }
+
+    // Shadow OAM
+    //-------------------------------------------------------------------------
+
+    /// \brief A shadow copy of one engine's OAM. \details
+    ///
+    /// Sprite slots are handed out and returned in O(1) from a free stack,
+    /// with a bitmap of the slots in use so that a bad free is ignored.
+    /// Affine matrices are given in q12 and converted to the 8.8 format of the
+    /// hardware; sprites with the same matrix share one of the 32 affine
+    /// groups, which are reference counted.
+    ///
+    /// Writes that change an entry mark it dirty, and \ref upload copies only
+    /// runs of dirty entries, so a frame in which few sprites change costs a
+    /// few words of bus traffic instead of the whole 1K.
+    class oam {
+      alignas(32) entry entries[128];
+      uint32_t dirty[4] = {};
+      uint32_t used[4] = {};
+      uint8_t free_slots[128];
+      int free_count = 128;
+      struct group { int16_t p[4]; uint8_t refs; } groups[32] = {};
+
+      void touch(int i) { dirty[i >> 5] |= 1u << (i & 31); }
+
+    public:
+      oam() {
+        for (int i = 0; i < 128; ++i) {
+          entries[i] = {hidden, 0, 0, 0};
+          free_slots[i] = uint8_t(127 - i);
+        }
+        invalidate();
+      }
+
+      /// Take a free slot (lowest first), or -1 if all are in use
+      int alloc() {
+        if (!free_count) return -1;
+        int i = free_slots[--free_count];
+        used[i >> 5] |= 1u << (i & 31);
+        return i;
+      }
+      /// \brief Hide and return slot \p i. A slot that is out of range or
+      /// not allocated (e.g. already freed) is ignored.
+      void free(int i) {
+        if (unsigned(i) >= 128 || !(used[i >> 5] & 1u << (i & 31))) return;
+        used[i >> 5] &= ~(1u << (i & 31));
+        hide(i);
+        free_slots[free_count++] = uint8_t(i);
+      }
+
+      const entry& operator[](int i) const { return entries[i]; }
+
+      /// Set the attributes of slot \p i (the affine field is not changed)
+      void set(int i, uint16_t attr0, uint16_t attr1, uint16_t attr2) {
+        entry& e = entries[i];
+        if (e.attr0 == attr0 && e.attr1 == attr1 && e.attr2 == attr2) return;
+        e.attr0 = attr0; e.attr1 = attr1; e.attr2 = attr2;
+        touch(i);
+      }
+      void set(int i, const entry& e) { set(i, e.attr0, e.attr1, e.attr2); }
+      /// Hide slot \p i
+      void hide(int i) { set(i, hidden, 0, 0); }
+
+      /// \brief Find or allocate an affine group for the matrix (pa pb; pc pd)
+      /// and add a reference to it. Returns the group number, or -1 if all 32
+      /// groups hold other matrices.
+      int affine(q12 pa, q12 pb, q12 pc, q12 pd) {
+        int16_t p[4] = {
+          q8(pa).raw(), q8(pb).raw(), q8(pc).raw(), q8(pd).raw() };
+        int unused = -1;
+        for (int g = 0; g < 32; ++g) {
+          group& a = groups[g];
+          if (!a.refs) { if (unused < 0) unused = g; continue; }
+          if (a.p[0] == p[0] && a.p[1] == p[1] && a.p[2] == p[2]
+              && a.p[3] == p[3]) {
+            ++a.refs;
+            return g;
+          }
+        }
+        if (unused < 0) return -1;
+        group& a = groups[unused];
+        a.refs = 1;
+        for (int k = 0; k < 4; ++k) {
+          a.p[k] = p[k];
+          entries[4 * unused + k].affine = uint16_t(p[k]);
+          touch(4 * unused + k);
+        }
+        return unused;
+      }
+      /// Drop a reference to an affine group
+      void release_affine(int g) { if (groups[g].refs) --groups[g].refs; }
+
+      /// Mark entry \p i dirty, e.g. after it was overwritten in OAM
+      void mark(int i) { touch(i); }
+      /// Mark every entry dirty, e.g. after OAM was cleared
+      void invalidate() { dirty[0] = dirty[1] = dirty[2] = dirty[3] = ~0u; }
+
+      /// \brief Copy the dirty entries to OAM at \p dest (e.g. OAM or
+      /// OAM_SUB), in runs of 32-bit writes. Call during vertical blanking.
+      /// Returns the number of entries copied.
+      int upload(volatile uint16_t* dest) {
+        const uint32_t* src = reinterpret_cast<const uint32_t*>(entries);
+        volatile uint32_t* out = reinterpret_cast<volatile uint32_t*>(dest);
+        int copied = 0;
+        for (int w = 0; w < 4; ++w) {
+          for (uint32_t m = dirty[w]; m; ) {
+            int first = __builtin_ctz(m);
+            uint32_t clean = ~(m >> first);
+            int run = clean ? __builtin_ctz(clean) : 32; // dirty in a row
+            for (int i = 2 * (32 * w + first), end = i + 2 * run; i < end; ++i)
+              out[i] = src[i];
+            copied += run;
+            m &= run == 32 ? 0 : ~(((1u << run) - 1) << first);
+          }
+          dirty[w] = 0;
+        }
+        return copied;
+      }
+    };
+
+    // Sprite multiplexer
+    //-------------------------------------------------------------------------
+
+    /// \brief Displays up to \p N sprites by reusing OAM slots for sprites
+    /// lower on the screen. \details
+    ///
+    /// Add the frame's sprites, then call \ref build. Sprites are sorted by
+    /// y; each takes the slot that was vacated earliest by a sprite above it,
+    /// provided that sprite ends at least \p Lead lines before the new one
+    /// starts. The first sprite in each slot is written to the shadow OAM;
+    /// the rest are scheduled as writes in the HBlank of line y - \p Lead,
+    /// performed by \ref hblank. HBlank OAM access must be enabled in DISPCNT
+    /// (hblank_oam_access). Sprites that find no slot are dropped and counted.
+    ///
+    /// The schedule is double-buffered like the shadow OAM: \ref build
+    /// prepares the next frame while the current one is displayed, and
+    /// \ref vblank switches to it.
+    template <int N, int Lead = 2> class multiplexer {
+      entry items[N];
+      uint16_t keys[N], order[N], scratch[N];
+      struct event { uint16_t line; uint8_t slot; entry e; } events[2][N];
+      int event_count[2] = {}, back = 0;
+      int count = 0, next = 0, overflow = 0;
+
+    public:
+      /// Add a sprite for this frame; returns false if the multiplexer is full
+      bool add(const entry& e) {
+        if (count == N) return false;
+        items[count++] = e;
+        return true;
+      }
+
+      /// \brief Assign slots to this frame's sprites and write the first
+      /// occupant of each slot to \p o (slots [first, first + slots) are
+      /// used); the sprite list is then cleared.
+      void build(oam& o, int first = 0, int slots = 128) {
+        int free_line[128];
+        for (int s = 0; s < slots; ++s) free_line[s] = -256;
+        for (int i = 0; i < count; ++i) {
+          int y = items[i].y();
+          keys[i] = uint16_t((y >= 192 ? y - 256 : y) + 256);
+        }
+        radix_sort(keys, order, scratch, count);
+        int& n = event_count[back];
+        n = overflow = 0;
+        for (int k = 0; k < count; ++k) {
+          const entry& e = items[order[k]];
+          int y = keys[order[k]] - 256, best = -1;
+          for (int s = 0; s < slots; ++s)
+            if (free_line[s] + Lead <= y
+                && (best < 0 || free_line[s] < free_line[best])) best = s;
+          if (best < 0) { ++overflow; continue; }
+          if (free_line[best] == -256) o.set(first + best, e);
+          else events[back][n++] = {
+            uint16_t(y < Lead ? 0 : y - Lead), uint8_t(first + best), e };
+          free_line[best] = y + e.height();
+        }
+        for (int s = 0; s < slots; ++s)
+          if (free_line[s] == -256) o.hide(first + s);
+        // slots rewritten in HBlank in this frame or the next must be restored
+        // from the shadow by the next upload
+        for (int b = 0; b < 2; ++b)
+          for (int i = 0; i < event_count[b]; ++i) o.mark(events[b][i].slot);
+        count = 0;
+      }
+
+      /// Number of sprites dropped by the last \ref build
+      int dropped() const { return overflow; }
+      /// Number of slot reuses scheduled by the last \ref build
+      int scheduled() const { return event_count[back]; }
+
+      /// \brief Perform the slot reuses due at scanline \p vcount, writing
+      /// directly to OAM at \p dest. Call from the HBlank interrupt handler.
+      /// \details HBlank also occurs on the vertical blanking lines (192 and
+      /// up), where nothing is done: the schedule switched in by \ref vblank
+      /// starts at line 0. Reuses for sprites that start within \p Lead lines
+      /// of the top of the screen are done at line 0.
+      void hblank(volatile uint16_t* dest, int vcount) {
+        if (vcount >= 192) return;
+        const event* f = events[back ^ 1];
+        int n = event_count[back ^ 1];
+        for (; next < n && f[next].line <= vcount; ++next) {
+          const entry& e = f[next].e;
+          volatile uint16_t* d = dest + 4 * f[next].slot;
+          d[0] = e.attr0; d[1] = e.attr1; d[2] = e.attr2;
+        }
+      }
+
+      /// \brief Switch to the schedule prepared by the last \ref build. Call
+      /// in vertical blanking, after the shadow OAM was uploaded.
+      void vblank() { back ^= 1; event_count[back] = 0; next = 0; }
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef CUSTARD_TILEMAP_HPP
+#define CUSTARD_TILEMAP_HPP
+
+#include <climits>
+#include <cstdint>
+
+#include <custard/types.hpp>
+
+namespace custard {
+  namespace display {
+
+// Streaming Tile Map
+//-----------------------------------------------------------------------------
+/// \brief Scrolls a text background over a map of any size by streaming the
+/// tiles that come into view into a 64x64 hardware map. \details
+///
+/// The hardware map (BG size 512x512, four consecutive 2K screen blocks) is
+/// used as a ring buffer: map tile (x, y) is always stored at hardware tile
+/// (x mod 64, y mod 64), so the background scroll registers can simply be set
+/// to the camera position (see \ref scroll). The map keeps track of the
+/// rectangle of map tiles that the hardware map currently holds, and each
+/// \ref update extends it towards the camera's view plus a margin of
+/// \p margin tiles, one row or column strip at a time, copying at most
+/// \p budget bytes. A strip costs at most 128 bytes, so scrolling by a few
+/// pixels per frame costs a few hundred bytes instead of whole screen blocks.
+///
+/// Strips enter the hardware map outside the visible area as long as the
+/// camera moves by less than \p margin tiles per frame, so \ref update may be
+/// called at any time during the frame. After a jump, the view is filled in
+/// over the next few frames; use \ref load to fill it at once instead.
+///
+/// The destination is the start of the screen blocks, e.g.
+/// `BG_MAP_RAM(base)` for a screen base allocated with
+/// `vram::bg_allocator::screen(4)` (relative to the DISPCNT screen_base of
+/// the main engine). It may be any array of 4096 entries, e.g. on the host.
+//-----------------------------------------------------------------------------
+    class streaming_map {
+//-----------------------------------------------------------------------------
+      const uint16_t* map;     // map entries, row by row
+      ivec2 size;              // map size in tiles
+      volatile uint16_t* dest; // hardware map
+      int budget, margin;
+      ivec2 lo, hi;            // map tiles [lo, hi) held by the hardware map
+      int copied = 0, total = 0;
+
+      // Index of map tile (x, y) in four 32x32 screen blocks arranged 2x2
+      static int slot(int x, int y) {
+        x &= 63;
+        y &= 63;
+        return ((x >> 5) + (y >> 5 << 1)) << 10 | (y & 31) << 5 | (x & 31);
+      }
+
+      void column(int x) {
+        const uint16_t* src = map + x;
+        for (int y = lo.y; y < hi.y; ++y) dest[slot(x, y)] = src[y * size.x];
+        copied += 2 * (hi.y - lo.y);
+      }
+      void row(int y) {
+        const uint16_t* src = map + y * size.x;
+        for (int x = lo.x; x < hi.x; ++x) dest[slot(x, y)] = src[x];
+        copied += 2 * (hi.x - lo.x);
+      }
+
+      void stream(ivec2 camera, int limit) {
+        ivec2 t0 = ((camera >> 3) - margin).max(0);
+        ivec2 t1 = (((camera + ivec2(255, 191)) >> 3) + 1 + margin).min(size);
+        if (t0.x >= hi.x || t1.x <= lo.x || t0.y >= hi.y || t1.y <= lo.y)
+          lo = hi = t0; // nothing in view is held
+        copied = 0;
+        for (bool more = true; more; ) {
+          more = false;
+          int r = 2 * (hi.x - lo.x);
+          if (hi.y < t1.y && copied + r <= limit) {
+            row(hi.y++);
+            lo.y = max(lo.y, hi.y - 64);
+            more = true;
+          }
+          if (lo.y > t0.y && copied + r <= limit) {
+            row(--lo.y);
+            hi.y = min(hi.y, lo.y + 64);
+            more = true;
+          }
+          int c = 2 * (hi.y - lo.y);
+          if (hi.x < t1.x && copied + c <= limit) {
+            column(hi.x++);
+            lo.x = max(lo.x, hi.x - 64);
+            more = true;
+          }
+          if (lo.x > t0.x && copied + c <= limit) {
+            column(--lo.x);
+            hi.x = min(hi.x, lo.x + 64);
+            more = true;
+          }
+        }
+        total += copied;
+      }
+
+    public:
+      /// \brief Stream \p map, of \p size tiles stored row by row, into the
+      /// 64x64 hardware map at \p dest \details
+      /// \p budget must be at least 128, the cost of the longest strip, and
+      /// \p margin at most 15, so that the margin fits in the ring buffer.
+      streaming_map(const uint16_t* map, ivec2 size, volatile uint16_t* dest,
+                    int budget = 512, int margin = 2)
+        : map(map), size(size), dest(dest), budget(max(budget, 128)),
+          margin(min(margin, 15)) {}
+
+      /// \brief Upload the strips that the view at \p camera (top left, in
+      /// pixels) needs, within the per-frame budget
+      void update(ivec2 camera) { stream(camera, budget); }
+
+      /// Upload everything the view at \p camera needs, ignoring the budget
+      void load(ivec2 camera) { stream(camera, INT_MAX); }
+
+      /// Forget the contents of the hardware map, e.g. after it was reused
+      void invalidate() { lo = hi = ivec2(); }
+
+      /// \brief Does the hardware map hold every tile of the view at
+      /// \p camera?
+      bool ready(ivec2 camera) const {
+        ivec2 v0 = camera >> 3, v1 = (camera + ivec2(255, 191)) >> 3;
+        return lo.x <= max(v0.x, 0) && lo.y <= max(v0.y, 0)
+          && hi.x > min(v1.x, size.x - 1) && hi.y > min(v1.y, size.y - 1);
+      }
+
+      /// Background scroll offset that shows the view at \p camera
+      static ivec2 scroll(ivec2 camera) {
+        return ivec2(camera.x & 511, camera.y & 511);
+      }
+
+      /// Bytes copied by the last \ref update or \ref load
+      int bytes() const { return copied; }
+      /// Bytes copied since construction
+      int total_bytes() const { return total; }
+    };
+  }
+}
+
+#endif
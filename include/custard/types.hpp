@@ -1,16 +1,21 @@
 #ifndef CUSTARD_TYPES_HPP
 #define CUSTARD_TYPES_HPP
 
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <type_traits>
 
+#ifdef ARM9
 #include <nds/arm9/math.h>
+#endif
 
 namespace custard {
 
 //-----------------------------------------------------------------------------
-template <class T> inline T max(T a, T b) { return a > b ? a : b; }
-template <class T> inline T min(T a, T b) { return a < b ? a : b; }
-template <class T> inline T abs(T x) { return x > 0 ? x : -x; }
+template <class T> constexpr T max(T a, T b) { return a > b ? a : b; }
+template <class T> constexpr T min(T a, T b) { return a < b ? a : b; }
+template <class T> constexpr T abs(T x) { return x > 0 ? x : -x; }
 //-----------------------------------------------------------------------------
 
 //-----------------------------------------------------------------------------
@@ -24,118 +29,420 @@ template <class T> inline T pow(T x, int i) {
   return pow(pow(x, i >> 1), 2);
 }
 
+// INTERNAL: hardware-assisted division
+//-----------------------------------------------------------------------------
+#ifdef ARM9
+inline int32_t _div64(int64_t num, int32_t den) { return div64(num, den); }
+#else
+inline int32_t _div64(int64_t num, int32_t den) { return int32_t(num / den); }
+#endif
+
+// Generic fixed-point number
+//-----------------------------------------------------------------------------
+/// \brief A signed fixed-point number with \p F fraction bits, stored in the
+/// integer type \p S. \details
+///
+/// Products are computed in 64 bits before being shifted back, so no
+/// precision is lost to intermediate overflow. When \p Saturate is true, the
+/// results of construction and arithmetic are clamped to the representable
+/// range instead of wrapping. On the ARM9, division uses the hardware divider.
+///
+/// Conversions between formats are implicit only when they cannot lose
+/// precision or range (at least as many fraction bits and integer bits);
+/// otherwise they must be explicit. Both cases are decided at compile time.
+///
+/// Constructing a fixed from a float or double is constexpr, so it is free
+/// when the argument is a constant expression, but is otherwise a soft-float
+/// call on the ARM9. Prefer the literals (e.g. `1.25_q12`) for constants: they
+/// are parsed with integer arithmetic only and never emit a float operation,
+/// even without optimization.
 //-----------------------------------------------------------------------------
-class q12 {
+template <int F, class S = int32_t, bool Saturate = false> class fixed {
 //-----------------------------------------------------------------------------
-  int32 i;
-  static q12 with_i(int j) { q12 q; q.i = j; return q; }
+  static_assert(std::is_integral<S>::value && std::is_signed<S>::value,
+    "fixed-point storage must be a signed integer type");
+  static_assert(sizeof(S) <= 4, "fixed-point storage is limited to 32 bits");
+  static_assert(F >= 0 && F < int(8 * sizeof(S)),
+    "fixed-point fraction bits must fit in the storage type");
+
+  // Values are scaled by multiplying rather than shifting left, which is
+  // undefined for negative values and rejected in constant expressions
+  static constexpr int64_t one = int64_t(1) << F;
+
+  S i;
+  static constexpr fixed with_i(S j) { fixed q; q.i = j; return q; }
+  static constexpr S narrow(int64_t j) {
+    if (Saturate) {
+      if (j > std::numeric_limits<S>::max()) return std::numeric_limits<S>::max();
+      if (j < std::numeric_limits<S>::min()) return std::numeric_limits<S>::min();
+    }
+    return S(j);
+  }
+  template <int F2, class S2> static constexpr bool lossless() {
+    return F2 <= F && int(8 * sizeof(S2)) - F2 <= int(8 * sizeof(S)) - F;
+  }
 public:
-  q12() {}
-  q12(float f) : i(f * (1 << 12)) {}
-  q12(double f) : i(f * (1 << 12)) {}
-  q12(int i) : i(i << 12) {}
-  explicit operator float() const { return float(i) / (1 << 12); }
-  q12 operator+(const q12& q) const { return with_i(i + q.i); }
-  q12& operator+=(const q12& q) { i = (*this + q).i; return *this; }
-  q12 operator-(const q12& q) const { return with_i(i - q.i); }
-  q12& operator-=(const q12& q) { i = (*this - q).i; return *this; }
-  q12 operator*(const q12& q) const { return with_i(mulf32(i, q.i)); }
-  q12& operator*=(const q12& q) { i = (*this * q).i; return *this; }
-  q12 operator/(const q12& q) const { return with_i(divf32(i, q.i)); }
-  q12& operator/=(const q12& q) { i = (*this / q).i; return *this; }
-  q12 operator<<(const int& j) const { return with_i(i << j); }
-  q12& operator<<=(const int& j) { i = (*this << j).i; return *this; }
-  q12 operator>>(const int& j) const { return with_i(i >> j); }
-  q12& operator>>=(const int& j) { i = (*this >> j).i; return *this; }
-  q12 operator-() const { return with_i(-i); }
-  bool operator<(const q12& q) const { return i < q.i; }
-  bool operator>(const q12& q) const { return i > q.i; }
-  bool operator<=(const q12& q) const { return i <= q.i; }
-  bool operator>=(const q12& q) const { return i >= q.i; }
-  bool operator==(const q12& q) const { return i == q.i; }
-  bool operator!=(const q12& q) const { return i != q.i; }
-  friend std::ostream& operator<< (std::ostream& os, const q12& q) {
+  typedef S storage_type;
+  static constexpr int frac_bits = F;
+  static constexpr bool saturating = Saturate;
+
+  constexpr fixed() : i() {}
+  constexpr fixed(float f) : i(narrow(int64_t(f * float(int64_t(1) << F)))) {}
+  constexpr fixed(double f) : i(narrow(int64_t(f * double(int64_t(1) << F)))) {}
+  constexpr fixed(int n) : i(narrow(int64_t(n) * one)) {}
+
+  /// Convert from another format without loss
+  template <int F2, class S2, bool Sat2,
+    std::enable_if_t<lossless<F2, S2>(), int> = 0>
+  constexpr fixed(fixed<F2, S2, Sat2> q)
+    : i(narrow(int64_t(q.raw()) * (int64_t(1) << (F - F2)))) {}
+  /// Convert from another format, truncating fraction bits or range
+  template <int F2, class S2, bool Sat2,
+    std::enable_if_t<!lossless<F2, S2>(), int> = 0>
+  explicit constexpr fixed(fixed<F2, S2, Sat2> q)
+    : i(narrow(F >= F2
+        ? int64_t(q.raw()) * (int64_t(1) << (F >= F2 ? F - F2 : 0))
+        : int64_t(q.raw()) >> (F >= F2 ? 0 : F2 - F))) {}
+
+  /// Construct from the underlying representation
+  static constexpr fixed from_raw(S j) { return with_i(j); }
+  /// \brief Construct from a wide representation with the same number of
+  /// fraction bits, wrapping or saturating as configured
+  static constexpr fixed from_wide(int64_t j) { return with_i(narrow(j)); }
+  /// The underlying representation
+  constexpr S raw() const { return i; }
+
+  explicit constexpr operator float() const {
+    return float(i) / float(int64_t(1) << F);
+  }
+
+  constexpr fixed operator+(const fixed& q) const {
+    return with_i(narrow(int64_t(i) + q.i));
+  }
+  constexpr fixed& operator+=(const fixed& q) { i = (*this + q).i; return *this; }
+  constexpr fixed operator-(const fixed& q) const {
+    return with_i(narrow(int64_t(i) - q.i));
+  }
+  constexpr fixed& operator-=(const fixed& q) { i = (*this - q).i; return *this; }
+  constexpr fixed operator*(const fixed& q) const {
+    return with_i(narrow((int64_t(i) * q.i) >> F));
+  }
+  constexpr fixed& operator*=(const fixed& q) { i = (*this * q).i; return *this; }
+  fixed operator/(const fixed& q) const {
+    return with_i(narrow(_div64(int64_t(i) * one, q.i)));
+  }
+  fixed& operator/=(const fixed& q) { i = (*this / q).i; return *this; }
+  constexpr fixed operator<<(const int& j) const {
+    return with_i(S(int64_t(i) * (int64_t(1) << j)));
+  }
+  constexpr fixed& operator<<=(const int& j) { i = (*this << j).i; return *this; }
+  constexpr fixed operator>>(const int& j) const { return with_i(i >> j); }
+  constexpr fixed& operator>>=(const int& j) { i = (*this >> j).i; return *this; }
+  constexpr fixed operator-() const { return with_i(narrow(-int64_t(i))); }
+  constexpr bool operator<(const fixed& q) const { return i < q.i; }
+  constexpr bool operator>(const fixed& q) const { return i > q.i; }
+  constexpr bool operator<=(const fixed& q) const { return i <= q.i; }
+  constexpr bool operator>=(const fixed& q) const { return i >= q.i; }
+  constexpr bool operator==(const fixed& q) const { return i == q.i; }
+  constexpr bool operator!=(const fixed& q) const { return i != q.i; }
+  friend std::ostream& operator<< (std::ostream& os, const fixed& q) {
     return os << float(q);
   }
 };
 
+/// \brief Multiply two fixed-point numbers of any formats, returning the
+/// result in format \p R \details
+/// The full 64-bit product is formed before it is shifted to the fraction bits
+/// of \p R, so mixed-format products (e.g. a 1.15 gain applied to a 20.12
+/// sample) keep all available precision.
+template <class R, int F1, class S1, bool Sat1, int F2, class S2, bool Sat2>
+constexpr R mul(fixed<F1, S1, Sat1> a, fixed<F2, S2, Sat2> b) {
+  constexpr int shift = F1 + F2 - R::frac_bits;
+  int64_t p = int64_t(a.raw()) * b.raw();
+  constexpr int64_t up = int64_t(1) << (shift >= 0 ? 0 : -shift);
+  return R::from_wide(shift >= 0 ? p >> (shift >= 0 ? shift : 0) : p * up);
+}
+
+//-----------------------------------------------------------------------------
+typedef fixed<12> q12;               ///< 20.12, the native format of libnds
+typedef fixed<8, int16_t> q8;        ///< 8.8, e.g. sprite affine parameters
+typedef fixed<15, int16_t, true> q15; ///< 1.15 saturating, e.g. audio gain
+typedef fixed<16> q16;               ///< 16.16, e.g. world coordinates
+//-----------------------------------------------------------------------------
+
+// INTERNAL: integer-only parser for fixed-point literals
+//-----------------------------------------------------------------------------
+namespace _literal {
+//-----------------------------------------------------------------------------
+
+  // Parse a decimal literal (digits, optional point, optional fraction, digit
+  // separators allowed) and return it rounded to the nearest multiple of
+  // 2^-frac_bits, as an integer. Returns -1 if the literal is not decimal or
+  // has too many fraction digits to be represented exactly during parsing.
+  template <char... C> constexpr int64_t parse(int frac_bits) {
+    constexpr char s[] = {C...};
+    int64_t whole = 0, frac = 0, denom = 1;
+    bool point = false;
+    for (char c : s) {
+      if (c == '\'') continue;
+      if (c == '.' && !point) { point = true; continue; }
+      if (c < '0' || c > '9') return -1;
+      if (point) {
+        if (denom > (INT64_MAX >> frac_bits) / 10) return -1;
+        frac = frac * 10 + (c - '0');
+        denom *= 10;
+      }
+      else whole = whole * 10 + (c - '0');
+    }
+    return (whole << frac_bits) + ((frac << frac_bits) + denom / 2) / denom;
+  }
+
+  template <class Q, char... C> constexpr Q make() {
+    constexpr int64_t raw = parse<C...>(Q::frac_bits);
+    static_assert(raw >= 0, "fixed-point literal must be a plain decimal number");
+    static_assert(raw <= std::numeric_limits<typename Q::storage_type>::max(),
+      "fixed-point literal is out of range");
+    return Q::from_raw(typename Q::storage_type(raw));
+  }
+}
+
+/// \brief Fixed-point literals, e.g. `1.25_q12` \details
+/// The literals are evaluated at compile time using integer arithmetic only, so
+/// they never reference the soft-float library. Decimal literals only; negate
+/// the result for negative constants (`-0.5_q12`).
+template <char... C> constexpr q12 operator""_q12() {
+  return _literal::make<q12, C...>();
+}
+template <char... C> constexpr q8 operator""_q8() {
+  return _literal::make<q8, C...>();
+}
+template <char... C> constexpr q15 operator""_q15() {
+  return _literal::make<q15, C...>();
+}
+template <char... C> constexpr q16 operator""_q16() {
+  return _literal::make<q16, C...>();
+}
+
 //-----------------------------------------------------------------------------
 template <class T> struct vec2 {
 //-----------------------------------------------------------------------------
   T x, y;
-  vec2() : x(), y() {}
-  vec2(T x, T y) : x(x), y(y) {}
-  vec2 max(T t) const {
+  constexpr vec2() : x(), y() {}
+  constexpr vec2(T x, T y) : x(x), y(y) {}
+  constexpr vec2 max(T t) const {
     return vec2(custard::max(x, t), custard::max(y, t));
   }
-  vec2 max(vec2 v) const {
+  constexpr vec2 max(vec2 v) const {
     return vec2(custard::max(x, v.x), custard::max(y, v.y));
   }
-  vec2 min(T t) const {
+  constexpr vec2 min(T t) const {
     return vec2(custard::min(x, t), custard::min(y, t));
   }
-  vec2 min(vec2 v) const {
+  constexpr vec2 min(vec2 v) const {
     return vec2(custard::min(x, v.x), custard::min(y, v.y));
   }
-  T area() const { return x * y; }
-  vec2 operator+(T t) const { return vec2(x + t, y + t); }
-  vec2 operator+(vec2 v) const { return vec2(x + v.x, y + v.y); }
-  vec2 operator-(T t) const { return vec2(x - t, y - t); }
-  vec2 operator-(vec2 v) const { return vec2(x - v.x, y - v.y); }
-  vec2 operator*(T t) const { return vec2(x * t, y * t); }
-  vec2 operator*(vec2 v) const { return vec2(x * v.x, y * v.y); }
-  vec2 operator/(T t) const { return vec2(x / t, y / t); }
-  vec2 operator/(vec2 v) const { return vec2(x / v.x, y / v.y); }
-  vec2 operator>>(int t) const { return vec2(x >> t, y >> t); }
-  vec2 operator-() const { return vec2(-x, -y); }
+  constexpr T area() const { return x * y; }
+  constexpr vec2 operator+(T t) const { return vec2(x + t, y + t); }
+  constexpr vec2 operator+(vec2 v) const { return vec2(x + v.x, y + v.y); }
+  constexpr vec2 operator-(T t) const { return vec2(x - t, y - t); }
+  constexpr vec2 operator-(vec2 v) const { return vec2(x - v.x, y - v.y); }
+  constexpr vec2 operator*(T t) const { return vec2(x * t, y * t); }
+  constexpr vec2 operator*(vec2 v) const { return vec2(x * v.x, y * v.y); }
+  constexpr vec2 operator/(T t) const { return vec2(x / t, y / t); }
+  constexpr vec2 operator/(vec2 v) const { return vec2(x / v.x, y / v.y); }
+  constexpr vec2 operator>>(int t) const { return vec2(x >> t, y >> t); }
+  constexpr vec2 operator-() const { return vec2(-x, -y); }
 };
 
 //-----------------------------------------------------------------------------
 typedef vec2<int> ivec2;
 //-----------------------------------------------------------------------------
 
+//-----------------------------------------------------------------------------
+template <class T> struct vec3 {
+//-----------------------------------------------------------------------------
+  T x, y, z;
+  constexpr vec3() : x(), y(), z() {}
+  constexpr vec3(T x, T y, T z) : x(x), y(y), z(z) {}
+  constexpr vec3(vec2<T> v, T z) : x(v.x), y(v.y), z(z) {}
+  constexpr vec2<T> xy() const { return vec2<T>(x, y); }
+  constexpr T dot(vec3 v) const { return x * v.x + y * v.y + z * v.z; }
+  constexpr vec3 cross(vec3 v) const {
+    return vec3(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x);
+  }
+  constexpr vec3 operator+(vec3 v) const {
+    return vec3(x + v.x, y + v.y, z + v.z);
+  }
+  constexpr vec3 operator-(vec3 v) const {
+    return vec3(x - v.x, y - v.y, z - v.z);
+  }
+  constexpr vec3 operator*(T t) const { return vec3(x * t, y * t, z * t); }
+  constexpr vec3 operator*(vec3 v) const {
+    return vec3(x * v.x, y * v.y, z * v.z);
+  }
+  constexpr vec3 operator/(T t) const { return vec3(x / t, y / t, z / t); }
+  constexpr vec3 operator>>(int t) const {
+    return vec3(x >> t, y >> t, z >> t);
+  }
+  constexpr vec3 operator-() const { return vec3(-x, -y, -z); }
+};
+
 // discrete range iterable
 //-----------------------------------------------------------------------------
 template <class T=int> class range {
 //-----------------------------------------------------------------------------
-  T t0, t1, step; // t0 included, t1 excluded, t0 <= t1
+  T t0, t1, step; // t0 included, t1 excluded, t0 <= t1, step > 0
 public:
   struct iterator {
-    T t;
+    T t, step;
     T operator*() const { return t; }
-    bool operator!=(iterator other) const { return t != other.t; }
-    void operator++() { ++t; }
+    // ordered comparison, so that t1 need not be a multiple of step from t0
+    bool operator!=(iterator other) const { return t < other.t; }
+    void operator++() { t += step; }
   };
   range(T t1) : t0(), t1(t1), step(1) {}
   range(T t0, T t1, T step=1) : t0(t0), t1(t1), step(step) {}
-  iterator begin() { return {t0}; }
-  iterator end() { return {t1}; }
+  iterator begin() { return {t0, step}; }
+  iterator end() { return {t1, step}; }
 };
 
 // two-dimensional discrete range iterable
 //-----------------------------------------------------------------------------
+/// \brief Iterates over the points of a rectangle in row-major order.
+/// \details
+/// The rectangle includes \b v0 and excludes \b v1. An optional \b step gives
+/// the distance between consecutive points in each dimension (all components
+/// of which must be positive); the extent need not be a multiple of the step.
+///
+/// Use \ref tiles or \ref z_order to visit the same points in an order that
+/// follows the layout of tiled VRAM.
+//-----------------------------------------------------------------------------
 template <> class range<ivec2> {
 //-----------------------------------------------------------------------------
-  ivec2 v0, v1; // v0 included, v1 excluded, v0 <= v1
+  ivec2 v0, v1, step; // v0 included, v1 excluded, v0 <= v1, step > 0
 public:
   struct iterator {
-    ivec2 v; int xend;
+    ivec2 v; int x0, xend; ivec2 step;
     ivec2 operator*() const { return v; }
-    bool operator!=(int yend) const { return v.y != yend; }
+    bool operator!=(int yend) const { return v.y < yend; }
     void operator++() {
-      ++v.x;
-      if (v.x == xend) {
-        v.x = 0;
-        ++v.y;
+      v.x += step.x;
+      if (v.x >= xend) {
+        v.x = x0;
+        v.y += step.y;
       }
     }
   };
-  range(ivec2 v1) : v0(), v1(v1) {}
-  range(ivec2 v0, ivec2 v1) : v0(v0), v1(v1) {}
-  iterator begin() { return {v0, v1.x}; }
+  range(ivec2 v1) : v0(), v1(v1), step(1, 1) {}
+  range(ivec2 v0, ivec2 v1, ivec2 step=ivec2(1, 1))
+    : v0(v0), v1(v1), step(step) {}
+  iterator begin() {
+    // skip straight to the end if the rows are empty
+    return {ivec2(v0.x, v0.x < v1.x ? v0.y : v1.y), v0.x, v1.x, step};
+  }
   int end() { return v1.y; }
+
+  class tiled;
+  class morton;
+  /// \brief Visit the points tile by tile, in row-major order within each
+  /// tile, with tiles in row-major order (tiles are aligned to \b v0, and
+  /// their size need not be a multiple of the step)
+  tiled tiles(ivec2 tile = ivec2(8, 8)) const;
+  /// \brief Visit the points in Morton (Z) order of their positions relative
+  /// to \b v0, counted in steps
+  morton z_order() const;
 };
 
+// two-dimensional tiled range iterable
+//-----------------------------------------------------------------------------
+class range<ivec2>::tiled {
+//-----------------------------------------------------------------------------
+  ivec2 v0, v1, tile, step;
+public:
+  struct iterator {
+    ivec2 v, t; // point, tile origin
+    ivec2 v0, v1, tile, step;
+    ivec2 operator*() const { return v; }
+    bool operator!=(int yend) const { return t.y < yend; }
+    // first point of the range at or after a, in each dimension
+    ivec2 first(ivec2 a) const {
+      return v0 + (a - v0 + (step - 1)) / step * step;
+    }
+    void operator++() {
+      v.x += step.x;
+      if (v.x < min(t.x + tile.x, v1.x)) return;
+      v.x = first(t).x;
+      v.y += step.y;
+      if (v.y < min(t.y + tile.y, v1.y)) return;
+      // next tile holding a point (a tile may hold none if smaller than the
+      // step)
+      do {
+        t.x += tile.x;
+        if (t.x >= v1.x) {
+          t.x = v0.x;
+          t.y += tile.y;
+        }
+        v = first(t);
+      } while (t.y < v1.y && (v.x >= min(t.x + tile.x, v1.x)
+                              || v.y >= min(t.y + tile.y, v1.y)));
+    }
+  };
+  tiled(ivec2 v0, ivec2 v1, ivec2 tile, ivec2 step = ivec2(1, 1))
+    : v0(v0), v1(v1), tile(tile), step(step) {}
+  iterator begin() {
+    ivec2 t(v0.x, v0.x < v1.x ? v0.y : v1.y);
+    return {t, t, v0, v1, tile, step};
+  }
+  int end() { return v1.y; }
+};
+
+inline range<ivec2>::tiled range<ivec2>::tiles(ivec2 tile) const {
+  return tiled(v0, v1, tile, step);
+}
+
+// two-dimensional Morton order range iterable
+//-----------------------------------------------------------------------------
+/// Points are generated by de-interleaving a counter over the smallest
+/// power-of-two square enclosing the rectangle, skipping points outside the
+/// rectangle, so the traversal is most efficient for square power-of-two
+/// regions such as tiles and screen blocks.
+//-----------------------------------------------------------------------------
+class range<ivec2>::morton {
+//-----------------------------------------------------------------------------
+  ivec2 v0, size, step; // size in steps
+  // gather the even bits of i into the low half
+  static int even_bits(uint32_t i) {
+    i &= 0x55555555;
+    i = (i | (i >> 1)) & 0x33333333;
+    i = (i | (i >> 2)) & 0x0f0f0f0f;
+    i = (i | (i >> 4)) & 0x00ff00ff;
+    return (i | (i >> 8)) & 0x0000ffff;
+  }
+public:
+  struct iterator {
+    uint32_t i, n; ivec2 v0, size, step;
+    ivec2 d() const { return ivec2(even_bits(i), even_bits(i >> 1)); }
+    ivec2 operator*() const { return v0 + d() * step; }
+    bool operator!=(uint32_t end) const { return i < end; }
+    void operator++() {
+      do ++i; while (i < n && (d().x >= size.x || d().y >= size.y));
+    }
+  };
+  morton(ivec2 v0, ivec2 v1, ivec2 step = ivec2(1, 1))
+    : v0(v0), size(((v1 - v0 + (step - 1)) / step).max(0)), step(step) {}
+  iterator begin() { return {0, end(), v0, size, step}; }
+  uint32_t end() {
+    if (!size.x || !size.y) return 0;
+    uint32_t side = 1;
+    while (int(side) < size.x || int(side) < size.y) side <<= 1;
+    return side * side;
+  }
+};
+
+inline range<ivec2>::morton range<ivec2>::z_order() const {
+  return morton(v0, v1, step);
+}
+
 // two-dimensional zero-based range helper
 //-----------------------------------------------------------------------------
 inline range<ivec2> range2(int xend, int yend) {
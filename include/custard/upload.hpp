@@ -0,0 +1,239 @@
+#ifndef CUSTARD_UPLOAD_HPP
+#define CUSTARD_UPLOAD_HPP
+
+#include <cstdint>
+
+#ifdef ARM9
+#include <nds/arm9/cache.h>
+#include <nds/arm9/dma.h>
+#include <nds/interrupts.h>
+#else
+#include <custard/host.hpp>
+#endif
+
+namespace custard {
+  namespace vram {
+
+// VRAM Upload Queue
+//-----------------------------------------------------------------------------
+/// \brief Schedules copies into VRAM, up to a byte budget per vertical blank.
+/// \details
+///
+/// Instead of copying to VRAM whenever they like, subsystems enqueue jobs
+/// (source, destination, size, priority and optionally a deadline), and the
+/// vertical blank interrupt handler calls \ref vblank, which copies by DMA:
+///
+///     vram::upload_queue<> uploads;
+///     auto t = uploads.enqueue(tiles, BG_GFX + 0x2000, size, 1);
+///     ...
+///     if (uploads.done(t)) ...
+///
+/// Each vertical blank, jobs past their deadline frame are copied first, in
+/// full, whatever the budget; then the remaining jobs are copied in order of
+/// priority (highest first) and then of age until the budget is spent. A job
+/// larger than the budget left is split, and continues in the next frame.
+/// A job that continues another pending job exactly, in both source and
+/// destination, with the same priority and deadline and no callback of its
+/// own, is merged into it, so that many small contiguous writes become one
+/// transfer.
+///
+/// Completion is reported by polling a ticket with \ref done, or by a
+/// callback, which is called from \ref vblank (in interrupt context). The
+/// source must not change until the job is done: on the DS it is flushed
+/// from the data cache when the job is enqueued. Transfers are 32-bit if the
+/// source, destination and size are multiples of 4, otherwise 16-bit.
+///
+/// On the host, the DMA channel is simulated by custard/host.hpp, so a test
+/// can step the queue frame by frame, as a vertical blank handler would, and
+/// read back both the emulated VRAM and the transfers made.
+//-----------------------------------------------------------------------------
+    template <int Jobs = 32> class upload_queue {
+//-----------------------------------------------------------------------------
+      static_assert(Jobs <= 256, "ticket slots are 8-bit");
+
+    public:
+      typedef uint32_t ticket;                ///< Identifies a job
+      typedef void (*callback)(void* user);   ///< Called when a job is done
+      static constexpr uint32_t never = ~0u;  ///< No deadline
+
+      /// Transfer counters
+      struct stats {
+        uint32_t bytes;    ///< Bytes copied
+        uint32_t jobs;     ///< Jobs completed
+        uint32_t deferred; ///< Jobs still pending after a vertical blank
+        uint32_t overrun;  ///< Bytes copied beyond the budget for deadlines
+      };
+
+    private:
+      struct job {
+        const uint8_t* src;
+        volatile uint8_t* dest;
+        uint32_t bytes, sent, deadline, order;
+        int priority;
+        callback cb;
+        void* user;
+        uint8_t generation;
+        bool pending;
+      } jobs[Jobs] = {};
+
+      uint32_t budget, frames = 0, sequence = 0;
+      int channel;
+      stats previous = {}, totals = {};
+
+      bool due(const job& j) const {
+        return j.deadline != never && int32_t(j.deadline - frames) <= 0;
+      }
+      // Does a come before b?
+      bool before(const job& a, const job& b) const {
+        if (due(a) != due(b)) return due(a);
+        if (a.priority != b.priority) return a.priority > b.priority;
+        return int32_t(a.order - b.order) < 0;
+      }
+      ticket make_ticket(int i) const {
+        return (uint32_t(jobs[i].generation) << 8 | i) + 1;
+      }
+
+      void copy(const uint8_t* src, volatile uint8_t* dest, uint32_t n) {
+        bool words = !((uintptr_t(src) | uintptr_t(dest) | n) & 3);
+        while (DMA_CR(channel) & DMA_BUSY);
+        DMA_SRC(channel) = uintptr_t(src);
+        DMA_DEST(channel) = uintptr_t(dest);
+        DMA_CR(channel) = DMA_ENABLE | DMA_START_NOW | DMA_SRC_INC
+          | DMA_DST_INC | (words ? DMA_32_BIT | n >> 2 : DMA_16_BIT | n >> 1);
+        while (DMA_CR(channel) & DMA_BUSY);
+      }
+
+      // Interrupts are disabled while a producer changes the queue
+      struct lock {
+#ifdef ARM9
+        uint32_t ime = REG_IME;
+        lock() { REG_IME = 0; }
+        ~lock() { REG_IME = ime; }
+#else
+        lock() {}
+#endif
+      };
+
+    public:
+      /// \brief Copy at most \p budget bytes per vertical blank, by DMA on
+      /// \p channel
+      explicit upload_queue(uint32_t budget = 0x8000, int channel = 3)
+        : budget(budget), channel(channel) {}
+
+      /// Change the budget, in bytes per vertical blank
+      void set_budget(uint32_t bytes) { budget = bytes; }
+
+      /// \brief Copy \p bytes bytes (a multiple of 2) from \p src to \p dest
+      /// (both 2-byte aligned). Returns a ticket for the job, or 0 if the
+      /// queue is full or the size or an address is odd. \details
+      /// \p deadline is the \ref frame by whose vertical blank the job must
+      /// be complete, or \ref never. \p cb, if given, is called with \p user
+      /// when the job is complete.
+      ticket enqueue(const void* src, volatile void* dest, uint32_t bytes,
+                     int priority = 0, uint32_t deadline = never,
+                     callback cb = nullptr, void* user = nullptr) {
+        auto s = static_cast<const uint8_t*>(src);
+        auto d = static_cast<volatile uint8_t*>(dest);
+        // DMA can't copy a single byte, or address one
+        if (!bytes || (bytes | uintptr_t(s) | uintptr_t(d)) & 1) return 0;
+#ifdef ARM9
+        DC_FlushRange(src, bytes);
+#endif
+        lock l;
+        int free = -1;
+        for (int i = 0; i < Jobs; ++i) {
+          job& j = jobs[i];
+          if (!j.pending) { if (free < 0) free = i; continue; }
+          if (!cb && j.priority == priority && j.deadline == deadline
+              && j.src + j.bytes == s && j.dest + j.bytes == d) {
+            j.bytes += bytes;
+            return make_ticket(i);
+          }
+        }
+        if (free < 0) return 0;
+        job& j = jobs[free];
+        j.src = s;
+        j.dest = d;
+        j.bytes = bytes;
+        j.sent = 0;
+        j.deadline = deadline;
+        j.order = sequence++;
+        j.priority = priority;
+        j.cb = cb;
+        j.user = user;
+        j.pending = true;
+        return make_ticket(free);
+      }
+
+      /// Is the job of ticket \p t complete (or cancelled)?
+      bool done(ticket t) const {
+        if (!t) return true;
+        const job& j = jobs[(t - 1) & 0xff];
+        return !j.pending || j.generation != uint8_t((t - 1) >> 8);
+      }
+
+      /// \brief Drop the job of ticket \p t, without calling its callback.
+      /// Bytes already copied stay copied.
+      void cancel(ticket t) {
+        lock l;
+        if (done(t)) return;
+        job& j = jobs[(t - 1) & 0xff];
+        j.pending = false;
+        ++j.generation;
+      }
+
+      /// \brief Copy this frame's share of the queue, and advance the frame.
+      /// Call from the vertical blank interrupt handler.
+      void vblank() {
+        stats s = {};
+        uint32_t left = budget;
+        for (;;) {
+          job* next = nullptr;
+          for (job& j : jobs)
+            if (j.pending && (!next || before(j, *next))) next = &j;
+          if (!next) break;
+          job& j = *next;
+          uint32_t n = j.bytes - j.sent;
+          if (due(j)) {
+            if (n > left) s.overrun += n - left;
+          }
+          else if (n > left) {
+            n = left & ~3u; // keep the rest of the job word aligned
+            if (!n) break;
+          }
+          copy(j.src + j.sent, j.dest + j.sent, n);
+          j.sent += n;
+          s.bytes += n;
+          left -= n < left ? n : left;
+          if (j.sent < j.bytes) break;
+          j.pending = false;
+          ++j.generation;
+          ++s.jobs;
+          if (j.cb) j.cb(j.user);
+        }
+        for (const job& j : jobs) s.deferred += j.pending;
+        previous = s;
+        totals.bytes += s.bytes;
+        totals.jobs += s.jobs;
+        totals.deferred += s.deferred;
+        totals.overrun += s.overrun;
+        ++frames;
+      }
+
+      /// Number of vertical blanks processed
+      uint32_t frame() const { return frames; }
+      /// Number of jobs pending
+      int pending() const {
+        int n = 0;
+        for (const job& j : jobs) n += j.pending;
+        return n;
+      }
+      /// Counters of the last vertical blank
+      const stats& last() const { return previous; }
+      /// Counters summed over all vertical blanks
+      const stats& total() const { return totals; }
+    };
+  }
+}
+
+#endif
@@ -1,7 +1,13 @@
 #ifndef CUSTARD_VRAM_HPP
 #define CUSTARD_VRAM_HPP
 
+#include <cstdint>
+
+#ifdef ARM9
 #include <nds/arm9/video.h>
+#else
+#include <custard/host.hpp>
+#endif
 
 // TODO: texture and texture palette memory, LCDC and ARM7 WRAM mapping
 
@@ -213,6 +219,234 @@ namespace custard {
       static void D() { _vram_helper::D(0); }
     };
 
+
+    //-------------------------------------------------------------------------
+    // Compile-time VRAM mapping plans
+    //-------------------------------------------------------------------------
+
+    // The mapping functions above write each bank control register as they are
+    // called, and nothing prevents two banks from being mapped to the same
+    // addresses. A plan instead describes a complete VRAM mapping as a type:
+    //
+    //   using level_vram = vram::plan<
+    //     vram::map<vram::bank::A, vram::region::main_bg, 0>,
+    //     vram::map<vram::bank::B, vram::region::main_sprite>,
+    //     vram::map<vram::bank::C, vram::region::sub_bg>>;
+    //
+    //   level_vram::apply();
+    //
+    // Mappings are validated with static_assert: each bank must support the
+    // region and offset it is mapped to, no bank may be mapped twice, and no
+    // two banks may overlap within a region. Banks that are not mentioned are
+    // disabled. The control register values are computed at compile time, and
+    // apply() writes them with four stores (one for all of A-D).
+
+    /// VRAM banks
+    enum class bank { A, B, C, D, E, F, G, H, I };
+
+    /// Regions to which VRAM banks may be mapped
+    enum class region {
+      lcdc,                   ///< LCDC (plain) mode, at the bank's own address
+      main_bg,                ///< Main engine background graphics
+      main_sprite,            ///< Main engine sprite graphics
+      sub_bg,                 ///< Sub engine background graphics
+      sub_sprite,             ///< Sub engine sprite graphics
+      arm7,                   ///< ARM7 work memory (banks C and D only)
+      texture,                ///< 3D texture image slots
+      texture_palette,        ///< 3D texture palette slots
+      main_bg_ext_palette,    ///< Main engine background extended palettes
+      main_sprite_ext_palette, ///< Main engine sprite extended palettes
+      sub_bg_ext_palette,     ///< Sub engine background extended palettes
+      sub_sprite_ext_palette  ///< Sub engine sprite extended palettes
+    };
+
+    // INTERNAL
+    //-------------------------------------------------------------------------
+
+    struct _mapping {
+      bank b; region r; int offset;
+      int mst;        // bank control MST field, or -1 if the region is invalid
+      int offsets;    // number of valid offsets
+      uint32_t begin; // start within the region's address space
+      uint32_t size;  // bytes occupied within the region's address space
+    };
+
+    constexpr uint32_t _bank_size(bank b) {
+      return b <= bank::D ? 0x20000 : b == bank::E ? 0x10000
+           : b == bank::H ? 0x8000 : 0x4000;
+    }
+
+    // Pointer to DS address a (or the host memory standing in for it)
+    template <class T> inline volatile T* _pointer(uint32_t a) {
+#ifdef ARM9
+      return reinterpret_cast<volatile T*>(a);
+#else
+      return host::at<T>(a);
+#endif
+    }
+
+    constexpr uint32_t _lcdc_address(bank b) {
+      constexpr uint32_t address[] = {
+        0x06800000, 0x06820000, 0x06840000, 0x06860000, 0x06880000,
+        0x06890000, 0x06894000, 0x06898000, 0x068A0000 };
+      return address[int(b)];
+    }
+
+    // Placement of a bank in a region, see GBATEK's documentation of the VRAM
+    // bank control registers:
+    //   http://problemkaputt.de/gbatek.htm#dsmemorycontrolvram
+    constexpr _mapping _map(bank b, region r, int o) {
+      _mapping m {b, r, o, -1, 1, 0, _bank_size(b)};
+      if (r == region::lcdc) {
+        m.mst = 0;
+        m.begin = _lcdc_address(b);
+      }
+      else if (b <= bank::D) {
+        uint32_t slot = 0x20000 * uint32_t(o);
+        if (r == region::main_bg) { m.mst = 1; m.offsets = 4; m.begin = slot; }
+        if (r == region::texture) { m.mst = 3; m.offsets = 4; m.begin = slot; }
+        if (b <= bank::B && r == region::main_sprite) {
+          m.mst = 2; m.offsets = 2; m.begin = slot;
+        }
+        if (b >= bank::C && r == region::arm7) {
+          m.mst = 2; m.offsets = 2; m.begin = slot;
+        }
+        if (b == bank::C && r == region::sub_bg) m.mst = 4;
+        if (b == bank::D && r == region::sub_sprite) m.mst = 4;
+      }
+      else if (b == bank::E) {
+        if (r == region::main_bg) m.mst = 1;
+        if (r == region::main_sprite) m.mst = 2;
+        if (r == region::texture_palette) m.mst = 3;
+        if (r == region::main_bg_ext_palette) { m.mst = 4; m.size = 0x8000; }
+      }
+      else if (b <= bank::G) {
+        uint32_t slot = 0x4000 * uint32_t(o & 1) + 0x10000 * uint32_t(o >> 1);
+        uint32_t tex_slot = 0x4000 * uint32_t((o & 1) + 4 * (o >> 1));
+        if (r == region::main_bg) { m.mst = 1; m.offsets = 4; m.begin = slot; }
+        if (r == region::main_sprite) {
+          m.mst = 2; m.offsets = 4; m.begin = slot;
+        }
+        if (r == region::texture_palette) {
+          m.mst = 3; m.offsets = 4; m.begin = tex_slot;
+        }
+        if (r == region::main_bg_ext_palette) {
+          m.mst = 4; m.offsets = 2; m.begin = 0x4000 * uint32_t(o);
+        }
+        if (r == region::main_sprite_ext_palette) {
+          m.mst = 5; m.size = 0x2000;
+        }
+      }
+      else if (b == bank::H) {
+        if (r == region::sub_bg) m.mst = 1;
+        if (r == region::sub_bg_ext_palette) m.mst = 2;
+      }
+      else {
+        if (r == region::sub_bg) { m.mst = 1; m.begin = 0x8000; }
+        if (r == region::sub_sprite) m.mst = 2;
+        if (r == region::sub_sprite_ext_palette) {
+          m.mst = 3; m.size = 0x2000;
+        }
+      }
+      return m;
+    }
+
+    constexpr bool _overlap(const _mapping& m, const _mapping& n) {
+      return m.r == n.r
+        && m.begin < n.begin + n.size && n.begin < m.begin + m.size;
+    }
+
+    //-------------------------------------------------------------------------
+
+    /// Map bank \p B to region \p R at offset \p Offset (for use in a plan)
+    template <bank B, region R, int Offset = 0> struct map {
+      static constexpr _mapping info = _map(B, R, Offset);
+      static_assert(info.mst >= 0,
+        "VRAM bank cannot be mapped to this region");
+      static_assert(Offset >= 0 && Offset < info.offsets,
+        "VRAM bank cannot be mapped to this region at this offset");
+      /// Bank control register value
+      static constexpr uint8_t cr =
+        VRAM_ENABLE | info.mst | VRAM_OFFSET(Offset);
+    };
+
+    /// A complete, validated VRAM bank mapping (see above)
+    template <class... M> struct plan {
+
+      // INTERNAL
+      static constexpr _mapping _maps[] = { M::info..., _mapping{} };
+      static constexpr int _count = sizeof...(M);
+
+      static constexpr bool _unique_banks() {
+        for (int i = 0; i < _count; ++i)
+          for (int j = i + 1; j < _count; ++j)
+            if (_maps[i].b == _maps[j].b) return false;
+        return true;
+      }
+      static constexpr bool _disjoint() {
+        for (int i = 0; i < _count; ++i)
+          for (int j = i + 1; j < _count; ++j)
+            if (_overlap(_maps[i], _maps[j])) return false;
+        return true;
+      }
+      static_assert(_unique_banks(), "VRAM bank is mapped more than once");
+      static_assert(_disjoint(), "VRAM banks overlap in the same region");
+
+      /// Control register value of a bank (0 if it is not mapped)
+      static constexpr uint8_t cr(bank b) {
+        uint8_t values[] = { M::cr..., 0 };
+        for (int i = 0; i < _count; ++i) if (_maps[i].b == b) return values[i];
+        return 0;
+      }
+      /// Is bank \p b mapped to region \p r?
+      static constexpr bool maps(bank b, region r) {
+        for (int i = 0; i < _count; ++i)
+          if (_maps[i].b == b && _maps[i].r == r) return true;
+        return false;
+      }
+      /// \brief Number of contiguous bytes mapped from the start of a region
+      /// (for extended palettes, the start of slot 0)
+      static constexpr uint32_t extent(region r) {
+        uint32_t end = 0;
+        for (bool grew = true; grew; ) {
+          grew = false;
+          for (int i = 0; i < _count; ++i)
+            if (_maps[i].r == r && _maps[i].begin <= end
+                && _maps[i].begin + _maps[i].size > end) {
+              end = _maps[i].begin + _maps[i].size;
+              grew = true;
+            }
+        }
+        return end;
+      }
+
+      /// Packed values of VRAM_CR (A-D), VRAM_E/F_CR, VRAM_G_CR and
+      /// VRAM_H/I_CR
+      static constexpr uint32_t abcd = cr(bank::A) | cr(bank::B) << 8
+        | cr(bank::C) << 16 | uint32_t(cr(bank::D)) << 24;
+      static constexpr uint16_t ef = cr(bank::E) | cr(bank::F) << 8;
+      static constexpr uint8_t g = cr(bank::G);
+      static constexpr uint16_t hi = cr(bank::H) | cr(bank::I) << 8;
+
+      /// Instate this mapping. WRAM_CR, which shares a word with banks E-G, is
+      /// not modified.
+      static void apply() {
+        VRAM_CR = abcd;
+        *(vu16*)&VRAM_E_CR = ef;
+        VRAM_G_CR = g;
+        *(vu16*)&VRAM_H_CR = hi;
+      }
+    };
+
+    /// \brief Switch from one plan to another, writing only the control
+    /// registers whose values differ
+    template <class From, class To> inline void transition() {
+      if constexpr (From::abcd != To::abcd) VRAM_CR = To::abcd;
+      if constexpr (From::ef != To::ef) *(vu16*)&VRAM_E_CR = To::ef;
+      if constexpr (From::g != To::g) VRAM_G_CR = To::g;
+      if constexpr (From::hi != To::hi) *(vu16*)&VRAM_H_CR = To::hi;
+    }
+
   }
 }
 
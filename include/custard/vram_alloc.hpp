@@ -0,0 +1,258 @@
+#ifndef CUSTARD_VRAM_ALLOC_HPP
+#define CUSTARD_VRAM_ALLOC_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <custard/vram.hpp>
+
+namespace custard {
+  namespace vram {
+
+    //-------------------------------------------------------------------------
+    // Allocate graphics memory within mapped VRAM regions
+    //-------------------------------------------------------------------------
+
+    // Once banks are mapped, backgrounds and sprites still need to be given
+    // places within the mapped regions. The allocators below hand out aligned
+    // blocks of a region and track what is in use, so that graphics can be
+    // loaded and unloaded as levels change without computing offsets by hand.
+    //
+    // Allocators work with offsets only (char and screen base numbers, sprite
+    // tile indices) and never touch VRAM, so they behave identically on the
+    // host. Size them from a plan, e.g.
+    //
+    //   vram::bg_allocator<> bg(level_vram::extent(vram::region::main_bg));
+
+    // Block allocator
+    //-------------------------------------------------------------------------
+
+    /// \brief Allocates aligned runs of equal-size blocks, with reference
+    /// counts \details
+    ///
+    /// Allocation state is kept in bitmaps, so finding a free run scans one
+    /// 32-bit word per 32 blocks rather than visiting each block, and
+    /// allocation and release do not touch the managed memory. Each run has a
+    /// reference count, so that graphics shared by several users are released
+    /// only when the last user releases them.
+    template <size_t Blocks> class block_allocator {
+
+      static constexpr size_t words = (Blocks + 31) / 32;
+      uint32_t used[words] = {}; // block is allocated
+      uint32_t cont[words] = {}; // block is allocated and not last in its run
+      uint8_t refs[Blocks] = {}; // reference count of the run starting here
+      size_t limit;              // number of blocks available
+
+      // Reference counts stop here and the run is never freed, since the
+      // number of references dropped can no longer be matched
+      static constexpr uint8_t pinned = 255;
+
+      static uint32_t bit(size_t i) { return 1u << (i & 31); }
+      bool is_used(size_t i) const { return used[i >> 5] & bit(i); }
+
+      // Index of the last used block in [s, s + n), or -1 if all are free
+      int last_used(size_t s, size_t n) const {
+        for (size_t e = s + n; e > s; ) {
+          size_t w = (e - 1) >> 5, lo = w << 5 > s ? w << 5 : s;
+          uint32_t mask = ~0u >> (31 - ((e - 1) & 31)) & ~0u << (lo & 31);
+          if (uint32_t u = used[w] & mask)
+            return int(w * 32 + 31 - __builtin_clz(u));
+          e = lo;
+        }
+        return -1;
+      }
+
+      void mark(size_t s, size_t n) {
+        for (size_t i = s; i < s + n; ++i) {
+          used[i >> 5] |= bit(i);
+          if (i + 1 < s + n) cont[i >> 5] |= bit(i);
+        }
+        refs[s] = 1;
+      }
+
+    public:
+      static constexpr int none = -1; ///< Returned when allocation fails
+
+      /// Manage the first \p blocks blocks (at most \p Blocks)
+      explicit block_allocator(size_t blocks = Blocks)
+        : limit(blocks < Blocks ? blocks : Blocks) {}
+
+      /// Number of blocks managed
+      size_t size() const { return limit; }
+
+      /// \brief Allocate \p n contiguous blocks starting at a multiple of
+      /// \p align, entirely within [first, last). \details
+      /// Searches upward from \p first, or downward from \p last if
+      /// \p top_down is set (use opposite directions for allocations with
+      /// different constraints to reduce fragmentation). Returns the first
+      /// block of the run, or \ref none.
+      int alloc(size_t n, size_t align = 1, size_t first = 0,
+                size_t last = Blocks, bool top_down = false) {
+        if (last > limit) last = limit;
+        first = (first + align - 1) / align * align;
+        if (!n || first + n > last) return none;
+        if (!top_down) {
+          for (size_t s = first; s + n <= last; ) {
+            int u = last_used(s, n);
+            if (u < 0) { mark(s, n); return int(s); }
+            s = (size_t(u) / align + 1) * align; // skip past the used block
+          }
+        }
+        else {
+          for (size_t s = (last - n) / align * align; ; s -= align) {
+            if (last_used(s, n) < 0) { mark(s, n); return int(s); }
+            if (s < first + align) break;
+          }
+        }
+        return none;
+      }
+
+      /// \brief Add a reference to the run starting at \p s \details
+      /// Does nothing if no run starts at \p s. After 255 references the run
+      /// is pinned: further retains and releases are ignored and it stays
+      /// allocated until reset().
+      void retain(int s) {
+        if (starts_run(s) && refs[s] != pinned) ++refs[s];
+      }
+
+      /// \brief Drop a reference to the run starting at \p s, freeing it when
+      /// no references remain. Returns true if the run was freed.
+      bool release(int s) {
+        if (!starts_run(s) || refs[s] == pinned || --refs[s]) return false;
+        size_t i = size_t(s);
+        for (bool more = true; more; ++i) {
+          more = cont[i >> 5] & bit(i);
+          used[i >> 5] &= ~bit(i);
+          cont[i >> 5] &= ~bit(i);
+        }
+        return true;
+      }
+
+      /// Does an allocated run start at block \p s?
+      bool starts_run(int s) const {
+        return s >= 0 && size_t(s) < limit && refs[s];
+      }
+
+      /// Reference count of the run starting at \p s (0 if none does)
+      int references(int s) const { return starts_run(s) ? refs[s] : 0; }
+
+      /// Free everything
+      void reset() { *this = block_allocator(limit); }
+
+      /// Usage and fragmentation report
+      struct stats {
+        size_t used;         ///< Blocks allocated
+        size_t free;         ///< Blocks free
+        size_t largest_free; ///< Longest run of free blocks
+        size_t free_runs;    ///< Number of separate runs of free blocks
+        size_t allocations;  ///< Number of allocated runs
+        /// \brief Share of free blocks outside the largest free run, as a
+        /// percentage: 0 means all free memory is contiguous
+        int fragmentation() const {
+          return free ? int(100 - 100 * largest_free / free) : 0;
+        }
+      };
+
+      stats report() const {
+        stats s {};
+        size_t run = 0;
+        for (size_t i = 0; i < limit; ++i) {
+          if (is_used(i)) {
+            ++s.used;
+            if (refs[i]) ++s.allocations;
+            run = 0;
+          }
+          else {
+            ++s.free;
+            if (!run++) ++s.free_runs;
+            if (run > s.largest_free) s.largest_free = run;
+          }
+        }
+        return s;
+      }
+    };
+
+    // Background graphics allocator
+    //-------------------------------------------------------------------------
+
+    /// \brief Allocates tile (char) and map (screen) blocks in a background
+    /// region of up to \p Bytes bytes \details
+    ///
+    /// The region is managed in 2K units, the size of a screen block. Char
+    /// blocks are 16K aligned and must lie in the first 256K of the region
+    /// (char base 0-15); screen blocks must lie in the first 64K (screen base
+    /// 0-31). Screen blocks are allocated from the bottom of the region and
+    /// char blocks from the top of their window, so that the two kinds of
+    /// allocation do not fragment each other. The returned bases are relative
+    /// to the DISPCNT char_base and screen_base offsets of the main engine.
+    template <size_t Bytes = 0x80000> class bg_allocator {
+      block_allocator<Bytes / 0x800> blocks;
+    public:
+      static constexpr int none = -1; ///< Returned when allocation fails
+
+      /// Manage the first \p bytes of the region, e.g. its mapped extent
+      explicit bg_allocator(size_t bytes = Bytes) : blocks(bytes / 0x800) {}
+
+      /// \brief Allocate \p count consecutive screen blocks (4 for a 64x64
+      /// map) and return the screen base of the first
+      int screen(int count = 1) { return blocks.alloc(count, 1, 0, 32); }
+      /// Allocate \p bytes of tile graphics and return their char base
+      int chars(size_t bytes) {
+        int b = blocks.alloc((bytes + 0x7ff) / 0x800, 8, 0, 128, true);
+        return b < 0 ? none : b / 8;
+      }
+
+      void retain_screen(int base) { blocks.retain(base); }
+      void retain_chars(int base) { blocks.retain(base * 8); }
+      bool release_screen(int base) { return blocks.release(base); }
+      bool release_chars(int base) { return blocks.release(base * 8); }
+
+      /// Usage report, in 2K units
+      typename block_allocator<Bytes / 0x800>::stats report() const {
+        return blocks.report();
+      }
+      void reset() { blocks.reset(); }
+    };
+
+    // Sprite graphics allocator
+    //-------------------------------------------------------------------------
+
+    /// \brief Allocates sprite tiles in a sprite region of up to \p Bytes
+    /// bytes \details
+    ///
+    /// In 1D tile mapping, a sprite's tile index counts units of 32, 64, 128
+    /// or 256 bytes according to DISPCNT tile_obj_1d_boundary, and indices
+    /// are limited to 10 bits. The allocator works in those units, so the
+    /// values it returns are tile indices that may be written directly to OAM.
+    template <size_t Bytes = 0x40000> class sprite_allocator {
+      block_allocator<1024> blocks;
+      int boundary;
+    public:
+      static constexpr int none = -1; ///< Returned when allocation fails
+
+      /// \brief Manage the first \p bytes of the region with the given value
+      /// of DISPCNT tile_obj_1d_boundary
+      explicit sprite_allocator(int boundary, size_t bytes = Bytes)
+        : blocks(bytes >> (5 + boundary)), boundary(boundary) {}
+
+      /// Bytes per tile index unit
+      size_t unit() const { return 32u << boundary; }
+
+      /// Allocate \p bytes of sprite graphics and return the tile index
+      int tiles(size_t bytes) {
+        return blocks.alloc((bytes + unit() - 1) >> (5 + boundary));
+      }
+      void retain(int tile) { blocks.retain(tile); }
+      bool release(int tile) { return blocks.release(tile); }
+
+      /// Byte offset of a tile index within the region
+      size_t offset(int tile) const { return size_t(tile) << (5 + boundary); }
+
+      /// Usage report, in tile index units
+      block_allocator<1024>::stats report() const { return blocks.report(); }
+      void reset() { blocks.reset(); }
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,197 @@
+//-----------------------------------------------------------------------------
+// custard/affine.hpp
+//-----------------------------------------------------------------------------
+// Parameters are compared with the same computation in double precision.
+// The reference uses the q12 sine and cosine of the rotation, so that only
+// the error of the affine arithmetic is measured.
+//-----------------------------------------------------------------------------
+
+#include <custard/affine.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+static uint32_t seed = 1;
+static double uniform(double lo, double hi) {
+  seed = seed * 1103515245 + 12345;
+  return lo + (hi - lo) * (seed >> 8) / double(1 << 24);
+}
+
+static double value(q12 q) { return q.raw() / 4096.0; }
+
+static bool same(vec2<q12> u, vec2<q12> v) {
+  return u.x == v.x && u.y == v.y;
+}
+
+TEST(affine_hardware_formats) {
+  CHECK(to_8_8(q12(1)) == 256);
+  CHECK(to_8_8(q12(-1)) == -256);
+  CHECK(to_8_8(q12::from_raw(8)) == 1 && to_8_8(q12::from_raw(7)) == 0);
+  CHECK(to_8_8(q12(200)) == 32767 && to_8_8(q12(-200)) == -32768);
+  CHECK(to_20_8(q12(-1000)) == -256000);
+  CHECK(to_20_8(q12::from_raw(-9)) == -1);
+}
+
+TEST(affine_shear_is_vertical_then_horizontal) {
+  mat2 h = mat2::shear(vec2<q12>(2, 3));
+  CHECK(h == mat2(7, 2, 3, 1));
+  vec2<q12> v = h * vec2<q12>(1, 0);
+  CHECK(v.x == q12(7) && v.y == q12(3));
+  CHECK(mat2::shear(vec2<q12>(0, 0)) == mat2());
+}
+
+TEST(affine_inverse_matches_double) {
+  double worst = 0;
+  for (int i = 0; i < 2000; ++i) {
+    // Entries from 1/16 to 64 in magnitude, so determinants from tiny to
+    // well beyond 8192
+    double e[4];
+    for (double& x : e) {
+      x = std::exp2(uniform(-4, 6));
+      if (uniform(0, 1) < 0.5) x = -x;
+    }
+    mat2 m = mat2(q12(e[0]), q12(e[1]), q12(e[2]), q12(e[3]));
+    double a = value(m.a), b = value(m.b), c = value(m.c), d = value(m.d);
+    double det = a * d - b * c;
+    if (std::fabs(det) < 1.0 / 64) continue; // entries beyond q12
+    mat2 n = m.inverse();
+    double expected[4] = {d / det, -b / det, -c / det, a / det};
+    double got[4] = {value(n.a), value(n.b), value(n.c), value(n.d)};
+    for (int k = 0; k < 4; ++k)
+      worst = std::fmax(worst, std::fabs(got[k] - expected[k]) * 4096);
+  }
+  CHECK_NEAR(worst, 0, 0.5 + 1e-9); // rounded to nearest
+
+  // The cases q12 reciprocals got wrong
+  mat2 big = mat2::scaling(vec2<q12>(100, 100)).inverse();
+  CHECK(big.a.raw() == 41 && big.d.raw() == 41);
+  mat2 small = mat2::scaling(vec2<q12>(0.1_q12, 0.1_q12)).inverse();
+  CHECK_NEAR(value(small.a), 4096.0 / 410, 0.5 / 4096); // 0.1 is 410 raw
+
+  CHECK(mat2(q12(1), q12(2), q12(2), q12(4)).inverse()
+        == mat2(0, 0, 0, 0));
+  mat2 r = mat2::rotation(5000);
+  mat2 product = r * r.inverse();
+  CHECK_NEAR(value(product.a), 1, 2.0 / 4096);
+  CHECK_NEAR(value(product.b), 0, 2.0 / 4096);
+}
+
+// Parameters of a transform, in double precision: the forward matrix
+// R Hx Hy S is built from the parts and inverted numerically
+struct reference {
+  double m[4], origin[2];
+
+  // (a b; c d) = (a b; c d) (e f; g h)
+  static void multiply(double* a, double e, double f, double g, double h) {
+    double r[4] = {a[0] * e + a[1] * g, a[0] * f + a[1] * h,
+                   a[2] * e + a[3] * g, a[2] * f + a[3] * h};
+    for (int i = 0; i < 4; ++i) a[i] = r[i];
+  }
+
+  explicit reference(transform& t) {
+    double c = value(cos(t.rotation())), s = value(sin(t.rotation()));
+    double f[4] = {c, -s, s, c};
+    multiply(f, 1, value(t.shear().x), 0, 1);
+    multiply(f, 1, 0, value(t.shear().y), 1);
+    multiply(f, value(t.scale().x), 0, 0, value(t.scale().y));
+    double det = f[0] * f[3] - f[1] * f[2];
+    m[0] = f[3] / det;
+    m[1] = -f[1] / det;
+    m[2] = -f[2] / det;
+    m[3] = f[0] / det;
+    double x = value(t.position().x), y = value(t.position().y);
+    origin[0] = value(t.pivot().x) - (m[0] * x + m[1] * y);
+    origin[1] = value(t.pivot().y) - (m[2] * x + m[3] * y);
+  }
+};
+
+// Largest errors in LSBs (2^-12) of the matrix and of the origin, over the
+// parameters well within the q12 range
+static void errors(transform& t, double& matrix, double& origin) {
+  reference r(t);
+  auto worst = [](double& e, q12 got, double exact, double offset) {
+    if (std::fabs(exact) < 1 << 18 && std::fabs(offset) < 1 << 18)
+      e = std::fmax(e, std::fabs(value(got) - exact) * 4096);
+  };
+  const mat2& m = t.matrix();
+  q12 got[4] = {m.a, m.b, m.c, m.d};
+  for (int k = 0; k < 4; ++k) worst(matrix, got[k], r.m[k], 0);
+  vec2<q12> o = t.origin(), p = t.pivot();
+  worst(origin, o.x, r.origin[0], value(p.x) - r.origin[0]);
+  worst(origin, o.y, r.origin[1], value(p.y) - r.origin[1]);
+}
+
+TEST(affine_transform_matches_double) {
+  double matrix = 0, origin = 0;
+  for (int i = 0; i < 2000; ++i) {
+    transform t;
+    t.set_scale(vec2<q12>(q12(std::exp2(uniform(-12, 3))),
+                          q12(std::exp2(uniform(-12, 3)))));
+    t.set_shear(vec2<q12>(q12(uniform(-1, 1)), q12(uniform(-1, 1))));
+    t.set_rotation(angle(uniform(0, turn)));
+    t.set_pivot(vec2<q12>(q12(uniform(0, 512)), q12(uniform(0, 512))));
+    t.set_position(vec2<q12>(q12(uniform(-64, 320)),
+                             q12(uniform(-64, 256))));
+    errors(t, matrix, origin);
+  }
+  CHECK_NEAR(matrix, 0, 1);
+  CHECK_NEAR(origin, 0, 1);
+}
+
+TEST(affine_transform_at_small_scales) {
+  // At a scale of 0.1, a q12 reciprocal put the origin 1.6 pixels out
+  transform t;
+  t.set_scale(vec2<q12>(0.1_q12, 0.1_q12));
+  t.set_pivot(vec2<q12>(64, 64));
+  t.set_position(vec2<q12>(128, 96));
+  double matrix = 0, origin = 0;
+  errors(t, matrix, origin);
+  CHECK_NEAR(matrix, 0, 1);
+  CHECK_NEAR(origin, 0, 1);
+
+  // A zero scale is taken as the smallest, 2^-12, and the result saturates
+  t.set_scale(vec2<q12>(0, 1));
+  CHECK(value(t.matrix().a) == 4096 && value(t.matrix().d) == 1);
+  t.set_rotation(turn / 8);
+  t.set_shear(vec2<q12>(1000, 0));
+  CHECK(t.matrix().a.raw() == INT32_MAX && t.matrix().b.raw() == INT32_MIN);
+}
+
+TEST(affine_transform_updates_lazily) {
+  transform t;
+  CHECK(t.matrix() == mat2() && same(t.origin(), vec2<q12>()));
+  t.set_position(vec2<q12>(10, 20));
+  t.set_pivot(vec2<q12>(5, 5));
+  CHECK(same(t.origin(), vec2<q12>(-5, -15)));
+  t.set_rotation(turn / 4);
+  CHECK(t.matrix() == mat2(0, 1, -1, 0));
+  CHECK(same(t.origin(), vec2<q12>(-15, 15)));
+  // Setting the same values again changes nothing
+  t.set_rotation(turn / 4);
+  t.set_pivot(vec2<q12>(5, 5));
+  CHECK(same(t.origin(), vec2<q12>(-15, 15)));
+}
+
+TEST(affine_writes_registers) {
+  transform t;
+  t.set_scale(vec2<q12>(2, 0.5_q12));
+  t.set_pivot(vec2<q12>(100, 50));
+  t.write(bg_affine_io(3, true));
+  // BG3PA-PD, X and Y of the sub engine
+  CHECK(*host::at<uint32_t>(0x04001030) == 128);
+  CHECK(*host::at<uint32_t>(0x04001034) == 512u << 16);
+  CHECK(*host::at<uint32_t>(0x04001038) == 100 << 8);
+  CHECK(*host::at<uint32_t>(0x0400103c) == 50 << 8);
+
+  display::shadow s(display::main_io());
+  t.write(s, 2);
+  CHECK(s.get32(display::shadow::BG2PA) == 128);
+  CHECK(s.get32(display::shadow::BG2X) == 100 << 8);
+
+  mat2 m[2] = {mat2(), mat2::scaling(vec2<q12>(-1, 0.25_q12))};
+  write_affine(OAM, m, 3, 2);
+  CHECK(OAM[16 * 3 + 3] == 256 && OAM[16 * 3 + 7] == 0);
+  CHECK(OAM[16 * 4 + 3] == uint16_t(-256) && OAM[16 * 4 + 15] == 64);
+  CHECK(OAM[16 * 4 + 11] == 0 && OAM[16 * 2 + 3] == 0);
+}
@@ -0,0 +1,248 @@
+//-----------------------------------------------------------------------------
+// custard/audio.hpp
+//-----------------------------------------------------------------------------
+// The golden samples were decoded by CPython's audioop.adpcm2lin, the
+// reference IMA/DVI decoder, from the same bytes with the nibbles of each
+// byte swapped (WAV files store the first sample in the low nibble). Mixes
+// are compared with interpolating in double precision at exact positions,
+// which is independent of the mixer; a golden file of its output would only
+// record what it produced when the file was made.
+//-----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <vector>
+
+#include <custard/audio.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+// A block of moderate steps, then a few large ones
+static const uint8_t nibbles[40] = {
+  0x82, 0x3a, 0x81, 0x2b, 0x0b, 0xbb, 0xa2, 0xbb, 0x10, 0xb2, 0xb9, 0x9b,
+  0x38, 0x18, 0xa1, 0x83, 0x01, 0xbb, 0x31, 0x9a, 0x12, 0x32, 0x0b, 0x03,
+  0x23, 0x22, 0x83, 0x19, 0xaa, 0x88, 0x3c, 0x59, 0xea, 0x56, 0x13, 0x7b,
+  0xd2, 0x85, 0xa1, 0xd8 };
+// ... decoded from a predictor of -1234 and step index 20
+static const int16_t golden[81] = {
+  -1234, -1203, -1208, -1233, -1202, -1190, -1193, -1217, -1202, -1220,
+  -1218, -1233, -1247, -1237, -1245, -1255, -1265, -1264, -1261, -1256,
+  -1263, -1264, -1268, -1272, -1273, -1273, -1269, -1269, -1268, -1267,
+  -1270, -1266, -1266, -1265, -1265, -1269, -1273, -1272, -1268, -1271,
+  -1272, -1269, -1268, -1265, -1261, -1265, -1265, -1261, -1261, -1257,
+  -1254, -1251, -1248, -1244, -1244, -1245, -1244, -1247, -1250, -1250,
+  -1250, -1257, -1250, -1253, -1245, -1251, -1267, -1240, -1199, -1161,
+  -1146, -1177, -1114, -1069, -1159, -1026, -1043, -995, -1068, -1081,
+  -1214 };
+// Steps that clip at both ends, decoded from 32000 and index 88
+static const uint8_t clip_nibbles[8] = {
+  0x77, 0x77, 0x77, 0x77, 0x77, 0xff, 0xff, 0xff };
+static const int16_t clip_golden[17] = {
+  32000, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+  32767, -28669, -32768, -32768, -32768, -32768, -32768 };
+
+// A 44-byte block: the header, then the nibbles of \p data
+static std::vector<uint8_t> block(int predictor, int index,
+                                  const uint8_t* data, int n) {
+  std::vector<uint8_t> b = {uint8_t(predictor), uint8_t(predictor >> 8),
+                            uint8_t(index), 0};
+  b.insert(b.end(), data, data + n);
+  b.resize(44, 0x88); // -0 steps, which only shrink the step size
+  return b;
+}
+
+static void put(std::vector<uint8_t>& v, uint32_t x, int bytes) {
+  for (int i = 0; i < bytes; ++i) v.push_back(uint8_t(x >> 8 * i));
+}
+
+// A mono IMA-ADPCM WAV file of \p data, whose data chunk claims \p size bytes
+static std::vector<uint8_t> wav(const std::vector<uint8_t>& data,
+                                uint32_t size) {
+  std::vector<uint8_t> f;
+  put(f, 0x46464952, 4); put(f, 0, 4); put(f, 0x45564157, 4);
+  put(f, 0x20746d66, 4); put(f, 20, 4);
+  put(f, audio::ima_adpcm, 2); put(f, 1, 2); put(f, 22050, 4);
+  put(f, 22050 * 44 / 81, 4); put(f, 44, 2); put(f, 4, 2);
+  put(f, 2, 2); put(f, 81, 2);
+  put(f, 0x61746164, 4); put(f, size, 4);
+  f.insert(f.end(), data.begin(), data.end());
+  return f;
+}
+
+TEST(audio_decodes_golden_blocks) {
+  int16_t out[81];
+  auto a = block(-1234, 20, nibbles, 40);
+  CHECK(audio::decode_block(a.data(), 44, out) == 81);
+  bool same = true;
+  for (int i = 0; i < 81; ++i) same &= out[i] == golden[i];
+  CHECK(same);
+
+  // Clipping, and a header index beyond the table treated as its end
+  auto b = block(32000, 200, clip_nibbles, 8);
+  CHECK(audio::decode_block(b.data(), 12, out) == 17);
+  same = true;
+  for (int i = 0; i < 17; ++i) same &= out[i] == clip_golden[i];
+  CHECK(same);
+
+  CHECK(audio::decode_block(a.data(), 3, out) == 0);
+}
+
+TEST(audio_decodes_around_a_ring) {
+  int16_t ring[64] = {};
+  auto a = block(-1234, 20, nibbles, 40);
+  audio::decode_block(a.data(), 24, ring, 50, 63); // 41 samples
+  bool same = true;
+  for (int i = 0; i < 41; ++i) same &= ring[(50 + i) & 63] == golden[i];
+  CHECK(same);
+  CHECK(ring[27] == 0 && ring[49] == 0);
+}
+
+TEST(audio_parses_wav_headers) {
+  auto a = block(-1234, 20, nibbles, 40);
+  std::vector<uint8_t> data = a;
+  data.insert(data.end(), a.begin(), a.end());
+  auto f = wav(data, 88);
+  audio::clip c;
+  CHECK(audio::parse(f.data(), f.size(), c));
+  CHECK(c.encoding == audio::ima_adpcm && c.channels == 1);
+  CHECK(c.rate == 22050 && c.block == 44 && c.bits == 4);
+  CHECK(c.bytes == 88 && c.samples == 162);
+  // A truncated file is cut to the data present
+  CHECK(audio::parse(f.data(), f.size() - 50, c));
+  CHECK(c.bytes == 38 && c.samples == 0);
+  f[8] = 'X';
+  CHECK(!audio::parse(f.data(), f.size(), c));
+}
+
+// Blocks a and b, streamed into a ring of 256 samples
+struct stream_fixture {
+  std::vector<uint8_t> a = block(-1234, 20, nibbles, 40),
+                       b = block(32000, 200, clip_nibbles, 8), file;
+  int16_t expected[2][81];
+  audio::stream<256, 512> s;
+  FILE* f = nullptr;
+
+  stream_fixture(bool loop, uint32_t claimed = 88, size_t present = 88) {
+    std::vector<uint8_t> data = a;
+    data.insert(data.end(), b.begin(), b.end());
+    data.resize(present);
+    file = wav(data, claimed);
+    audio::decode_block(a.data(), 44, expected[0]);
+    audio::decode_block(b.data(), 44, expected[1]);
+    f = fmemopen(file.data(), file.size(), "rb");
+    CHECK(s.open(f, loop));
+  }
+  ~stream_fixture() { std::fclose(f); }
+
+  const int16_t* ring() const {
+    return static_cast<const int16_t*>(s.source().data);
+  }
+  // Does the ring hold block k from sample \p at?
+  bool holds(int k, uint32_t at) const {
+    for (int i = 0; i < 81; ++i)
+      if (ring()[(at + i) % 256] != expected[k][i]) return false;
+    return true;
+  }
+};
+
+TEST(audio_stream_loops) {
+  stream_fixture t(true);
+  CHECK(t.s.rate() == 22050 && t.s.source().samples == 256);
+  // Three blocks fit ahead of the voice at 0
+  CHECK(t.holds(0, 0) && t.holds(1, 81) && t.holds(0, 162));
+  CHECK(!t.s.finished());
+  // Two more once it has reached 200, wrapping around the ring
+  t.s.update(200);
+  CHECK(t.holds(1, 243) && t.holds(0, 324));
+  CHECK(!t.s.finished());
+}
+
+TEST(audio_stream_ends_with_silence) {
+  stream_fixture t(false);
+  CHECK(t.holds(0, 0) && t.holds(1, 81));
+  CHECK(t.s.finished());
+  bool silent = true;
+  for (int i = 162; i < 255; ++i) silent &= t.ring()[i] == 0;
+  CHECK(silent);
+}
+
+TEST(audio_stream_without_blocks_ends) {
+  // These rewound forever when looping
+  stream_fixture empty(true, 0, 0);
+  CHECK(empty.s.finished());
+  stream_fixture truncated(true, 88, 20);
+  CHECK(truncated.s.finished());
+  // A partial last block is dropped
+  stream_fixture partial(true, 88, 70);
+  CHECK(partial.holds(0, 0) && partial.holds(0, 81));
+  CHECK(!partial.s.finished());
+}
+
+// Output sample k of a voice, in double precision, from the exact position
+// k rate / out_rate less \p lag samples
+static double reference(const audio::clip& c, int k, int out_rate,
+                        bool loop, uint32_t loop_start, double lag = 0) {
+  double p = std::fmax(double(k) * c.rate / out_rate - lag, 0);
+  if (p >= c.samples) {
+    if (!loop) return 0;
+    p = loop_start + std::fmod(p - c.samples, double(c.samples - loop_start));
+  }
+  uint32_t i = uint32_t(p);
+  uint32_t j = i + 1 < c.samples ? i + 1 : loop ? loop_start : i;
+  auto sample = [&](uint32_t n) {
+    if (c.bits == 8)
+      return (static_cast<const uint8_t*>(c.data)[n] - 128) * 256.0;
+    return double(static_cast<const int16_t*>(c.data)[n]);
+  };
+  return sample(i) + (sample(j) - sample(i)) * (p - i);
+}
+
+TEST(audio_mixes_like_double_precision) {
+  int16_t wave16[100];
+  uint8_t wave8[50];
+  for (int i = 0; i < 100; ++i) wave16[i] = int16_t(i * 617 % 20000 - 10000);
+  for (int i = 0; i < 50; ++i) wave8[i] = uint8_t(i * 37 % 200 + 28);
+  // Rates whose steps aren't whole in 20.12: 2756.25 and 5512.5
+  audio::clip a = {wave16, 200, 100, 22050, 1, 16, audio::pcm, 2};
+  audio::clip b = {wave8, 50, 50, 44100, 1, 8, audio::pcm, 1};
+
+  audio::mixer<4, 64> m(32768);
+  int va = m.play(a, 100, 30), vb = m.play(b, 128, 127, true, 10);
+  CHECK(va == 0 && vb == 1);
+  // Long enough for a truncated step to have drifted by many samples
+  static int16_t left[40000], right[40000];
+  m.mix(left, right, 40000);
+  CHECK(!m.playing(va) && m.playing(vb));
+
+  // Gains are 8-bit fractions of volume and pan, as documented
+  double la = 100 * (127 - 30) >> 6, ra = 100 * 30 >> 6;
+  double lb = 0, rb = 128 * 127 >> 6;
+  // Positions are rounded down to 1/4096 of a sample, as documented, so the
+  // error allowed is 2 LSB beyond what that lag changes
+  double error = 0;
+  for (int k = 0; k < 40000; ++k) {
+    double x = reference(a, k, 32768, false, 0);
+    double y = reference(b, k, 32768, true, 10);
+    double dx = std::fabs(x - reference(a, k, 32768, false, 0, 1.0 / 4096));
+    double dy = std::fabs(y - reference(b, k, 32768, true, 10, 1.0 / 4096));
+    double l = std::fabs(left[k] - (x * la + y * lb) / 256);
+    double r = std::fabs(right[k] - (x * ra + y * rb) / 256);
+    error = std::fmax(error, l - (dx * la + dy * lb) / 256);
+    error = std::fmax(error, r - (dx * ra + dy * rb) / 256);
+  }
+  CHECK_NEAR(error, 0, 2);
+}
+
+TEST(audio_mix_saturates) {
+  int16_t loud[4] = {30000, 30000, -30000, -30000};
+  audio::clip c = {loud, 8, 4, 32768, 1, 16, audio::pcm, 2};
+  typedef audio::mixer<4, 64> mixer;
+  mixer m(32768);
+  for (int i = 0; i < 3; ++i) m.play(c, 128, 64, true);
+  int16_t left[8], right[8];
+  m.mix(left, right, 8);
+  CHECK(left[0] == 32767 && right[1] == 32767);
+  CHECK(left[2] == -32768 && right[3] == -32768);
+  CHECK(m.play(c) == 3 && m.play(c) == mixer::none);
+}
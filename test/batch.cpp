@@ -0,0 +1,82 @@
+//-----------------------------------------------------------------------------
+// custard/batch.hpp
+//-----------------------------------------------------------------------------
+// Each kernel is compared with the per-element vec2 loop it replaces, at
+// sizes that exercise both the unrolled loop and the remainder.
+//-----------------------------------------------------------------------------
+
+#include <custard/batch.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+static const size_t sizes[] = {1, 3, 4, 5, 8, 37, 64};
+
+template <class T> static vec2<T> point(size_t i) {
+  return vec2<T>(T(int(i * 37 % 101) - 50), T(int(i * 53 % 89) - 44));
+}
+template <class T> static bool same(vec2<T> a, vec2<T> b) {
+  return a.x == b.x && a.y == b.y;
+}
+
+TEST(vec2_array_push_and_erase) {
+  vec2_array<int, 4> a;
+  CHECK(a.empty());
+  for (int i = 0; i < 4; ++i) a.push_back(ivec2(i, -i));
+  CHECK(a.full() && a.size() == 4);
+  a.erase(1);
+  CHECK(a.size() == 3 && a[1].x == 3 && a[1].y == -3);
+  CHECK(reinterpret_cast<uintptr_t>(a.x) % 32 == 0);
+  CHECK(reinterpret_cast<uintptr_t>(a.y) % 32 == 0);
+}
+
+TEST(batch_integrate_matches_vec2_loop) {
+  for (size_t n : sizes) {
+    vec2_array<q12, 64> p, v;
+    vec2<q12> expected[64];
+    for (size_t i = 0; i < n; ++i) {
+      p.push_back(point<q12>(i));
+      v.push_back(point<q12>(i + 7) * 0.125_q12);
+      expected[i] = p[i] + v[i] * 0.0166_q12;
+    }
+    batch::integrate(p, v, 0.0166_q12);
+    for (size_t i = 0; i < n; ++i) CHECK(same(p[i], expected[i]));
+  }
+}
+
+TEST(batch_transform_matches_vec2_loop) {
+  q12 a = 0.866_q12, b = -0.5_q12, c = 0.5_q12, d = 0.866_q12;
+  vec2<q12> t(3, -2);
+  for (size_t n : sizes) {
+    vec2_array<q12, 64> p;
+    vec2<q12> expected[64];
+    for (size_t i = 0; i < n; ++i) {
+      vec2<q12> v = point<q12>(i);
+      p.push_back(v);
+      expected[i] = vec2<q12>(a * v.x + b * v.y, c * v.x + d * v.y) + t;
+    }
+    batch::transform(p, a, b, c, d, t);
+    for (size_t i = 0; i < n; ++i) CHECK(same(p[i], expected[i]));
+  }
+}
+
+TEST(batch_clamp_and_bounds_match_vec2_loop) {
+  for (size_t n : sizes) {
+    vec2_array<int, 64> p {};
+    ivec2 lo(-20, -10), hi(15, 30), expected[64];
+    ivec2 min = point<int>(0), max = point<int>(0);
+    for (size_t i = 0; i < n; ++i) {
+      ivec2 v = point<int>(i);
+      p.push_back(v);
+      min = min.min(v);
+      max = max.max(v);
+      expected[i] = v.max(lo).min(hi);
+    }
+    ivec2 blo, bhi;
+    batch::bounds(p, blo, bhi);
+    CHECK(same(blo, min) && same(bhi, max));
+    batch::clamp(p, lo, hi);
+    for (size_t i = 0; i < n; ++i) CHECK(same(p[i], expected[i]));
+  }
+}
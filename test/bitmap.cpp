@@ -0,0 +1,84 @@
+//-----------------------------------------------------------------------------
+// custard/bitmap.hpp
+//-----------------------------------------------------------------------------
+// The row loops are checked against pixel-by-pixel drawing at every
+// alignment of source and destination, and with clipping on every side.
+//-----------------------------------------------------------------------------
+
+#include <custard/bitmap.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+alignas(4) static uint16_t surface[256 * 192], expected[256 * 192];
+alignas(4) static uint16_t art[40 * 30];
+
+static bool same() {
+  for (int i = 0; i < 256 * 192; ++i)
+    if (surface[i] != expected[i]) return false;
+  return true;
+}
+
+static void reset() {
+  for (int i = 0; i < 256 * 192; ++i) surface[i] = expected[i] = uint16_t(i);
+  for (int i = 0; i < 40 * 30; ++i) art[i] = uint16_t(i * 7 % 11 ? i : 0x1f);
+}
+
+static const int xs[] = {-45, -10, -1, 0, 1, 2, 3, 100, 101, 217, 250};
+static const int ys[] = {-40, -3, 0, 80, 170, 191};
+
+TEST(bitmap_fill_and_tint_match_pixels) {
+  for (int x : xs) for (int y : ys) {
+    reset();
+    bitmap::canvas c(surface);
+    c.fill(x, y, 37, 25, 0x1234);
+    c.tint(x + 3, y + 1, 20, 20, 0x7c00, 9);
+    for (int j = 0; j < 25; ++j) for (int i = 0; i < 37; ++i) {
+      int px = x + i, py = y + j;
+      if (unsigned(px) < 256 && unsigned(py) < 192)
+        expected[py * 256 + px] = 0x1234;
+    }
+    for (int j = 0; j < 20; ++j) for (int i = 0; i < 20; ++i) {
+      int px = x + 3 + i, py = y + 1 + j;
+      if (unsigned(px) < 256 && unsigned(py) < 192) {
+        uint16_t& e = expected[py * 256 + px];
+        e = bitmap::blend(e, 0x7c00, 9);
+      }
+    }
+    CHECK(same());
+  }
+}
+
+TEST(bitmap_blits_match_pixels) {
+  for (int key = 0; key < 3; ++key)
+    for (int sx = 0; sx < 2; ++sx)
+      for (int x : xs) for (int y : ys) {
+        reset();
+        bitmap::canvas c(surface);
+        bitmap::image src = bitmap::image{art, 40, 30, 40}.sub(sx, 1, 33, 27);
+        if (key == 0) c.blit(src, x, y);
+        else if (key == 1) c.blit(src, x, y, 0x1f);
+        else c.blend(src, x, y, 20);
+        for (int j = 0; j < 27; ++j) for (int i = 0; i < 33; ++i) {
+          int px = x + i, py = y + j;
+          if (unsigned(px) >= 256 || unsigned(py) >= 192) continue;
+          uint16_t s = src.pixels[j * 40 + i];
+          uint16_t& e = expected[py * 256 + px];
+          if (key == 2) e = bitmap::blend(e, s, 20);
+          else if (key == 0 || s != 0x1f) e = s;
+        }
+        CHECK(same());
+      }
+}
+
+TEST(bitmap_line_endpoints_and_clipping) {
+  reset();
+  bitmap::canvas c(surface);
+  c.line(10, 10, 20, 15, 1);
+  CHECK(c.get(10, 10) == 1 && c.get(20, 15) == 1);
+  c.line(-50, 100, 300, 120, 2);     // crosses the surface
+  CHECK(c.get(0, 103) == 2 && c.get(255, 117) == 2);
+  c.line(5, 3, -5, 3, 3);            // horizontal, clipped
+  CHECK(c.get(0, 3) == 3 && c.get(5, 3) == 3 && c.get(6, 3) != 3);
+}
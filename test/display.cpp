@@ -0,0 +1,280 @@
+//-----------------------------------------------------------------------------
+// custard/display.hpp
+//-----------------------------------------------------------------------------
+
+#include <custard/display.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+using display::shadow;
+
+TEST(display_shadow_writes_only_in_commit) {
+  shadow s(display::main_io());
+  s.set32(shadow::DISPCNT, 0x10100);
+  s.bg_scroll(2, 300, 5);
+  CHECK(REG_DISPCNT == 0);
+  CHECK(s.commit() == 0);            // nothing presented yet
+  s.present();
+  CHECK(REG_DISPCNT == 0);
+  CHECK(s.commit() == 2);
+  CHECK(REG_DISPCNT == 0x10100);
+  CHECK(*host::at<uint16_t>(0x04000018) == 300);
+  CHECK(*host::at<uint16_t>(0x0400001a) == 5);
+  CHECK(s.commit() == 0);
+}
+
+TEST(display_shadow_16_bit_halves) {
+  shadow s(display::sub_io());
+  s.bg_control(1, 0x1234);
+  s.bg_control(0, 0x5678);
+  CHECK(s.get16(shadow::BG1CNT) == 0x1234);
+  CHECK(s.get32(shadow::BG0CNT) == 0x12345678);
+  CHECK(s.dirty() == 1u << 2);
+  s.blend(0x3f41, 0x0808, 16);
+  s.present();
+  CHECK(s.commit() == 3);
+  CHECK(*host::at<uint32_t>(0x04001008) == 0x12345678);
+  CHECK(*host::at<uint32_t>(0x04001050) == 0x08083f41);
+  CHECK(*host::at<uint16_t>(0x04001054) == 16);
+}
+
+TEST(display_shadow_skips_unchanged_words) {
+  uint32_t io[shadow::words] = {};
+  shadow s(io);
+  s.set16(shadow::MOSAIC, 0);        // same as the back buffer
+  CHECK(s.dirty() == 0);
+  s.set16(shadow::MOSAIC, 0x11);
+  s.set16(shadow::MOSAIC, 0);        // changed and changed back
+  s.present();
+  CHECK(s.commit() == 1);
+  s.invalidate();
+  CHECK(!(s.dirty() & 2));           // DISPSTAT/VCOUNT is never written
+  s.present();
+  CHECK(s.commit() == shadow::words - 1);
+}
+
+TEST(display_shadow_present_accumulates) {
+  uint32_t io[shadow::words] = {};
+  shadow s(io);
+  s.bg_scroll(0, 1, 2);
+  s.present();
+  s.bg_scroll(0, 3, 4);              // a later frame before the commit
+  s.bg_scroll(3, 5, 6);
+  s.present();
+  CHECK(s.commit() == 2);
+  CHECK(io[shadow::BG0HOFS >> 2] == (3 | 4 << 16));
+  CHECK(io[shadow::BG3HOFS >> 2] == (5 | 6 << 16));
+}
+
+static shadow* vblank_shadow;
+static int vblank_words;
+
+TEST(display_shadow_present_is_not_interrupted) {
+  uint32_t io[shadow::words] = {};
+  shadow s(io);
+  for (int bg = 0; bg < 4; ++bg) s.bg_scroll(bg, bg, 1);
+  s.present();
+  s.commit();
+  // The vertical blank interrupt is raised after two words are presented
+  vblank_shadow = &s;
+  host::irq = [] { vblank_words = vblank_shadow->commit(); };
+  host::irq_after = 2;
+  REG_IME = 1;
+  for (int bg = 0; bg < 4; ++bg) s.bg_scroll(bg, bg, 2);
+  s.present();
+  // ...and is delivered when present() enables interrupts again
+  CHECK(vblank_words == 4 && REG_IME == 1);
+  bool all = true;
+  for (int bg = 0; bg < 4; ++bg)
+    all &= io[(shadow::BG0HOFS >> 2) + bg] == uint32_t(bg | 2 << 16);
+  CHECK(all && s.commit() == 0);
+}
+
+// Presets
+//-----------------------------------------------------------------------------
+
+using display::preset;
+using display::engine;
+using display::error;
+using vram::bank;
+using vram::region;
+
+// Every memory the presets can use on either engine
+typedef vram::plan<
+  vram::map<bank::A, region::main_bg, 0>,
+  vram::map<bank::B, region::main_bg, 1>,
+  vram::map<bank::C, region::main_bg, 2>,
+  vram::map<bank::D, region::main_bg, 3>,
+  vram::map<bank::E, region::main_sprite>,
+  vram::map<bank::F, region::main_bg_ext_palette, 0>,
+  vram::map<bank::G, region::main_sprite_ext_palette>,
+  vram::map<bank::H, region::sub_bg>,
+  vram::map<bank::I, region::sub_sprite>> full_vram;
+// 128K of main BG and nothing else
+typedef vram::plan<vram::map<bank::A, region::main_bg, 0>> small_vram;
+// A frame buffer in bank C
+typedef vram::plan<vram::map<bank::C, region::lcdc>> lcdc_vram;
+typedef vram::plan<> no_vram;
+
+// The presets compile to the constants the runtime overlays produce
+constexpr auto title = preset::graphics_TTTE().bg(0).bg(3).obj()
+  .obj_tiles_1d(64).ext_palettes(true);
+static_assert(title.mask() == 0x40111913);
+static_assert(display::check<full_vram>(engine::main, title.mask())
+              == error::none);
+static_assert(display::main_mode<title.mask(), full_vram>::status
+              == error::none);
+
+// The 2D modes, usable on both engines, then the main engine's own
+static const struct {
+  preset (*make)();
+  void (display::main_config::*set)();
+} modes[] = {
+  {preset::graphics_TTTT, &display::main_config::graphics_TTTT},
+  {preset::graphics_TTTA, &display::main_config::graphics_TTTA},
+  {preset::graphics_TTAA, &display::main_config::graphics_TTAA},
+  {preset::graphics_TTTE, &display::main_config::graphics_TTTE},
+  {preset::graphics_TTAE, &display::main_config::graphics_TTAE},
+  {preset::graphics_TTEE, &display::main_config::graphics_TTEE},
+  {preset::graphics_Bmp, &display::main_config::graphics_Bmp},
+  {preset::graphics_3dTTT, &display::main_config::graphics_3dTTT},
+  {preset::graphics_3dTTA, &display::main_config::graphics_3dTTA},
+  {preset::graphics_3dTAA, &display::main_config::graphics_3dTAA},
+  {preset::graphics_3dTTE, &display::main_config::graphics_3dTTE},
+  {preset::graphics_3dTAE, &display::main_config::graphics_3dTAE},
+  {preset::graphics_3dTEE, &display::main_config::graphics_3dTEE},
+  {preset::graphics_3dBmp, &display::main_config::graphics_3dBmp}};
+
+TEST(display_presets_match_config) {
+  int wrong = 0;
+  for (auto& m : modes)
+    for (int bgs = 0; bgs < 16; ++bgs) {
+      preset p = m.make();
+      display::main_config c {};
+      (c.*m.set)();
+      for (int n = 0; n < 4; ++n)
+        if (bgs >> n & 1) p = p.bg(n);
+      c.bg0_enable = bgs & 1;
+      c.bg1_enable = bgs >> 1 & 1;
+      c.bg2_enable = bgs >> 2 & 1;
+      c.bg3_enable = bgs >> 3 & 1;
+      c.obj_enable = true;
+      wrong += p.obj().mask() != c.mask;
+    }
+  CHECK(wrong == 0);
+
+  display::config c {};
+  c.graphics_TTAA();
+  c.tile_obj_mapping = 1;
+  c.tile_obj_1d_boundary = 3;
+  c.bmp_obj_mapping = 1;
+  c.bmp_obj_1d_boundary = 1;
+  c.window_1_enable = c.obj_window_enable = true;
+  c.obj_ext_palettes = true;
+  c.hblank_oam_access = c.forced_blank = true;
+  CHECK(preset::graphics_TTAA().obj_tiles_1d(256).obj_bitmaps_1d(256)
+        .windows(false, true, true).ext_palettes(false, true).hblank_oam()
+        .blank().mask() == c.mask);
+
+  display::main_config m {};
+  m.graphics_3dTTE();
+  m.char_base = 5;
+  m.screen_base = 2;
+  m.bmp_obj_2d_dimension = 1;
+  CHECK(preset::graphics_3dTTE().bases(1, 1).bases(5, 2).obj_bitmaps_2d(256)
+        .mask() == m.mask);
+}
+
+TEST(display_presets_enumerate) {
+  int wrong = 0;
+  for (int i = 0; i < 14; ++i) {
+    bool main_only = i >= 6, three_d = i >= 7;
+    for (int bgs = 0; bgs < 16; ++bgs)
+      for (int obj = 0; obj < 2; ++obj) {
+        preset p = modes[i].make();
+        for (int n = 0; n < 4; ++n)
+          if (bgs >> n & 1) p = p.bg(n);
+        if (obj) p = p.obj().obj_tiles_1d(128);
+        uint32_t mask = p.mask();
+        // BG0 shows the 3D engine's output, which needs no BG VRAM
+        bool shown = bgs & (three_d ? 0xe : 0xf);
+
+        error expected = main_only ? error::main_only : error::none;
+        wrong += display::check<full_vram>(engine::sub, mask) != expected;
+        wrong += display::check<full_vram>(engine::main, mask)
+                 != error::none;
+
+        expected = shown ? error::no_bg_memory
+                 : obj ? error::no_sprite_memory : error::none;
+        wrong += display::check<no_vram>(engine::main, mask) != expected;
+
+        expected = (i == 6 || i == 13) && bgs & 4 ? error::no_large_bitmap
+                 : obj ? error::no_sprite_memory : error::none;
+        wrong += display::check<small_vram>(engine::main, mask) != expected;
+      }
+  }
+  CHECK(wrong == 0);
+}
+
+TEST(display_presets_frame_buffers) {
+  const uint32_t masks[] = {preset::frame_buffer<bank::A>().mask(),
+                            preset::frame_buffer<bank::B>().mask(),
+                            preset::frame_buffer<bank::C>().mask(),
+                            preset::frame_buffer<bank::D>().mask()};
+  for (int i = 0; i < 4; ++i) {
+    bank b = bank(i);
+    uint32_t mask = masks[i];
+    CHECK(mask == (2u << 16 | uint32_t(b) << 18));
+    CHECK(display::check<lcdc_vram>(engine::main, mask)
+          == (b == bank::C ? error::none : error::frame_buffer_bank));
+    CHECK(display::check<lcdc_vram>(engine::sub, mask) == error::main_only);
+  }
+  // Nothing else is shown, so no other memory is needed
+  CHECK(display::check<lcdc_vram>(engine::main,
+                                  preset::frame_buffer<bank::C>().bg(0).obj()
+                                  .mask()) == error::none);
+}
+
+TEST(display_check_reports_each_error) {
+  const struct { engine e; uint32_t mask; error expected; } cases[] = {
+    {engine::sub, preset::graphics_TTTT().bases(1, 0).mask(),
+     error::main_only},
+    {engine::sub, preset::frame_buffer<bank::A>().mask(), error::main_only},
+    {engine::sub, preset::graphics_TTTT().bg(1).mask(),
+     error::no_bg_memory},
+    {engine::main, preset::graphics_Bmp().bg(2).mask(),
+     error::no_large_bitmap},
+    {engine::sub, preset::graphics_TTTT().obj().mask(),
+     error::no_sprite_memory},
+    {engine::sub, preset::graphics_TTTT().ext_palettes(true).mask(),
+     error::no_bg_ext_palette},
+    {engine::sub, preset::graphics_TTTT().ext_palettes(false, true).mask(),
+     error::no_obj_ext_palette},
+    {engine::main, preset::frame_buffer<bank::D>().mask(),
+     error::frame_buffer_bank},
+    {engine::main, preset(1 << 16 | 1 << 20).mask(),
+     error::tile_obj_boundary},
+    {engine::main, preset(1 << 16 | 1 << 22).mask(),
+     error::bmp_obj_boundary},
+    {engine::main, preset(1 << 16 | 0x60).mask(), error::bmp_obj_width},
+    // Switching mapping clears the other mapping's settings
+    {engine::main, preset::graphics_TTTT().obj_tiles_1d(256).obj_tiles_2d()
+                     .mask(), error::none},
+    {engine::main, preset::graphics_TTTT().obj_bitmaps_1d(256)
+                     .obj_bitmaps_2d(256).mask(), error::none},
+    {engine::main, preset::graphics_TTTT().obj_bitmaps_2d(256)
+                     .obj_bitmaps_1d().mask(), error::none}};
+  for (auto& c : cases)
+    CHECK(display::check<small_vram>(c.e, c.mask) == c.expected);
+}
+
+TEST(display_mode_applies_one_value) {
+  typedef display::main_mode<title.mask(), full_vram> main;
+  typedef display::sub_mode<preset::graphics_TTTT().bg(0).obj().mask(),
+                            full_vram> sub;
+  main::apply();
+  CHECK(REG_DISPCNT == title.mask() && REG_DISPCNT_SUB == 0);
+  sub::apply();
+  CHECK(REG_DISPCNT_SUB == 0x11100);
+}
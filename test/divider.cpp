@@ -0,0 +1,53 @@
+//-----------------------------------------------------------------------------
+// custard/divider.hpp
+//-----------------------------------------------------------------------------
+
+#include <custard/divider.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+TEST(divider_split_phase) {
+  auto d = divider::start(q12(-7), q12(2));
+  CHECK(!d.busy());
+  CHECK(d.result() == q12(-3.5));
+  CHECK(REG_DIVCNT == DIV_64_32);
+  CHECK(divider::start(q16(1), q16(3)).result() == q16::from_raw(21845));
+}
+
+TEST(divider_matches_operator) {
+  for (int32_t a = -100000; a <= 100000; a += 997)
+    for (int32_t b = -5000; b <= 5000; b += 331) {
+      if (!b) continue;
+      q12 x = q12::from_raw(a), y = q12::from_raw(b);
+      CHECK(divider::start(x, y).result() == x / y);
+    }
+}
+
+TEST(divider_batch) {
+  q12 num[100], den[100], out[100];
+  for (int i = 0; i < 100; ++i) {
+    num[i] = q12(i - 50) * 1.5_q12;
+    den[i] = q12(i % 7 + 1) * (i & 1 ? -0.25_q12 : 1.75_q12);
+  }
+  divider::divide(num, den, out, 100);
+  for (int i = 0; i < 100; ++i) CHECK(out[i] == num[i] / den[i]);
+  divider::divide(num, den, out, 0);
+}
+
+TEST(divider_batch_in_place) {
+  q12 num[10], den[10], expected[10];
+  for (int i = 0; i < 10; ++i) {
+    num[i] = q12(i * 3 + 1);
+    den[i] = q12(i + 2);
+    expected[i] = num[i] / den[i];
+  }
+  divider::divide(num, den, num, 10);
+  for (int i = 0; i < 10; ++i) CHECK(num[i] == expected[i]);
+}
+
+TEST(divider_by_zero_gives_hardware_result) {
+  CHECK(divider::start(q12(5), q12(0)).result().raw() == -1);
+  CHECK(divider::start(q12(-5), q12(0)).result().raw() == 1);
+}
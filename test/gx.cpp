@@ -0,0 +1,81 @@
+//-----------------------------------------------------------------------------
+// custard/gx.hpp
+//-----------------------------------------------------------------------------
+
+#include <custard/gx.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+static_assert(gx::parameters(gx::END_VTXS) == 0);
+static_assert(gx::parameters(gx::MTX_LOAD_4x3) == 12);
+static_assert(gx::parameters(gx::SHININESS) == 32);
+static_assert(gx::_ten(-1, 0, 1) == (0x3ff | 1u << 20));
+
+TEST(gx_packs_four_commands_per_header) {
+  uint32_t buffer[16];
+  gx::list l(buffer, 16);
+  l.begin(gx::triangles);
+  l.color(0x7fff);
+  l.vertex(vec3<q12>(q12(1), q12(-1), q12(0.5_q12)));
+  l.end();
+  l.push();                          // starts a second header
+  l.color(0x001f);
+  CHECK(l.ok() && l.size() == 7);
+  CHECK(buffer[0] == 0x41232040);    // first command in the low byte
+  CHECK(buffer[1] == gx::triangles);
+  CHECK(buffer[2] == 0x7fff);
+  CHECK(buffer[3] == 0xf0001000 && buffer[4] == 0x0800);
+  CHECK(buffer[5] == 0x00002011);    // unused slots are NOPs
+  CHECK(buffer[6] == 0x001f);
+}
+
+TEST(gx_parameter_formats) {
+  uint32_t b[32];
+  gx::list l(b, 32);
+  l.normal(vec3<q12>(q12(1), q12(-1), q12(0)));   // 1.0.9, +1 saturates
+  l.texcoord(vec2<q12>(q12(2), 0.5_q12));         // 12.4
+  l.vertex10(vec3<q12>(q12(1), q12(-1), 0.25_q12)); // 4.6
+  l.viewport(0, 0, 255, 191);
+  CHECK(b[0] == 0x60242221);
+  CHECK(b[1] == (511 | 0x200u << 10));
+  CHECK(b[2] == (32 | 8u << 16));
+  CHECK(b[3] == (64 | 0x3c0u << 10 | 16u << 20));
+  CHECK(b[4] == 0xbfff0000);
+  l.clear();
+  l.translate(vec3<q12>(q12(2), q12(0), q12(-2)));
+  l.matrix_mode(gx::position);
+  CHECK(b[0] == 0x101c && b[1] == 0x2000 && b[3] == uint32_t(-0x2000));
+  CHECK(b[4] == gx::position && l.size() == 5);
+}
+
+TEST(gx_drops_commands_that_do_not_fit) {
+  uint32_t b[5];
+  gx::list l(b, 5);
+  l.begin(gx::quads);
+  l.vertex(vec3<q12>());
+  l.vertex(vec3<q12>());             // needs 2 words, 1 left
+  CHECK(!l.ok() && l.size() == 4);
+  l.end();                           // fits, but the list stops at a drop
+  CHECK(l.size() == 4 && b[0] == 0x2340);
+  l.clear();
+  CHECK(l.ok() && l.size() == 0);
+  gx::list none(nullptr, 100);
+  none.identity();
+  CHECK(!none.ok() && none.size() == 0);
+}
+
+TEST(gx_list_from_arena_and_submit) {
+  alignas(8) uint8_t memory[64];
+  arena a(memory, sizeof(memory));
+  gx::list l(a, 8);
+  CHECK(a.used() == 32);
+  l.identity();
+  l.swap_buffers(1);
+  l.submit();
+  CHECK(GFX_FIFO == 1);              // the host writes each word in turn
+  gx::list big(a, 100);              // too large for the arena
+  big.identity();
+  CHECK(!big.ok());
+}
@@ -0,0 +1,123 @@
+//-----------------------------------------------------------------------------
+// custard/host.hpp
+//-----------------------------------------------------------------------------
+
+#include <custard/host.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+TEST(host_maps_each_region) {
+  CHECK(host::at<uint8_t>(0x04000000) == host::io);
+  CHECK(host::at<uint8_t>(0x050007ff) == host::palette + 0x7ff);
+  CHECK(host::at<uint8_t>(0x06000000) == host::bg);
+  CHECK(host::at<uint8_t>(0x06200000) == host::bg_sub);
+  CHECK(host::at<uint8_t>(0x06400000) == host::obj);
+  CHECK(host::at<uint8_t>(0x06600000) == host::obj_sub);
+  CHECK(host::at<uint8_t>(0x068a3fff) == host::lcdc + 0xa3fff);
+  CHECK(host::at<uint8_t>(0x07000400) == host::oam + 0x400);
+  CHECK(!host::at<uint8_t>(0x02000000));
+  CHECK(!host::at<uint8_t>(0x06080000));
+}
+
+TEST(host_registers_read_back) {
+  REG_DISPCNT = 0x12345678;
+  VRAM_B_CR = 0x81;
+  CHECK(REG_DISPCNT == 0x12345678);
+  CHECK(VRAM_CR == 0x8100);
+  CHECK(host::io[0] == 0x78);
+  BG_PALETTE[3] = 0x7fff;
+  CHECK(*host::at<uint16_t>(0x05000006) == 0x7fff);
+}
+
+TEST(host_divider_computes_on_read) {
+  REG_DIVCNT = DIV_64_32;
+  REG_DIV_NUMER = -(int64_t(7) << 32);
+  REG_DIV_DENOM_L = 1 << 20;
+  CHECK(!(REG_DIVCNT & DIV_BUSY));
+  CHECK(REG_DIV_RESULT_L == -7 * (1 << 12));
+  REG_DIV_DENOM_L = 0;
+  CHECK(REG_DIV_RESULT_L == 1);
+  REG_DIV_NUMER = 5;
+  CHECK(REG_DIV_RESULT_L == -1);
+}
+
+TEST(host_reset_clears_memory) {
+  REG_DISPCNT = 1;
+  VRAM_A[10] = 2;
+  OAM[0] = 3;
+  host::reset();
+  CHECK(REG_DISPCNT == 0);
+  CHECK(VRAM_A[10] == 0);
+  CHECK(OAM[0] == 0);
+}
+
+TEST(host_dma_copies_when_polled) {
+  uint32_t src[4] = {1, 2, 3, 4};
+  DMA_SRC(1) = uintptr_t(src);
+  DMA_DEST(1) = uintptr_t(VRAM_A);
+  REG_VCOUNT = 200;
+  DMA_CR(1) = DMA_ENABLE | DMA_32_BIT | DMA_SRC_INC | DMA_DST_INC | 4;
+  CHECK(host::dma[1].transfers == 0);   // not yet polled
+  CHECK(!(DMA_CR(1) & DMA_BUSY));
+  CHECK(host::dma[1].transfers == 1 && host::dma[1].units == 4);
+  CHECK(host::dma[1].words && host::dma[1].vcount == 200);
+  CHECK(*host::at<uint32_t>(0x0680000c) == 4);
+
+  // 16-bit, from a fixed source to a decreasing destination
+  uint16_t fill = 0x1234;
+  DMA_SRC(2) = uintptr_t(&fill);
+  DMA_DEST(2) = uintptr_t(VRAM_B + 3);
+  DMA_CR(2) = DMA_ENABLE | DMA_16_BIT | DMA_SRC_FIX | DMA_DST_DEC | 3;
+  while (DMA_CR(2) & DMA_BUSY);
+  CHECK(VRAM_B[0] == 0 && VRAM_B[1] == 0x1234 && VRAM_B[3] == 0x1234);
+  CHECK(VRAM_B[4] == 0);
+
+  // Transfers started by vertical blanking are not emulated
+  DMA_SRC(3) = uintptr_t(src);
+  DMA_DEST(3) = uintptr_t(VRAM_C);
+  DMA_CR(3) = DMA_ENABLE | DMA_START_VBL | DMA_REPEAT | 4;
+  CHECK(DMA_CR(3) & DMA_BUSY);
+  host::hblank();
+  CHECK(host::dma[3].transfers == 0 && VRAM_C[0] == 0);
+  host::reset();
+  CHECK(!(DMA_CR(3) & DMA_BUSY));
+}
+
+TEST(host_dma_repeats_in_hblank) {
+  uint16_t table[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  DMA_SRC(0) = uintptr_t(table);
+  DMA_DEST(0) = uintptr_t(VRAM_A);
+  DMA_CR(0) = DMA_ENABLE | DMA_START_HBL | DMA_REPEAT | DMA_16_BIT
+    | DMA_SRC_INC | DMA_DST_RESET | 2;
+  CHECK(host::dma[0].transfers == 0);
+  // Each line's transfer continues the source and reloads the destination
+  for (int y = 0; y < 3; ++y) {
+    REG_VCOUNT = uint16_t(y);
+    host::hblank();
+    CHECK(VRAM_A[0] == 2 * y + 1 && VRAM_A[1] == 2 * y + 2);
+    CHECK(host::dma[0].vcount == y && VRAM_A[2] == 0);
+  }
+  // None in vertical blanking
+  REG_VCOUNT = 192;
+  host::hblank();
+  CHECK(host::dma[0].transfers == 3 && (DMA_CR(0) & DMA_BUSY));
+
+  // Disabling the channel makes it start again from DMA_SRC
+  DMA_CR(0) = 0;
+  DMA_CR(0) = DMA_ENABLE | DMA_START_HBL | DMA_REPEAT | DMA_16_BIT
+    | DMA_SRC_INC | DMA_DST_RESET | 2;
+  REG_VCOUNT = 0;
+  host::hblank();
+  CHECK(VRAM_A[0] == 1 && host::dma[0].transfers == 4);
+
+  // A transfer that does not repeat ends after one line
+  DMA_SRC(1) = uintptr_t(table + 4);
+  DMA_DEST(1) = uintptr_t(VRAM_B);
+  DMA_CR(1) = DMA_ENABLE | DMA_START_HBL | DMA_16_BIT | 4;
+  host::hblank();
+  host::hblank();
+  CHECK(host::dma[1].transfers == 1 && VRAM_B[3] == 8);
+  CHECK(!(DMA_CR(1) & DMA_BUSY));
+}
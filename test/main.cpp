@@ -0,0 +1,27 @@
+//-----------------------------------------------------------------------------
+// Custard host test runner
+//-----------------------------------------------------------------------------
+// Runs every registered test, or those whose names contain the argument:
+//
+//   test [filter]
+//-----------------------------------------------------------------------------
+
+#include <cstring>
+
+#include <custard/host.hpp>
+
+#include "test.hpp"
+
+int main(int argc, char** argv) {
+  int run = 0;
+  for (test::test_case* t = test::first; t; t = t->next) {
+    if (argc > 1 && !std::strstr(t->name, argv[1])) continue;
+    custard::host::reset();
+    int before = test::failures;
+    t->run();
+    if (test::failures != before) std::printf("FAIL %s\n", t->name);
+    ++run;
+  }
+  std::printf("%d tests, %d failures\n", run, test::failures);
+  return test::failures ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+//-----------------------------------------------------------------------------
+// custard/math.hpp
+//-----------------------------------------------------------------------------
+// Checks the documented error bounds against double precision.
+//-----------------------------------------------------------------------------
+
+#include <cmath>
+
+#include <custard/math.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+static const double pi = 3.14159265358979323846;
+
+static double lsb_error(q12 q, double exact) {
+  return std::fabs(q.raw() - exact * 4096);
+}
+
+TEST(sin_cos_within_1_5_lsb) {
+  double worst = 0;
+  for (angle a = -turn; a < 2 * turn; ++a) {
+    double t = a * 2 * pi / turn;
+    worst = std::fmax(worst, lsb_error(sin(a), std::sin(t)));
+    worst = std::fmax(worst, lsb_error(cos(a), std::cos(t)));
+  }
+  CHECK(worst <= 1.5);
+}
+
+TEST(atan2_within_2_units) {
+  double worst = 0;
+  for (int i = 0; i < 4096; ++i) {
+    double t = i * 2 * pi / 4096;
+    for (double r : {0.01, 1.0, 300.0}) {
+      q12 x(r * std::cos(t)), y(r * std::sin(t));
+      double exact = std::atan2(double(y.raw()), double(x.raw()));
+      if (exact < 0) exact += 2 * pi;
+      double e = std::fabs(atan2(y, x) - exact * turn / (2 * pi));
+      worst = std::fmax(worst, std::fmin(e, turn - e));
+    }
+  }
+  CHECK(worst <= 2);
+  CHECK(atan2(q12(0), q12(0)) == 0);
+}
+
+TEST(sqrt_within_bounds) {
+  for (int64_t r = 1; r <= INT32_MAX; r += r / 97 + 1) {
+    q12 x = q12::from_raw(int32_t(r));
+    double exact = std::sqrt(r / 4096.0);
+    if (r < 256 * 4096) CHECK(lsb_error(sqrt(x), exact) <= 1);
+    else CHECK(std::fabs(float(sqrt(x)) / exact - 1) <= 2e-5);
+  }
+  CHECK(sqrt(q12(-1)) == 0);
+}
+
+TEST(rsqrt_within_1_lsb) {
+  for (int64_t r = 1; r <= INT32_MAX; r += r / 97 + 1)
+    CHECK(lsb_error(rsqrt(q12::from_raw(int32_t(r))),
+                    1 / std::sqrt(r / 4096.0)) <= 1);
+  CHECK(rsqrt(0).raw() == INT32_MAX);
+}
+
+TEST(recip_within_1_lsb) {
+  for (int64_t r = 1; r <= INT32_MAX; r += r / 97 + 1) {
+    CHECK(lsb_error(recip(q12::from_raw(int32_t(r))), 4096.0 / r) <= 1);
+    CHECK(lsb_error(recip(q12::from_raw(int32_t(-r))), -4096.0 / r) <= 1);
+  }
+  CHECK(recip(0).raw() == INT32_MAX);
+}
+
+TEST(normalize_within_1_lsb_at_any_length) {
+  for (double length : {0.01, 1.0, 7.0, 1000.0, 3000.0, 9000.0, 500000.0})
+    for (angle a = 0; a < turn; a += 61) {
+      vec2<q12> v(q12(length * std::cos(a * 2 * pi / turn)),
+                  q12(length * std::sin(a * 2 * pi / turn)));
+      double x = v.x.raw(), y = v.y.raw(), l = std::sqrt(x * x + y * y);
+      vec2<q12> n = normalize(v);
+      CHECK(lsb_error(n.x, x / l) <= 1);
+      CHECK(lsb_error(n.y, y / l) <= 1);
+    }
+  vec2<q12> n = normalize(vec2<q12>());
+  CHECK(n.x == 0 && n.y == 0);
+}
+
+TEST(rotate_and_direction) {
+  vec2<q12> v = rotate(vec2<q12>(100, 0), turn / 4);
+  CHECK(std::abs(v.x.raw()) <= 100 * 2 && v.y == q12(100));
+  CHECK(std::abs(angle_of(direction(turn / 3)) - turn / 3) <= 2);
+  CHECK_NEAR(float(length(vec2<q12>(-3, 4))), 5, 1.0 / 4096);
+  q12 most = q12::from_raw(INT32_MIN);
+  CHECK(length(vec2<q12>(most, most)).raw() == INT32_MAX);
+  CHECK(length(vec2<q12>(most, 0)).raw() == INT32_MAX);
+}
@@ -0,0 +1,176 @@
+//-----------------------------------------------------------------------------
+// custard/memory.hpp
+//-----------------------------------------------------------------------------
+// The tests are built with CUSTARD_MEMORY_STATS (see host.mk).
+//-----------------------------------------------------------------------------
+
+#include <vector>
+
+#include <custard/memory.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+TEST(arena_bumps_and_aligns) {
+  alignas(16) uint8_t buffer[256];
+  arena a(buffer, sizeof buffer);
+  CHECK(a.capacity() == 256 && a.used() == 0);
+  void* p = a.allocate(3, 1);
+  void* q = a.allocate(8, 8);
+  void* r = a.allocate(1, 1);
+  CHECK(p == buffer && q == buffer + 8 && r == buffer + 16);
+  uint32_t* w = a.allocate<uint32_t>(4);
+  CHECK(w == reinterpret_cast<uint32_t*>(buffer + 20));
+  CHECK(a.used() == 36 && a.remaining() == 220);
+  void* m = a.allocate(1);
+  CHECK(uintptr_t(m) % alignof(max_align_t) == 0);
+  a.reset();
+  CHECK(a.used() == 0 && a.allocate(1, 1) == buffer);
+}
+
+TEST(arena_fails_when_full) {
+  alignas(16) uint8_t buffer[64];
+  arena a(buffer, sizeof buffer);
+  CHECK(a.allocate(64, 1) == buffer);
+  CHECK(!a.allocate(1, 1) && a.used() == 64);
+  a.reset();
+  CHECK(a.allocate(60, 1) && !a.allocate(4, 8)); // padding does not fit
+  CHECK(a.allocate(4, 4) == buffer + 60);
+  a.reset();
+  CHECK(!a.allocate(65, 1) && !a.allocate(size_t(-1), 1));
+  // A count whose size overflows
+  CHECK(!a.allocate<uint32_t>(size_t(-1) / 2) && a.used() == 0);
+}
+
+TEST(arena_counts_peak_and_failures) {
+  alignas(16) uint8_t buffer[100];
+  arena a(buffer, sizeof buffer);
+  a.allocate(40, 1);
+  a.allocate(30, 1);
+  a.reset();
+  a.allocate(50, 1);
+  a.allocate(60, 1);
+  memory_stats s = a.stats();
+  CHECK(s.peak == 70 && s.allocations == 3 && s.failures == 1);
+}
+
+TEST(arena_allocator_backs_containers) {
+  alignas(16) uint8_t buffer[1024];
+  arena a(buffer, sizeof buffer);
+  std::vector<int, arena_allocator<int>> v{arena_allocator<int>(a)};
+  v.reserve(100);
+  for (int i = 0; i < 100; ++i) v.push_back(i);
+  CHECK(v.size() == 100 && v[99] == 99);
+  CHECK(static_cast<void*>(v.data()) >= buffer);
+  CHECK(static_cast<void*>(v.data()) < buffer + sizeof buffer);
+  CHECK(a.used() == 400);
+  // Copies share the arena
+  arena_allocator<char> c(v.get_allocator());
+  CHECK(c == v.get_allocator() && c.a == &a);
+  alignas(16) uint8_t other[16];
+  arena b(other, sizeof other);
+  CHECK(arena_allocator<int>(b) != v.get_allocator());
+}
+
+TEST(frame_arena_is_global) {
+  frame_arena.reset();
+  CHECK(frame_arena.capacity() == CUSTARD_FRAME_ARENA_SIZE);
+  void* p = frame_arena.allocate(100);
+  CHECK(p == _frame_memory);
+  frame_arena.reset();
+}
+
+namespace {
+  struct particle {
+    static int live;
+    int x, y;
+    particle(int x, int y) : x(x), y(y) { ++live; }
+    ~particle() { --live; }
+  };
+  int particle::live = 0;
+}
+
+TEST(pool_creates_and_destroys) {
+  pool<particle, 4> p;
+  CHECK(p.size() == 0 && p.capacity() == 4 && !p.full());
+  particle* a = p.create(1, 2);
+  particle* b = p.create(3, 4);
+  CHECK(a && b && a != b && a->x == 1 && b->y == 4);
+  CHECK(particle::live == 2 && p.size() == 2);
+  CHECK(p.owns(a) && p.owns(b));
+  particle outside(0, 0);
+  CHECK(!p.owns(&outside));
+  p.destroy(a);
+  CHECK(particle::live == 2 && p.size() == 1);
+  // The slot freed last is reused first
+  CHECK(p.create(5, 6) == a);
+  p.destroy(nullptr);
+  CHECK(p.size() == 2);
+  p.destroy(a);
+  p.destroy(b);
+  CHECK(particle::live == 1 && p.size() == 0);
+}
+
+TEST(pool_fails_when_full) {
+  pool<int, 3> p;
+  int* a = p.create(1);
+  int* b = p.create(2);
+  int* c = p.create(3);
+  CHECK(p.full() && !p.create(4) && !p.allocate());
+  // Every slot is distinct and aligned
+  CHECK(a != b && b != c && a != c);
+  CHECK(uintptr_t(a) % alignof(int) == 0);
+  p.destroy(b);
+  CHECK(!p.full() && p.create(5) == b && *b == 5);
+  memory_stats s = p.stats();
+  CHECK(s.peak == 3 && s.allocations == 4 && s.failures == 2);
+}
+
+TEST(pool_reuses_slots_in_any_order) {
+  pool<uint64_t, 64> p;
+  uint64_t* live[64] = {};
+  uint32_t r = 1;
+  int count = 0;
+  bool consistent = true;
+  for (int i = 0; i < 10000; ++i) {
+    r = r * 1103515245 + 12345;
+    int k = int(r >> 16) % 64;
+    if (live[k]) {
+      consistent &= *live[k] == uint64_t(k);
+      p.destroy(live[k]);
+      live[k] = nullptr;
+      --count;
+    }
+    else {
+      live[k] = p.create(uint64_t(k));
+      consistent &= live[k] && p.owns(live[k]);
+      ++count;
+    }
+    consistent &= p.size() == size_t(count);
+  }
+  CHECK(consistent);
+  CHECK(p.stats().peak <= 64);
+}
+
+TEST(pool_refuses_bad_frees) {
+  pool<particle, 4> p;
+  particle* a = p.create(1, 2);
+  particle* b = p.create(3, 4);
+  int live = particle::live;
+  p.destroy(a);
+  p.destroy(a);                                        // already free
+  p.deallocate(reinterpret_cast<uint8_t*>(b) + 1);     // not a slot
+  particle outside(0, 0);
+  p.destroy(&outside);                                 // not in the pool
+  CHECK(p.stats().bad_frees == 3);
+  CHECK(p.size() == 1 && particle::live == live);
+  // The free list is intact: a is handed out once, then the unused slots
+  particle* c = p.create(5, 6);
+  particle* d = p.create(7, 8);
+  particle* e = p.create(9, 10);
+  CHECK(c == a && d != a && e != a && d != b && e != b && d != e);
+  CHECK(p.full() && !p.create(0, 0));
+  p.destroy(b);
+  CHECK(p.stats().bad_frees == 3 && p.size() == 3);
+}
@@ -0,0 +1,31 @@
+//-----------------------------------------------------------------------------
+// Fixed-point code without floating point
+//-----------------------------------------------------------------------------
+// Compiled, not run, by 'make test': without optimization and with the
+// floating point unit disabled (NOFLOAT_FLAGS in host.mk), so that any float
+// operation left behind by the literals, integer construction or arithmetic
+// fails to compile or references a soft-float routine, which the rule checks
+// for. The ARM9 has no FPU, so this is what the device build would pay for.
+//-----------------------------------------------------------------------------
+
+#include <custard/math.hpp>
+#include <custard/types.hpp>
+
+using namespace custard;
+
+q12 literals(q12 a) {
+  return a * 1.25_q12 + 3_q12 - 0.000244140625_q12 + -0.5_q12;
+}
+
+q12 integers(int n, q12 a) { return q12(n) / a + q12(-3) * 2; }
+
+vec2<q12> vectors(vec2<q12> v) {
+  constexpr vec2<q12> offset(0.5_q12, -1);
+  return (v + offset) * 0.75_q12 - vec2<q12>(1, 2);
+}
+
+q16 formats(q8 a, q15 g, q16 w) {
+  return q16(a) + mul<q16>(g, w) * 0.5_q16 + q16(q12(2.5_q12)) - 1.5_q16;
+}
+
+q12 trigonometry(angle t) { return sin(t) * cos(t) + sqrt(2.25_q12); }
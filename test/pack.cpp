@@ -0,0 +1,102 @@
+//-----------------------------------------------------------------------------
+// custard/pack.hpp, tools/pack.hpp
+//-----------------------------------------------------------------------------
+
+#include <cstring>
+
+#include "../tools/pack.hpp"
+#include "test.hpp"
+
+using namespace custard;
+
+// Sample data of each kind the packer meets: noise, runs, repeated tiles
+static pack::bytes sample(int kind, size_t n) {
+  pack::bytes v(n);
+  uint32_t r = 12345;
+  for (size_t i = 0; i < n; ++i) {
+    r = r * 1103515245 + 12345;
+    switch (kind) {
+      case 0: v[i] = uint8_t(r >> 16); break;
+      case 1: v[i] = uint8_t(i / 37 % 3); break;
+      default: { // 64-byte tiles drawn from a set of 7
+        uint32_t t = uint32_t(i / 64 * 5 % 7 * 64 + i % 64) * 2654435761u;
+        v[i] = uint8_t(t >> 24);
+        break;
+      }
+    }
+  }
+  return v;
+}
+
+// Blobs are read as words, so copy them to word-aligned storage
+static std::vector<uint32_t> words(const pack::bytes& b) {
+  std::vector<uint32_t> w((b.size() + 3) / 4);
+  std::memcpy(w.data(), b.data(), b.size());
+  return w;
+}
+
+static bool round_trips(const pack::bytes& in, size_t chunk) {
+  auto blob = words(pack::encode(in, chunk));
+  std::vector<uint32_t> out(in.size() / 4 + 1, 0xdeadbeef);
+  return pack::unpack<16384>(blob.data(), out.data())
+    && (in.empty() || !std::memcmp(out.data(), in.data(), in.size()))
+    && out[in.size() / 4] == 0xdeadbeef;
+}
+
+TEST(pack_round_trips) {
+  for (int kind = 0; kind < 3; ++kind)
+    for (size_t n : {0, 4, 1000, 4096, 20000})
+      for (size_t chunk : {256, 4096, 16384})
+        CHECK(round_trips(sample(kind, n), chunk));
+}
+
+TEST(pack_chooses_method) {
+  pack::bytes noise = sample(0, 4096), runs = sample(1, 4096),
+              tiles = sample(2, 4096);
+  CHECK(pack::encode_chunk(noise.data(), 4096)[0] == pack::stored);
+  CHECK(pack::encode_chunk(runs.data(), 4096)[0] == pack::rle);
+  pack::bytes t = pack::encode_chunk(tiles.data(), 4096);
+  CHECK(t[0] == pack::lz77 && t.size() < 4096 / 2);
+}
+
+TEST(pack_decodes_a_chunk_at_a_time) {
+  pack::bytes in = sample(2, 10000);
+  auto blob = words(pack::encode(in, 1024));
+  std::vector<uint32_t> out(2500);
+  pack::decoder<1024> d;
+  CHECK(d.open(blob.data(), out.data()));
+  CHECK(d.size() == 10000);
+  CHECK(!d.run(1));                  // one whole chunk
+  CHECK(d.decoded() == 1024);
+  CHECK(!d.run(3000));
+  CHECK(d.decoded() == 4096);
+  CHECK(d.run(100000) && d.decoded() == 10000 && !d.failed());
+  CHECK(!std::memcmp(out.data(), in.data(), in.size()));
+}
+
+TEST(pack_rejects_bad_blobs) {
+  pack::bytes in = sample(2, 8192);
+  pack::bytes b = pack::encode(in, 4096);
+  std::vector<uint32_t> out(2048);
+  pack::decoder<2048> small;
+  auto blob = words(b);
+  CHECK(!small.open(blob.data(), out.data()));   // chunks too large
+  blob[0] ^= 1;
+  CHECK(!pack::unpack(blob.data(), out.data())); // magic
+  // an LZ77 match reaching back before the start of the chunk
+  pack::bytes bad = {pack::lz77, 0x80, 0x00, 0x10};
+  uint8_t tmp[16];
+  CHECK(pack::decode_chunk(bad.data(), bad.size(), tmp, 16) == 0);
+  // tokens cut off before their operands, which are not read
+  uint8_t run[2] = {pack::rle, 0x85}, match[4] = {pack::lz77, 0x40, 'a', 0};
+  CHECK(pack::decode_chunk(run, 2, tmp, 16) == 0);
+  CHECK(pack::decode_chunk(match, 3, tmp, 16) == 1);
+  pack::decoder<8192> scratch;
+  CHECK(pack::unpack(words(b).data(), out.data(), scratch));
+  // a truncated chunk: the last offset (word 4 + count) is brought forward
+  blob = words(b);
+  blob[4 + 2] -= 10;
+  pack::decoder<> d;
+  CHECK(d.open(blob.data(), out.data()));
+  CHECK(!d.run(8192) && d.failed());
+}
@@ -0,0 +1,130 @@
+//-----------------------------------------------------------------------------
+// custard/palette.hpp
+//-----------------------------------------------------------------------------
+
+#include <custard/palette.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+static volatile uint16_t* bg_palette() {
+  return host::at<uint16_t>(0x05000000);
+}
+
+static void ramp(uint16_t* c, int n, int seed) {
+  for (int i = 0; i < n; ++i) c[i] = uint16_t((i * 33 + seed * 1057) & 0x7fff);
+}
+
+TEST(palette_blend) {
+  CHECK(palette::blend(0x0000, 0x7fff, 0) == 0x0000);
+  CHECK(palette::blend(0x0000, 0x7fff, 16) == 0x7fff);
+  CHECK(palette::blend(0x001f, 0x7c00, 8) == (15 | 15 << 10));
+  CHECK(palette::ext_control(vram::bank::F) == &VRAM_F_CR);
+  CHECK(palette::ext_control(vram::bank::H) == &VRAM_H_CR);
+}
+
+TEST(palette_shares_identical_palettes) {
+  palette::manager<16> pal(bg_palette());
+  uint16_t a[16], b[16];
+  ramp(a, 16, 1);
+  ramp(b, 16, 2);
+  int s = pal.load(a), t = pal.load(b);
+  CHECK(s != t);
+  CHECK(pal.load(a) == s && pal.references(s) == 2);
+  b[15] ^= 1;                        // same hash bucket is not enough
+  CHECK(pal.load(b) != t);
+  CHECK(pal.used() == 3);
+  CHECK(!pal.release(s) && pal.release(s));
+  CHECK(!pal.release(s));
+  CHECK(pal.used() == 2);
+}
+
+TEST(palette_runs_out_of_slots) {
+  palette::manager<16> pal(bg_palette());
+  uint16_t c[16];
+  for (int i = 0; i < 16; ++i) {
+    ramp(c, 16, i);
+    CHECK(pal.load(c) == i);
+  }
+  ramp(c, 16, 99);
+  CHECK(pal.load(c) == pal.none);
+  pal.release(7);
+  CHECK(pal.load(c) == 7);
+}
+
+TEST(palette_retain_saturates) {
+  palette::manager<16> pal(bg_palette());
+  uint16_t c[16];
+  ramp(c, 16, 3);
+  int s = pal.load(c);
+  pal.retain(s + 1);                 // free slot
+  pal.retain(-1);
+  pal.retain(16);
+  CHECK(pal.references(s + 1) == 0 && pal.used() == 1);
+  for (int i = 0; i < 300; ++i) pal.retain(s);
+  CHECK(pal.references(s) == 255);
+  for (int i = 0; i < 300; ++i) CHECK(!pal.release(s));
+  CHECK(pal.load(c) == s && pal.references(s) == 255);
+}
+
+TEST(palette_uploads_changed_words) {
+  palette::manager<16> pal(bg_palette());
+  uint16_t c[16];
+  ramp(c, 16, 5);
+  int s = pal.load(c);
+  CHECK(pal.upload() == 8);
+  for (int i = 0; i < 16; ++i) CHECK(bg_palette()[16 * s + i] == c[i]);
+  CHECK(pal.upload() == 0);
+  pal.load(c);                       // shared: nothing to upload
+  CHECK(pal.upload() == 0);
+  pal.cycle(s, 4, 4);                // colours 4-7, words 2-3
+  CHECK(pal.upload() == 2);
+  CHECK(bg_palette()[16 * s + 4] == c[7] && bg_palette()[16 * s + 5] == c[4]);
+  pal.fade(s, 0, 0);                 // unchanged
+  CHECK(pal.upload() == 0);
+  pal.fade(s, 0x7fff, 16);
+  CHECK(pal.upload() == 8);
+  CHECK(bg_palette()[16 * s + 3] == 0x7fff);
+  pal.invalidate();
+  CHECK(pal.upload() == 8);
+}
+
+TEST(palette_effects_keep_the_loaded_colours) {
+  palette::manager<16> pal(bg_palette());
+  uint16_t c[16];
+  ramp(c, 16, 5);
+  int s = pal.load(c);
+  pal.cycle(s, 0, 16, 3);
+  pal.fade(s, 0x7fff, 8);
+  CHECK(pal.colours(s)[3] == palette::blend(c[0], 0x7fff, 8));
+  // The loaded palette is unchanged, so loading it again shares the slot
+  CHECK(pal.load(c) == s && pal.references(s) == 2);
+  pal.fade(s, 0, 0);
+  pal.cycle(s, 0, 16, -3);
+  bool same = true;
+  for (int i = 0; i < 16; ++i) same &= pal.colours(s)[i] == c[i];
+  CHECK(same);
+  // Free slots and ranges beyond the palette are ignored
+  pal.upload();
+  pal.fade(s + 1, 0x7fff, 16);
+  pal.cycle(s + 1, 0, 4);
+  pal.cycle(-1, 0, 4);
+  pal.cycle(s, 14, 4);
+  pal.cycle(s, -1, 4);
+  CHECK(pal.upload() == 0 && pal.used() == 1);
+}
+
+TEST(palette_ext_upload_restores_bank_mapping) {
+  VRAM_F_CR = 0x85;                  // sprite extended palette
+  palette::manager<256> pal(palette::ext_memory(vram::bank::F),
+                            palette::ext_control(vram::bank::F));
+  uint16_t c[256];
+  ramp(c, 256, 4);
+  CHECK(pal.load(c) == 0 && pal.load(c + 0) == 0);
+  ramp(c, 256, 6);
+  CHECK(pal.load(c) == 1);
+  CHECK(pal.upload() == 256);
+  CHECK(VRAM_F_CR == 0x85);
+  CHECK(*palette::ext_memory(vram::bank::F, 512 + 2 * 255) == c[255]);
+}
@@ -0,0 +1,103 @@
+//-----------------------------------------------------------------------------
+// custard/profile.hpp
+//-----------------------------------------------------------------------------
+
+#include <sstream>
+#include <string>
+
+#include <custard/profile.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+static void spin(uint32_t ticks) {
+  for (uint32_t t = profile::now(); profile::now() - t < ticks; );
+}
+
+// A host that has been up for days must not overflow the conversion
+static_assert(profile::_ticks(1000000000) == profile::clock_rate);
+static_assert(profile::_ticks(uint64_t(86400) * 7 * 1000000000)
+              == uint32_t(uint64_t(86400) * 7 * profile::clock_rate));
+
+TEST(profile_clock_rate) {
+  profile::start_clock();
+  uint32_t t0 = profile::now();
+  auto h0 = std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now() - h0
+         < std::chrono::milliseconds(20));
+  uint32_t ticks = profile::now() - t0;
+  CHECK(ticks >= 670000 && ticks < 1000000); // 20ms is 670280 ticks
+  CHECK(profile::microseconds(profile::clock_rate / 1000) == 999);
+}
+
+TEST(profile_zones_nest_and_summarize) {
+  profile::recorder<4, 8, 2> r;
+  int outer = r.zone("outer"), inner = r.zone("inner");
+  CHECK(r.zone("outer") == outer && r.size() == 2);
+  for (int f = 0; f < 3; ++f) {
+    r.enter(outer);
+    spin(2000);
+    r.enter(inner);
+    spin(10000);
+    r.leave();
+    r.leave();
+    r.frame();
+  }
+  CHECK(r.history() == 1);           // the other slot is the current frame
+  int n;
+  const auto* e = r.events(1, n);
+  CHECK(n == 2 && e[0].zone == outer && e[1].depth == 1);
+  CHECK(e[1].begin >= e[0].begin + 2000 && e[1].end <= e[0].end);
+  const auto& s = r.summarize(inner);
+  CHECK(s.frames == 3 && s.min >= 10000 && s.avg() >= s.min);
+  CHECK(r.summarize(outer).min >= 12000);
+}
+
+TEST(profile_open_zone_splits_at_frame) {
+  profile::recorder<4, 8, 3> r;
+  int z = r.zone("z");
+  r.enter(z);
+  spin(5000);
+  r.frame();
+  spin(5000);
+  r.leave();
+  r.frame();
+  int n;
+  const auto* e = r.events(2, n);
+  CHECK(n == 1 && e[0].end >= 5000);
+  e = r.events(1, n);
+  CHECK(n == 1 && e[0].begin == 0 && e[0].end >= 5000);
+  CHECK(r.summarize(z).min >= 5000);
+}
+
+TEST(profile_writes_csv) {
+  profile::recorder<4, 8, 2> r;
+  r.enter(r.zone("draw"));
+  r.leave();
+  r.frame();
+  std::ostringstream frame, summary;
+  r.write_frame(frame);
+  r.write_summary(summary);
+  CHECK(frame.str().rfind("zone,depth,", 0) == 0);
+  CHECK(frame.str().find("\ndraw,0,") != std::string::npos);
+  CHECK(summary.str().find("\ndraw,") != std::string::npos);
+}
+
+TEST(profile_recorders_share_the_clock) {
+  profile::recorder<4, 8, 2> a;
+  int z = a.zone("z");
+  spin(5000);
+  // A second recorder must not restart the clock under the first
+  profile::recorder<4, 8, 2> b;
+  a.enter(z);
+  spin(1000);
+  a.leave();
+  a.frame();
+  int n;
+  const auto* e = a.events(1, n);
+  CHECK(n == 1 && e[0].begin >= 5000 && e[0].begin < 5000000);
+  CHECK(e[0].end - e[0].begin >= 1000);
+  b.frame();
+  CHECK(b.history() == 1 && b.events(1, n) && n == 0);
+}
@@ -0,0 +1,91 @@
+//-----------------------------------------------------------------------------
+// custard/types.hpp: range
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <vector>
+
+#include <custard/types.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+typedef std::vector<std::pair<int, int>> points;
+
+template <class R> static points visit(R r) {
+  points p;
+  for (ivec2 v : r) p.push_back({v.y, v.x});
+  return p;
+}
+
+// The points of a range, by nested loops
+static points expected(ivec2 v0, ivec2 v1, ivec2 step) {
+  points p;
+  for (int y = v0.y; y < v1.y; y += step.y)
+    for (int x = v0.x; x < v1.x; x += step.x) p.push_back({y, x});
+  return p;
+}
+
+static bool same_set(points a, points b) {
+  std::sort(a.begin(), a.end());
+  std::sort(b.begin(), b.end());
+  return a == b;
+}
+
+TEST(range_1d) {
+  int sum = 0, n = 0;
+  for (int i : range<>(3, 10, 3)) { sum += i; ++n; }
+  CHECK(n == 3 && sum == 3 + 6 + 9);
+  for (int i : range<>(5, 5)) { (void)i; CHECK(false); }
+}
+
+TEST(range_2d_row_major) {
+  const ivec2 cases[][3] = {
+    {ivec2(0, 0), ivec2(4, 3), ivec2(1, 1)},
+    {ivec2(5, 2), ivec2(9, 6), ivec2(1, 1)},  // rows restart at v0.x
+    {ivec2(-3, 1), ivec2(8, 10), ivec2(2, 3)},
+    {ivec2(1, 1), ivec2(2, 2), ivec2(5, 5)},
+    {ivec2(4, 0), ivec2(4, 5), ivec2(1, 1)},  // no columns
+    {ivec2(0, 4), ivec2(5, 4), ivec2(1, 1)}}; // no rows
+  for (auto& c : cases)
+    CHECK(visit(range<ivec2>(c[0], c[1], c[2]))
+          == expected(c[0], c[1], c[2]));
+}
+
+TEST(range_2d_tiled_visits_each_point_once) {
+  const ivec2 cases[][4] = {
+    {ivec2(0, 0), ivec2(16, 16), ivec2(1, 1), ivec2(8, 8)},
+    {ivec2(3, 5), ivec2(30, 21), ivec2(1, 1), ivec2(8, 8)},
+    {ivec2(0, 0), ivec2(20, 20), ivec2(2, 2), ivec2(8, 8)},
+    {ivec2(1, 2), ivec2(40, 33), ivec2(3, 5), ivec2(8, 4)},
+    {ivec2(0, 0), ivec2(20, 20), ivec2(4, 4), ivec2(2, 2)}, // empty tiles
+    {ivec2(4, 0), ivec2(4, 5), ivec2(1, 1), ivec2(8, 8)}};
+  for (auto& c : cases) {
+    points p = visit(range<ivec2>(c[0], c[1], c[2]).tiles(c[3]));
+    CHECK(p.size() == expected(c[0], c[1], c[2]).size());
+    CHECK(same_set(p, expected(c[0], c[1], c[2])));
+  }
+}
+
+TEST(range_2d_tiled_order) {
+  points p = visit(range<ivec2>(ivec2(4, 4)).tiles(ivec2(2, 2)));
+  const points first = {{0, 0}, {0, 1}, {1, 0}, {1, 1}, {0, 2}, {0, 3}};
+  CHECK(points(p.begin(), p.begin() + 6) == first);
+}
+
+TEST(range_2d_z_order) {
+  points p = visit(range<ivec2>(ivec2(4, 4)).z_order());
+  const points first = {{0, 0}, {0, 1}, {1, 0}, {1, 1}, {0, 2}, {0, 3}};
+  CHECK(points(p.begin(), p.begin() + 6) == first);
+  const ivec2 cases[][3] = {
+    {ivec2(0, 0), ivec2(16, 16), ivec2(1, 1)},
+    {ivec2(3, 5), ivec2(30, 12), ivec2(1, 1)},
+    {ivec2(-2, 1), ivec2(19, 30), ivec2(2, 3)},
+    {ivec2(4, 0), ivec2(4, 5), ivec2(1, 1)}};
+  for (auto& c : cases) {
+    points q = visit(range<ivec2>(c[0], c[1], c[2]).z_order());
+    CHECK(q.size() == expected(c[0], c[1], c[2]).size());
+    CHECK(same_set(q, expected(c[0], c[1], c[2])));
+  }
+}
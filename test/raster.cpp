@@ -0,0 +1,106 @@
+//-----------------------------------------------------------------------------
+// custard/raster.hpp
+//-----------------------------------------------------------------------------
+// Frames are played through the HBlank DMA simulated by custard/host.hpp:
+// the registers each line sees are those written by the vertical blank
+// handler and by the transfers at the horizontal blanks before it.
+//-----------------------------------------------------------------------------
+
+#include <custard/raster.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+static volatile uint32_t* scroll() {
+  return reinterpret_cast<volatile uint32_t*>(&REG_BG0HOFS);
+}
+
+// Fill the back table of r with the value of line y in frame f
+template <class R> static void fill(R& r, uint32_t f) {
+  for (int y = 0; y < 192; ++y) r.line(y)[0] = f << 16 | uint32_t(y);
+}
+
+// Does each line of the next frame see the values of frame f?
+template <class R> static bool shows(R& r, uint32_t f) {
+  bool ok = true;
+  r.simulate([&](int y, const volatile uint32_t* io) {
+    ok &= REG_VCOUNT == y && io[0] == (f << 16 | uint32_t(y));
+  });
+  return ok;
+}
+
+TEST(raster_streams_one_row_per_line) {
+  display::raster<1> r(scroll(), 1);
+  fill(r, 1);
+  r.present();
+  r.vblank();
+  CHECK(*scroll() == 1u << 16);            // row 0, written directly
+  CHECK(host::dma[1].transfers == 0);
+  CHECK(shows(r, 1));
+  // One transfer at the end of each visible line, of one word
+  CHECK(host::dma[1].transfers == 192 && host::dma[1].words);
+  CHECK(host::dma[1].units == 1 && host::dma[1].vcount == 191);
+  // The last reads the spare row, so the frame ends on row 0 again
+  CHECK(*scroll() == 1u << 16);
+  // Nothing is read past it in vertical blanking
+  host::hblank();
+  CHECK(host::dma[1].transfers == 192 && *scroll() == 1u << 16);
+}
+
+TEST(raster_swaps_tables_on_present) {
+  display::raster<1> r(scroll());
+  fill(r, 1);
+  r.present();
+  r.vblank();
+  CHECK(shows(r, 1));
+  // Filling the back table changes nothing until it is presented
+  fill(r, 2);
+  r.vblank();
+  CHECK(shows(r, 1));
+  r.present();
+  CHECK(*scroll() == 1u << 16);
+  r.vblank();
+  CHECK(shows(r, 2));
+  // The table stays current for later frames, and the old one is the back
+  r.vblank();
+  CHECK(shows(r, 2));
+  fill(r, 3);
+  r.present();
+  r.vblank();
+  CHECK(shows(r, 3));
+}
+
+TEST(raster_writes_consecutive_registers) {
+  // BG2PA-PD, BG2X and BG2Y of the main engine
+  volatile uint32_t* io = display::main_io() + 8;
+  display::raster<4> r(io, 2);
+  for (int y = 0; y < 192; ++y)
+    for (int i = 0; i < 4; ++i) r.line(y)[i] = uint32_t(y * 4 + i);
+  r.present();
+  r.vblank();
+  bool ok = true;
+  r.simulate([&](int y, const volatile uint32_t* d) {
+    for (int i = 0; i < 4; ++i) ok &= d[i] == uint32_t(y * 4 + i);
+    ok &= io[4] == 0;
+  });
+  CHECK(ok && host::dma[2].units == 4);
+  CHECK(io[0] == 0 && io[3] == 3);
+}
+
+TEST(raster_stops) {
+  display::raster<1> r(scroll(), 3);
+  fill(r, 1);
+  r.present();
+  r.vblank();
+  REG_VCOUNT = 0;
+  host::hblank();
+  CHECK(*scroll() == (1u << 16 | 1));
+  r.stop();
+  REG_VCOUNT = 1;
+  host::hblank();
+  CHECK(*scroll() == (1u << 16 | 1) && host::dma[3].transfers == 1);
+  // Starting again begins with row 0
+  r.vblank();
+  CHECK(shows(r, 1));
+}
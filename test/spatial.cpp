@@ -0,0 +1,85 @@
+//-----------------------------------------------------------------------------
+// custard/spatial.hpp
+//-----------------------------------------------------------------------------
+// Queries and pairs are compared with testing every box against every other.
+//-----------------------------------------------------------------------------
+
+#include <set>
+#include <utility>
+
+#include <custard/spatial.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+using spatial::box;
+
+static uint32_t seed = 1;
+static int random(int n) {
+  seed = seed * 1103515245 + 12345;
+  return int(seed >> 8) % n;
+}
+
+// Mostly entity-sized boxes, some outside the 512x512 pixel grid, a few large
+static box random_box() {
+  int x = random(640) - 64, y = random(640) - 64;
+  int w = random(8) ? 4 + random(24) : 40 + random(60), h = 4 + random(24);
+  return {vec2<q12>(q12(x), q12(y)), vec2<q12>(q12(x + w), q12(y + h))};
+}
+
+typedef spatial::grid<200> grid;
+
+static bool pairs_match(const grid& g) {
+  std::set<std::pair<int, int>> found, expected;
+  g.pairs([&](int a, int b) { found.insert({a, b}); });
+  for (int a = 0; a < 200; ++a)
+    for (int b = a + 1; b < 200; ++b)
+      if (g.contains(a) && g.contains(b)
+          && g.bounds(a).overlaps(g.bounds(b))) expected.insert({a, b});
+  return found == expected;
+}
+
+static bool query_matches(const grid& g, const box& q) {
+  std::set<int> found, expected;
+  g.query(q, [&](int i) { found.insert(i); });
+  for (int i = 0; i < 200; ++i)
+    if (g.contains(i) && g.bounds(i).overlaps(q)) expected.insert(i);
+  return found == expected;
+}
+
+TEST(spatial_matches_brute_force) {
+  grid g(vec2<q12>(), 4);
+  for (int i = 0; i < 150; ++i) CHECK(g.insert(random_box()) == i);
+  CHECK(pairs_match(g));
+  for (int k = 0; k < 20; ++k) CHECK(query_matches(g, random_box()));
+  for (int step = 0; step < 10; ++step) {
+    for (int i = 0; i < 150; i += 1 + random(3)) g.move(i, random_box());
+    for (int k = 0; k < 5; ++k) g.remove(random(200));
+    while (g.size() < 150) g.insert(random_box());
+    CHECK(pairs_match(g));
+    CHECK(query_matches(g, random_box()));
+  }
+}
+
+TEST(spatial_insert_remove) {
+  spatial::grid<3> g;
+  box b = {vec2<q12>(q12(1), q12(1)), vec2<q12>(q12(2), q12(2))};
+  int a = g.insert(b), c = g.insert(b), d = g.insert(b);
+  CHECK(g.insert(b) == g.none && g.size() == 3);
+  g.remove(c);
+  g.remove(c);                       // already removed
+  CHECK(g.size() == 2 && !g.contains(c));
+  CHECK(g.insert(b) == c);
+  int pairs = 0;
+  g.pairs([&](int x, int y) { pairs += x < y; });
+  CHECK(pairs == 3);
+  g.clear();
+  CHECK(g.size() == 0 && !g.contains(a) && !g.contains(d));
+}
+
+TEST(spatial_box_edges) {
+  box a = {vec2<q12>(q12(0), q12(0)), vec2<q12>(q12(10), q12(10))};
+  box touching = {vec2<q12>(q12(10), q12(0)), vec2<q12>(q12(20), q12(10))};
+  box inside = {vec2<q12>(q12(2), q12(2)), vec2<q12>(q12(3), q12(3))};
+  CHECK(!a.overlaps(touching) && a.overlaps(inside) && inside.overlaps(a));
+}
@@ -0,0 +1,132 @@
+//-----------------------------------------------------------------------------
+// custard/sprite.hpp
+//-----------------------------------------------------------------------------
+
+#include <custard/host.hpp>
+#include <custard/sprite.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+using sprite::entry;
+
+static entry at(int y, int tile = 0) {
+  return {uint16_t(y & 0xff), 0, uint16_t(tile), 0};
+}
+
+static const volatile uint16_t* slot(int i) { return OAM + 4 * i; }
+
+TEST(sprite_radix_sort_is_stable) {
+  uint16_t keys[300];
+  uint16_t order[300], scratch[300];
+  for (int i = 0; i < 300; ++i) keys[i] = uint16_t((i * 7919) % 1000 * 61);
+  keys[10] = keys[20] = keys[290] = 0x1234;
+  sprite::radix_sort(keys, order, scratch, 300);
+  for (int i = 1; i < 300; ++i) {
+    CHECK(keys[order[i - 1]] <= keys[order[i]]);
+    if (keys[order[i - 1]] == keys[order[i]])
+      CHECK(order[i - 1] < order[i]);
+  }
+}
+
+TEST(sprite_oam_uploads_dirty_runs) {
+  sprite::oam o;
+  CHECK(o.upload(OAM) == 128);
+  CHECK(slot(0)[0] == sprite::hidden);
+  CHECK(o.upload(OAM) == 0);
+  o.set(5, 1, 2, 3);
+  o.set(6, 4, 5, 6);
+  o.set(31, 7, 8, 9);
+  o.set(32, 7, 8, 9);                // a run across a dirty word boundary
+  o.set(127, 1, 1, 1);
+  o.set(40, sprite::hidden, 0, 0);   // unchanged
+  CHECK(o.upload(OAM) == 5);
+  CHECK(slot(6)[0] == 4 && slot(6)[2] == 6);
+  CHECK(slot(32)[1] == 8 && slot(127)[2] == 1);
+  o.mark(9);
+  CHECK(o.upload(OAM) == 1);
+}
+
+TEST(sprite_oam_slots_and_affine_groups) {
+  sprite::oam o;
+  CHECK(o.alloc() == 0 && o.alloc() == 1);
+  o.free(0);
+  CHECK(o.alloc() == 0);
+  // Bad frees are ignored, so a slot is never handed out twice
+  o.free(1);
+  o.free(1);
+  o.free(-1);
+  o.free(128);
+  o.free(2);
+  CHECK(o.alloc() == 1 && o.alloc() == 2 && o.alloc() == 3);
+  int g = o.affine(q12(1), q12(0), q12(0), q12(1));
+  CHECK(o.affine(q12(1), q12(0), q12(0), q12(1)) == g);
+  int h = o.affine(q12(2), q12(0), q12(0), q12(2));
+  CHECK(h != g);
+  o.upload(OAM);
+  CHECK(slot(4 * h)[3] == 0x200 && slot(4 * h + 1)[3] == 0);
+  o.release_affine(g);
+  o.release_affine(g);
+  CHECK(o.affine(q12(3), q12(0), q12(0), q12(3)) == g);
+}
+
+TEST(sprite_multiplexer_reuses_slots) {
+  sprite::oam o;
+  sprite::multiplexer<8> m;
+  for (int y : {30, 0, 20, 10}) m.add(at(y, y));
+  m.build(o, 0, 2);
+  CHECK(m.dropped() == 0 && m.scheduled() == 2);
+  CHECK(o[0].y() == 0 && o[1].y() == 10);
+  o.upload(OAM);
+  m.vblank();
+  m.hblank(OAM, 17);
+  CHECK(slot(0)[0] == 0);
+  m.hblank(OAM, 18);                // two lines before y = 20
+  CHECK(slot(0)[0] == 20 && slot(0)[2] == 20);
+  m.hblank(OAM, 28);
+  CHECK(slot(1)[0] == 30);
+}
+
+TEST(sprite_multiplexer_drops_overflow) {
+  sprite::oam o;
+  sprite::multiplexer<8> m;
+  for (int i = 0; i < 3; ++i) m.add(at(50));
+  m.build(o, 10, 2);
+  CHECK(m.dropped() == 1 && m.scheduled() == 0);
+  CHECK(o[10].y() == 50 && o[11].y() == 50);
+  CHECK(o[12].attr0 == sprite::hidden);
+}
+
+TEST(sprite_multiplexer_idle_in_vblank) {
+  sprite::oam o;
+  sprite::multiplexer<8> m;
+  for (int y : {0, 20, 100}) m.add(at(y));
+  m.build(o, 0, 1);
+  o.upload(OAM);
+  m.vblank();
+  for (int line = 0; line < 192; ++line) m.hblank(OAM, line);
+  CHECK(slot(0)[0] == 100);
+  // the next frame's schedule is switched in at line 192 and must not be
+  // replayed on the remaining vertical blanking lines
+  for (int y : {0, 50}) m.add(at(y));
+  m.build(o, 0, 1);
+  o.upload(OAM);
+  m.vblank();
+  for (int line = 192; line < 263; ++line) m.hblank(OAM, line);
+  CHECK(slot(0)[0] == 0);
+  for (int line = 0; line <= 48; ++line) m.hblank(OAM, line);
+  CHECK(slot(0)[0] == 50);
+}
+
+TEST(sprite_multiplexer_clamps_lead_at_top) {
+  sprite::oam o;
+  sprite::multiplexer<8> m;
+  m.add(at(-20));
+  m.add(at(1));                      // due at line -1, done at line 0
+  m.build(o, 0, 1);
+  CHECK(m.scheduled() == 1);
+  o.upload(OAM);
+  m.vblank();
+  m.hblank(OAM, 0);
+  CHECK(slot(0)[0] == 1);
+}
@@ -0,0 +1,63 @@
+//-----------------------------------------------------------------------------
+// Custard host test framework
+//-----------------------------------------------------------------------------
+// Tests are functions registered with TEST, in any file under test/; they
+// report failures with CHECK and CHECK_NEAR, and carry on after a failure so
+// that one run reports everything. Emulated memory (custard/host.hpp) is
+// cleared before each test.
+//
+//   TEST(vram_alloc_reuses_freed_blocks) {
+//     ...
+//     CHECK(a.allocate(4) == p);
+//   }
+//-----------------------------------------------------------------------------
+
+#ifndef CUSTARD_TEST_HPP
+#define CUSTARD_TEST_HPP
+
+#include <cmath>
+#include <cstdio>
+
+namespace test {
+
+  struct test_case {
+    const char* name;
+    void (*run)();
+    test_case* next;
+  };
+
+  inline test_case* first = nullptr;
+  inline test_case** last = &first;
+  inline int failures = 0;
+
+  struct registrar {
+    registrar(test_case& t) { *last = &t; last = &t.next; }
+  };
+
+  inline void fail(const char* file, int line, const char* what) {
+    std::printf("%s:%d: failed: %s\n", file, line, what);
+    ++failures;
+  }
+
+  inline void near(double a, double b, double tolerance, const char* file,
+                   int line, const char* what) {
+    if (std::fabs(a - b) <= tolerance) return;
+    std::printf("%s:%d: failed: %s (%g vs %g, tolerance %g)\n", file, line,
+                what, a, b, tolerance);
+    ++failures;
+  }
+}
+
+#define TEST(name) \
+  static void test_##name(); \
+  static test::test_case test_case_##name = {#name, test_##name, nullptr}; \
+  static test::registrar test_registrar_##name(test_case_##name); \
+  static void test_##name()
+
+#define CHECK(e) ((e) ? void() : test::fail(__FILE__, __LINE__, #e))
+
+#define CHECK_NEAR(a, b, tolerance) \
+  test::near(double(a), double(b), tolerance, __FILE__, __LINE__, \
+             #a " == " #b)
+
+#endif
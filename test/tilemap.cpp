@@ -0,0 +1,49 @@
+//-----------------------------------------------------------------------------
+// custard/tilemap.hpp
+//-----------------------------------------------------------------------------
+
+#include <custard/tilemap.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+static uint16_t world[200 * 100];
+static uint16_t hw[4096];
+
+static bool view_matches(ivec2 camera) {
+  ivec2 t = camera >> 3;
+  for (int y = t.y; y <= (camera.y + 191) >> 3; ++y)
+    for (int x = t.x; x <= (camera.x + 255) >> 3; ++x) {
+      int i = ((x & 63) >> 5 | (y & 63) >> 5 << 1) << 10
+        | (y & 31) << 5 | (x & 31);
+      if (hw[i] != world[y * 200 + x]) return false;
+    }
+  return true;
+}
+
+TEST(tilemap_streams_within_budget) {
+  for (int i = 0; i < 200 * 100; ++i) world[i] = uint16_t(i);
+  display::streaming_map m(world, ivec2(200, 100), hw, 256);
+  m.load(ivec2(0, 0));
+  CHECK(m.ready(ivec2(0, 0)) && view_matches(ivec2(0, 0)));
+  for (int f = 1; f <= 300; ++f) {
+    ivec2 c(f * 4, f * 2);
+    m.update(c);
+    CHECK(m.bytes() <= 256);
+    CHECK(m.ready(c) && view_matches(c));
+  }
+}
+
+TEST(tilemap_fills_in_after_a_jump) {
+  for (int i = 0; i < 200 * 100; ++i) world[i] = uint16_t(i * 3);
+  display::streaming_map m(world, ivec2(200, 100), hw, 128);
+  m.load(ivec2(0, 0));
+  ivec2 c(1000, 500);
+  int frames = 0;
+  for (; !m.ready(c) && frames < 100; ++frames) {
+    m.update(c);
+    CHECK(m.bytes() <= 128);
+  }
+  CHECK(frames > 1 && m.ready(c) && view_matches(c));
+}
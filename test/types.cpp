@@ -0,0 +1,87 @@
+//-----------------------------------------------------------------------------
+// custard/types.hpp
+//-----------------------------------------------------------------------------
+
+#include <custard/types.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+// Literals and integer construction are constant expressions
+static_assert((1.25_q12).raw() == 5120);
+static_assert((0.000244140625_q12).raw() == 1);
+static_assert((1'000.5_q12).raw() == 4098048);
+static_assert((-0.5_q12).raw() == -2048);
+static_assert(q12(3).raw() == 3 << 12);
+static_assert((0.5_q8).raw() == 128);
+static_assert((0.75_q15).raw() == 24576);
+static_assert((vec2<q12>(1, 2) * 0.5_q12).y == 1_q12);
+
+// Negative values are constant expressions too, in every conversion
+static_assert(q12(-1).raw() == -4096);
+static_assert(q8(-128).raw() == -32768);
+static_assert(q16(q12(-3)).raw() == -3 * 65536);
+static_assert(q12(q8(-1)).raw() == -4096);
+static_assert(q8(q16(-2)).raw() == -512);
+static_assert((q12(-1) << 2).raw() == -16384);
+static_assert(mul<q16>(q8(-1), q8(2)).raw() == -2 * 65536);
+static_assert(mul<q16>(q12(-1), q15(0.5_q15)).raw() == -32768);
+
+TEST(literals_round_to_nearest) {
+  // 0.1 is 409.6 raw q12, 0.3 is 1228.8
+  CHECK((0.1_q12).raw() == 410);
+  CHECK((0.3_q12).raw() == 1229);
+  // exactly half an LSB rounds up
+  CHECK((0.001953125_q8).raw() == 1);
+}
+
+TEST(literals_match_float_construction) {
+  const double values[] = {0, 0.25, 1.5, 3.75, 100.125, 2047.5};
+  const q12 literals[] = {0_q12, 0.25_q12, 1.5_q12, 3.75_q12, 100.125_q12,
+                          2047.5_q12};
+  for (int i = 0; i < 6; ++i) CHECK(q12(values[i]) == literals[i]);
+}
+
+TEST(fixed_saturates_when_asked) {
+  q15 g = 0.75_q15;
+  CHECK((g + g).raw() == 32767);
+  CHECK((-g - g).raw() == -32768);
+  CHECK(q15(2).raw() == 32767);
+  CHECK((-q15::from_raw(-32768)).raw() == 32767);
+  // without saturation, results wrap
+  q8 a = 100;
+  CHECK((a + a).raw() == int16_t(200 * 256));
+}
+
+TEST(fixed_multiplies_in_64_bits) {
+  q12 big = 500000, half = 0.5_q12;
+  CHECK(big * half == q12(250000));
+  q16 w = q16::from_raw(0x7fffffff);
+  CHECK((w * q16(1)).raw() == 0x7fffffff);
+  CHECK_NEAR(float(q12(-7) * 1.5_q12), -10.5, 0);
+}
+
+TEST(fixed_divides) {
+  CHECK(q12(-7) / q12(2) == q12(-3.5));
+  CHECK(q16(1) / q16(3) == q16::from_raw(21845));
+  CHECK_NEAR(float(q8(100) / q8(-2)), -50, 0);
+}
+
+TEST(fixed_converts_between_formats) {
+  q12 a = q12::from_raw(-4097);
+  CHECK(q16(a).raw() == -4097 * 16);
+  CHECK(q8(a).raw() == -257); // truncated towards minus infinity
+  CHECK(q12(q16::from_raw(0x7fffffff)).raw() == 0x7ffffff);
+  // narrowing saturates into a saturating format
+  CHECK(q15(q12(5)).raw() == 32767);
+  CHECK(q15(q12(-5)).raw() == -32768);
+}
+
+TEST(mul_keeps_mixed_precision) {
+  // a 1.15 gain applied to a 20.12 sample
+  q12 sample = q12::from_raw(-1234567);
+  q15 gain = 0.5_q15;
+  CHECK(mul<q12>(sample, gain).raw() == -617284);
+  CHECK(mul<q16>(0.5_q8, 0.5_q8).raw() == 16384);
+}
@@ -0,0 +1,193 @@
+//-----------------------------------------------------------------------------
+// custard/upload.hpp
+//-----------------------------------------------------------------------------
+// The queue copies through the DMA channel simulated by custard/host.hpp.
+// Frames are simulated by running the scan line counter: producers enqueue
+// during the visible lines, and the queue is drained at line 192, as the
+// vertical blank handler would, so every transfer can be checked to have
+// happened inside vertical blanking.
+//-----------------------------------------------------------------------------
+
+#include <custard/upload.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+typedef vram::upload_queue<8> queue;
+
+alignas(4) static uint8_t source[0x2000];
+
+static void fill_source() {
+  for (int i = 0; i < 0x2000; ++i) source[i] = uint8_t(i * 7 + i / 256);
+}
+
+// Do \p n bytes of BG VRAM from \p offset hold the source from \p from?
+static bool copied(uint32_t offset, uint32_t from, uint32_t n) {
+  for (uint32_t i = 0; i < n; ++i)
+    if (host::bg[offset + i] != source[from + i]) return false;
+  return true;
+}
+
+static bool untouched(uint32_t offset, uint32_t n) {
+  for (uint32_t i = 0; i < n; ++i)
+    if (host::bg[offset + i]) return false;
+  return true;
+}
+
+// The vertical blank handler of one frame; producers run on visible lines
+static void frame(queue& q) {
+  uint32_t before = host::dma[3].transfers;
+  REG_VCOUNT = 192;
+  q.vblank();
+  CHECK(host::dma[3].transfers == before || host::dma[3].vcount == 192);
+  REG_VCOUNT = 100;
+}
+
+static volatile uint16_t* bg(uint32_t offset) { return BG_GFX + offset / 2; }
+
+TEST(upload_copies_only_in_vblank) {
+  fill_source();
+  queue q;
+  REG_VCOUNT = 100;
+  queue::ticket t = q.enqueue(source, bg(0x1000), 0x400);
+  CHECK(t && !q.done(t) && q.pending() == 1);
+  CHECK(host::dma[3].transfers == 0 && untouched(0x1000, 0x400));
+  frame(q);
+  CHECK(q.done(t) && q.pending() == 0 && q.frame() == 1);
+  CHECK(copied(0x1000, 0, 0x400) && untouched(0x1400, 4));
+  // One 32-bit transfer, on the channel given
+  CHECK(host::dma[3].transfers == 1 && host::dma[3].words);
+  CHECK(host::dma[3].units == 0x100);
+  CHECK(q.last().bytes == 0x400 && q.last().jobs == 1);
+
+  queue other(0x8000, 1);
+  other.enqueue(source, bg(0), 8);
+  other.vblank();
+  CHECK(host::dma[1].transfers == 1 && host::dma[3].transfers == 1);
+}
+
+TEST(upload_splits_jobs_over_the_budget) {
+  fill_source();
+  queue q(0x400);
+  queue::ticket t = q.enqueue(source, bg(0), 0xa00);
+  const uint32_t sent[] = {0x400, 0x400, 0x200};
+  for (int f = 0; f < 3; ++f) {
+    frame(q);
+    CHECK(q.last().bytes == sent[f]);
+    CHECK(q.last().deferred == (f < 2));
+    CHECK(host::dma[3].transfers == uint32_t(f + 1));
+    CHECK(q.done(t) == (f == 2));
+  }
+  CHECK(copied(0, 0, 0xa00) && untouched(0xa00, 4));
+  CHECK(q.total().bytes == 0xa00 && q.total().jobs == 1);
+  CHECK(q.total().deferred == 2 && q.total().overrun == 0);
+
+  // A split keeps the rest of the job word aligned
+  q.set_budget(0x206);
+  q.enqueue(source, bg(0x4000), 0x400);
+  frame(q);
+  CHECK(q.last().bytes == 0x204 && host::dma[3].words);
+  frame(q);
+  CHECK(copied(0x4000, 0, 0x400) && host::dma[3].words);
+}
+
+TEST(upload_merges_contiguous_writes) {
+  fill_source();
+  queue q;
+  queue::ticket t = q.enqueue(source, bg(0), 64);
+  for (int i = 1; i < 8; ++i)
+    CHECK(q.enqueue(source + 64 * i, bg(64 * i), 64) == t);
+  CHECK(q.pending() == 1);
+  // Not contiguous in VRAM, of another priority, or with a callback
+  CHECK(q.enqueue(source + 512, bg(0x1000), 64) != t);
+  CHECK(q.enqueue(source + 512, bg(512), 64, 1) != t);
+  q.enqueue(source + 576, bg(576), 64, 1, queue::never,
+            [](void*) {}, nullptr);
+  CHECK(q.pending() == 4);
+  frame(q);
+  CHECK(q.last().jobs == 4 && host::dma[3].transfers == 4);
+  CHECK(copied(0, 0, 640));
+  CHECK(q.last().bytes == 0x2c0);
+}
+
+TEST(upload_rejects_odd_jobs) {
+  fill_source();
+  queue q;
+  auto odd = reinterpret_cast<volatile uint8_t*>(bg(0)) + 1;
+  // These were cut short by a halfword and still reported done
+  CHECK(!q.enqueue(source, bg(0), 0x41) && !q.enqueue(source, bg(0), 0));
+  CHECK(!q.enqueue(source + 1, bg(0), 0x40) && !q.enqueue(source, odd, 2));
+  CHECK(q.pending() == 0);
+  CHECK(q.enqueue(source + 2, bg(0), 0x42) && q.pending() == 1);
+}
+
+TEST(upload_orders_by_deadline_then_priority) {
+  fill_source();
+  queue q(0x100);
+  queue::ticket low = q.enqueue(source, bg(0), 0x100, 0);
+  queue::ticket high = q.enqueue(source, bg(0x100), 0x100, 5);
+  queue::ticket due = q.enqueue(source, bg(0x200), 0x200, 0, 0);
+  queue::ticket later = q.enqueue(source, bg(0x400), 0x100, 0, 2);
+  frame(q);
+  // The due job is copied in full, beyond the budget
+  CHECK(q.done(due) && !q.done(high) && !q.done(low));
+  CHECK(q.last().bytes == 0x200 && q.last().overrun == 0x100);
+  frame(q);
+  CHECK(q.done(high) && !q.done(low) && !q.done(later));
+  frame(q);
+  CHECK(q.done(later) && !q.done(low)); // due at frame 2
+  frame(q);
+  CHECK(q.done(low) && q.pending() == 0);
+  CHECK(q.total().overrun == 0x100);
+}
+
+TEST(upload_calls_back_and_cancels) {
+  fill_source();
+  queue q(0x100);
+  int calls = 0;
+  auto count = [](void* user) { ++*static_cast<int*>(user); };
+  queue::ticket a = q.enqueue(source, bg(0), 0x200, 0, queue::never,
+                              count, &calls);
+  queue::ticket b = q.enqueue(source, bg(0x800), 0x80, 0, queue::never,
+                              count, &calls);
+  frame(q);
+  CHECK(calls == 0);
+  q.cancel(b);
+  CHECK(q.done(b));
+  frame(q);
+  CHECK(calls == 1 && q.done(a));
+  frame(q);
+  CHECK(calls == 1 && untouched(0x800, 0x80));
+
+  // A ticket stays done once its slot is reused
+  queue::ticket c = q.enqueue(source, bg(0), 2);
+  CHECK(((c - 1) & 0xff) == ((a - 1) & 0xff) && c != a);
+  CHECK(q.done(a) && !q.done(c));
+  q.cancel(a);
+  CHECK(!q.done(c));
+}
+
+TEST(upload_uses_16_bit_transfers_when_unaligned) {
+  fill_source();
+  queue q;
+  q.enqueue(source + 2, bg(0x100), 8);
+  frame(q);
+  CHECK(!host::dma[3].words && host::dma[3].units == 4);
+  q.enqueue(source, bg(0x200), 6);
+  frame(q);
+  CHECK(!host::dma[3].words && host::dma[3].units == 3);
+  CHECK(copied(0x100, 2, 8) && copied(0x200, 0, 6));
+}
+
+TEST(upload_rejects_when_full) {
+  queue q;
+  CHECK(q.enqueue(source, bg(0), 0) == 0 && q.done(0));
+  for (int i = 0; i < 8; ++i)
+    CHECK(q.enqueue(source, bg(0x100 * i), 4, i) != 0);
+  CHECK(q.enqueue(source, bg(0x1000), 4) == 0);
+  // ...but still merges into a pending job
+  CHECK(q.enqueue(source + 4, bg(0x704), 4, 7) != 0);
+  frame(q);
+  CHECK(q.pending() == 0 && q.last().jobs == 8);
+}
@@ -0,0 +1,99 @@
+//-----------------------------------------------------------------------------
+// custard/vram.hpp
+//-----------------------------------------------------------------------------
+
+#include <custard/vram.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+using vram::bank;
+using vram::region;
+
+typedef vram::plan<
+  vram::map<bank::A, region::main_bg, 0>,
+  vram::map<bank::B, region::main_bg, 1>,
+  vram::map<bank::C, region::sub_bg>,
+  vram::map<bank::D, region::sub_sprite>,
+  vram::map<bank::E, region::main_sprite>,
+  vram::map<bank::H, region::sub_bg_ext_palette>,
+  vram::map<bank::I, region::sub_sprite_ext_palette>> game;
+
+typedef vram::plan<
+  vram::map<bank::A, region::main_bg, 0>,
+  vram::map<bank::B, region::main_bg, 1>,
+  vram::map<bank::C, region::sub_bg>,
+  vram::map<bank::D, region::lcdc>,
+  vram::map<bank::F, region::main_bg_ext_palette, 0>,
+  vram::map<bank::G, region::main_bg_ext_palette, 1>> menu;
+
+static_assert(game::abcd == 0x84848981);
+static_assert(game::ef == 0x0082);
+static_assert(game::g == 0);
+static_assert(game::hi == 0x8382);
+static_assert(game::extent(region::main_bg) == 0x40000);
+static_assert(game::maps(bank::E, region::main_sprite));
+static_assert(!game::maps(bank::E, region::main_bg));
+static_assert(vram::map<bank::G, region::main_sprite, 3>::cr == 0x9a);
+
+// The register values written by the mapping functions
+static void legacy_game() {
+  vram::none();
+  vram::main::bg::AB_256();
+  vram::sub::bg::C_128();
+  vram::sub::sprite::D_128();
+  vram::main::sprite::E_64();
+  vram::sub::bg::ext_palette::H();
+  vram::sub::sprite::ext_palette::I();
+}
+
+TEST(vram_plan_matches_mapping_functions) {
+  legacy_game();
+  uint32_t abcd = VRAM_CR;
+  uint8_t e = VRAM_E_CR, f = VRAM_F_CR, g = VRAM_G_CR, h = VRAM_H_CR,
+          i = VRAM_I_CR;
+  host::reset();
+  game::apply();
+  CHECK(VRAM_CR == abcd);
+  CHECK(VRAM_E_CR == e && VRAM_F_CR == f && VRAM_G_CR == g);
+  CHECK(VRAM_H_CR == h && VRAM_I_CR == i);
+}
+
+TEST(vram_plan_apply_disables_unmentioned_banks) {
+  VRAM_CR = 0xffffffff;
+  VRAM_E_CR = VRAM_F_CR = VRAM_G_CR = VRAM_H_CR = VRAM_I_CR = 0xff;
+  game::apply();
+  CHECK(VRAM_F_CR == 0 && VRAM_G_CR == 0);
+  // WRAM_CR, between banks G and H, is left alone
+  CHECK(*host::at<uint8_t>(0x04000247) == 0);
+  *host::at<uint8_t>(0x04000247) = 3;
+  game::apply();
+  CHECK(*host::at<uint8_t>(0x04000247) == 3);
+}
+
+TEST(vram_transition_writes_only_changes) {
+  game::apply();
+  // mark the registers the transition should not touch
+  VRAM_H_CR = 0x55;
+  vram::transition<game, menu>();
+  CHECK(VRAM_CR == menu::abcd);
+  CHECK(VRAM_E_CR == 0 && VRAM_F_CR == 0x84 && VRAM_G_CR == 0x8c);
+  CHECK(VRAM_H_CR == 0 && VRAM_I_CR == 0);
+
+  VRAM_CR = 0x12345678;
+  vram::transition<menu, menu>();
+  CHECK(VRAM_CR == 0x12345678);
+
+  typedef vram::plan<
+    vram::map<bank::A, region::main_bg, 0>,
+    vram::map<bank::B, region::main_bg, 1>,
+    vram::map<bank::C, region::sub_bg>,
+    vram::map<bank::D, region::lcdc>,
+    vram::map<bank::F, region::main_bg_ext_palette, 0>,
+    vram::map<bank::G, region::main_bg_ext_palette, 1>,
+    vram::map<bank::H, region::sub_bg_ext_palette>> menu_h;
+  VRAM_E_CR = 0x66;
+  vram::transition<menu, menu_h>();
+  CHECK(VRAM_CR == 0x12345678 && VRAM_E_CR == 0x66);
+  CHECK(VRAM_H_CR == 0x82);
+}
@@ -0,0 +1,111 @@
+//-----------------------------------------------------------------------------
+// custard/vram_alloc.hpp
+//-----------------------------------------------------------------------------
+
+#include <custard/vram_alloc.hpp>
+
+#include "test.hpp"
+
+using namespace custard;
+
+TEST(vram_alloc_first_fit_and_alignment) {
+  vram::block_allocator<96> a;
+  CHECK(a.alloc(3) == 0);
+  CHECK(a.alloc(4, 4) == 4);
+  CHECK(a.alloc(1) == 3);
+  CHECK(a.alloc(8, 8) == 8);
+  CHECK(a.alloc(40, 1, 20) == 20);   // spans a bitmap word boundary
+  CHECK(a.alloc(8, 8, 0, 96, true) == 88);
+  CHECK(a.alloc(100) == a.none);
+  CHECK(a.alloc(0) == a.none);
+  CHECK(a.alloc(4, 1, 60, 64) == 60);
+  CHECK(a.alloc(1, 1, 60, 64) == a.none);
+}
+
+TEST(vram_alloc_reuses_freed_blocks) {
+  vram::block_allocator<64> a;
+  int p = a.alloc(4), q = a.alloc(4);
+  a.alloc(4);
+  CHECK(a.release(p));
+  CHECK(a.alloc(4) == p);
+  CHECK(a.release(q));
+  CHECK(a.alloc(8) == 12);           // the gap at 4 is too short
+  CHECK(a.alloc(4) == 4);
+}
+
+TEST(vram_alloc_reference_counts) {
+  vram::block_allocator<64> a;
+  int p = a.alloc(4);
+  a.retain(p);
+  CHECK(a.references(p) == 2);
+  CHECK(!a.release(p));
+  CHECK(a.release(p));
+  CHECK(!a.release(p));              // already free
+  CHECK(a.references(p) == 0);
+  CHECK(a.report().used == 0);
+}
+
+TEST(vram_alloc_retain_checks_run_start) {
+  vram::block_allocator<64> a;
+  int p = a.alloc(4);
+  a.retain(p + 1);                   // inside the run
+  a.retain(10);                      // free block
+  a.retain(-1);
+  a.retain(64);
+  CHECK(a.references(p) == 1);
+  CHECK(a.references(p + 1) == 0 && a.references(10) == 0);
+  CHECK(!a.release(p + 1));
+  CHECK(a.alloc(1) == 4);            // the run is intact
+  CHECK(a.release(p));
+}
+
+TEST(vram_alloc_reference_count_saturates) {
+  vram::block_allocator<64> a;
+  int p = a.alloc(4);
+  for (int i = 0; i < 300; ++i) a.retain(p);
+  CHECK(a.references(p) == 255);
+  for (int i = 0; i < 300; ++i) CHECK(!a.release(p));
+  CHECK(a.references(p) == 255);     // pinned until reset
+  a.reset();
+  CHECK(a.references(p) == 0);
+  CHECK(a.alloc(64) == 0);
+}
+
+TEST(vram_alloc_report_fragmentation) {
+  vram::block_allocator<64> a(32);
+  int p = a.alloc(8), q = a.alloc(8);
+  a.alloc(8);
+  a.release(q);
+  auto s = a.report();
+  CHECK(s.used == 16 && s.free == 16);
+  CHECK(s.allocations == 2);
+  CHECK(s.free_runs == 2 && s.largest_free == 8);
+  CHECK(s.fragmentation() == 50);
+  a.release(p);
+  CHECK(a.report().largest_free == 16);
+}
+
+TEST(vram_alloc_bg_windows) {
+  vram::bg_allocator<> bg(0x40000);
+  CHECK(bg.screen(4) == 0);
+  CHECK(bg.screen() == 4);
+  CHECK(bg.chars(0x8000) == 14);     // char blocks come from the top
+  CHECK(bg.chars(0x4001) == 12);     // 16K + 1 overlaps the next base
+  CHECK(bg.chars(0x40000) == bg.none);
+  bg.retain_chars(14);
+  CHECK(!bg.release_chars(14));
+  CHECK(bg.release_chars(14));
+  CHECK(bg.chars(0x4000) == 15);
+  CHECK(bg.release_screen(4));
+}
+
+TEST(vram_alloc_sprite_units) {
+  vram::sprite_allocator<> obj(2, 0x20000); // 128 byte units
+  CHECK(obj.unit() == 128);
+  CHECK(obj.tiles(64 * 64 / 2) == 0);       // 16 units
+  CHECK(obj.tiles(1) == 16);
+  CHECK(obj.offset(16) == 2048);
+  CHECK(obj.report().free == 1024 - 17);
+  CHECK(obj.release(16));
+  CHECK(obj.report().used == 16);
+}
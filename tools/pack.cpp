@@ -0,0 +1,66 @@
+//-----------------------------------------------------------------------------
+// Custard asset packer
+//-----------------------------------------------------------------------------
+// Compresses a file into the chunked blob format described in
+// include/custard/pack.hpp. Built for the host by the rules in custard.mk:
+//
+//   pack [-c chunk] input output
+//
+// Each chunk is compressed with LZ77 and RLE and the smaller result is kept
+// (or the chunk is stored). The output is decoded again and compared with the
+// input before it is written, so a blob that is written always round-trips.
+//-----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "pack.hpp"
+
+using namespace custard;
+
+typedef pack::bytes bytes;
+
+int main(int argc, char** argv) {
+  size_t chunk = 4096;
+  int a = 1;
+  if (argc > 2 && !strcmp(argv[1], "-c")) { chunk = atoi(argv[2]); a = 3; }
+  if (argc - a != 2 || !chunk || chunk % 4 || chunk > 65536) {
+    fprintf(stderr, "usage: %s [-c chunk] input output\n", argv[0]);
+    return 2;
+  }
+
+  std::ifstream f(argv[a], std::ios::binary);
+  if (!f) {
+    fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[a]);
+    return 1;
+  }
+  bytes in((std::istreambuf_iterator<char>(f)),
+           std::istreambuf_iterator<char>());
+  in.resize((in.size() + 3) & ~size_t(3)); // VRAM is written in words
+
+  bytes out = pack::encode(in, chunk);
+
+  // Round trip through the runtime decoder
+  static pack::decoder<65536> d;
+  std::vector<uint32_t> check(in.size() / 4 + 1);
+  std::vector<uint32_t> blob((out.size() + 3) / 4);
+  memcpy(blob.data(), out.data(), out.size());
+  if (!d.open(blob.data(), check.data()) || !d.run(in.size()) || d.failed()
+      || memcmp(check.data(), in.data(), in.size())) {
+    fprintf(stderr, "%s: %s does not round-trip\n", argv[0], argv[a]);
+    return 1;
+  }
+
+  std::ofstream o(argv[a + 1], std::ios::binary);
+  o.write(reinterpret_cast<const char*>(out.data()), out.size());
+  if (!o) {
+    fprintf(stderr, "%s: cannot write %s\n", argv[0], argv[a + 1]);
+    return 1;
+  }
+  printf("%s: %zu -> %zu bytes (%zu chunks)\n", argv[a], in.size(),
+         out.size(), (in.size() + chunk - 1) / chunk);
+  return 0;
+}
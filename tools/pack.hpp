@@ -0,0 +1,141 @@
+//-----------------------------------------------------------------------------
+// Custard asset packer: encoder
+//-----------------------------------------------------------------------------
+// The compressors behind tools/pack.cpp, in a header so that the host tests
+// and benchmarks can round-trip data through them. See
+// include/custard/pack.hpp for the format.
+//-----------------------------------------------------------------------------
+
+#ifndef CUSTARD_TOOLS_PACK_HPP
+#define CUSTARD_TOOLS_PACK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <custard/pack.hpp>
+
+namespace custard {
+  namespace pack {
+
+    typedef std::vector<uint8_t> bytes;
+
+    /// RLE payload for \p n bytes
+    inline bytes encode_rle(const uint8_t* in, size_t n) {
+      bytes out;
+      size_t i = 0, lit = 0; // start of pending literals
+      auto flush = [&](size_t end) {
+        while (lit < end) {
+          size_t k = end - lit < 128 ? end - lit : 128;
+          out.push_back(uint8_t(k - 1));
+          out.insert(out.end(), in + lit, in + lit + k);
+          lit += k;
+        }
+      };
+      while (i < n) {
+        size_t run = 1;
+        while (i + run < n && run < 130 && in[i + run] == in[i]) ++run;
+        if (run >= 3) {
+          flush(i);
+          out.push_back(uint8_t(0x80 | (run - 3)));
+          out.push_back(in[i]);
+          i += run;
+          lit = i;
+        }
+        else i += run;
+      }
+      flush(n);
+      return out;
+    }
+
+    /// LZ77 payload for \p n bytes
+    inline bytes encode_lz77(const uint8_t* in, size_t n) {
+      // Hash chains over 3-byte prefixes, searched up to a fixed depth
+      const int depth = 256;
+      std::vector<int> head(1 << 12, -1), prev(n, -1);
+      auto hash = [&](size_t i) {
+        return (in[i] << 4 ^ in[i + 1] << 2 ^ in[i + 2]) & 0xfff;
+      };
+      bytes out;
+      size_t flags = 0;
+      int bit = 8;
+      for (size_t i = 0; i < n; ) {
+        if (bit == 8) { flags = out.size(); out.push_back(0); bit = 0; }
+        size_t best = 0, dist = 0;
+        if (i + 3 <= n) {
+          int c = head[hash(i)];
+          for (int d = 0; c >= 0 && i - c <= 4096 && d < depth;
+               ++d, c = prev[c]) {
+            size_t k = 0;
+            while (k < 18 && i + k < n && in[c + k] == in[i + k]) ++k;
+            if (k > best) { best = k; dist = i - c; }
+          }
+        }
+        size_t step = best >= 3 ? best : 1;
+        if (best >= 3) {
+          out[flags] |= 0x80 >> bit;
+          unsigned t = unsigned(best - 3) << 12 | unsigned(dist - 1);
+          out.push_back(uint8_t(t >> 8));
+          out.push_back(uint8_t(t));
+        }
+        else out.push_back(in[i]);
+        ++bit;
+        for (size_t end = i + step; i < end; ++i) {
+          if (i + 3 > n) continue;
+          int h = hash(i);
+          prev[i] = head[h];
+          head[h] = int(i);
+        }
+      }
+      return out;
+    }
+
+    /// \brief Method byte and payload for a chunk of \p n bytes, using the
+    /// smallest of LZ77, RLE and storing
+    inline bytes encode_chunk(const uint8_t* in, size_t n) {
+      bytes best(1, stored);
+      best.insert(best.end(), in, in + n);
+      bytes r = encode_rle(in, n), l = encode_lz77(in, n);
+      if (r.size() + 1 < best.size()) {
+        best.assign(1, rle);
+        best.insert(best.end(), r.begin(), r.end());
+      }
+      if (l.size() + 1 < best.size()) {
+        best.assign(1, lz77);
+        best.insert(best.end(), l.begin(), l.end());
+      }
+      return best;
+    }
+
+    /// Append a little-endian word
+    inline void put32(bytes& out, uint32_t v) {
+      for (int i = 0; i < 32; i += 8) out.push_back(uint8_t(v >> i));
+    }
+
+    /// \brief Compress \p in, whose size is a multiple of 4, into a blob of
+    /// chunks of \p chunk bytes
+    inline bytes encode(const bytes& in, size_t chunk) {
+      uint32_t count = uint32_t((in.size() + chunk - 1) / chunk);
+      bytes data;
+      std::vector<uint32_t> offsets;
+      for (size_t i = 0; i < in.size(); i += chunk) {
+        offsets.push_back(uint32_t(data.size()));
+        size_t n = in.size() - i < chunk ? in.size() - i : chunk;
+        bytes c = encode_chunk(&in[i], n);
+        data.insert(data.end(), c.begin(), c.end());
+      }
+      offsets.push_back(uint32_t(data.size()));
+
+      bytes out;
+      put32(out, magic);
+      put32(out, uint32_t(in.size()));
+      put32(out, uint32_t(chunk));
+      put32(out, count);
+      for (uint32_t o : offsets) put32(out, o);
+      out.insert(out.end(), data.begin(), data.end());
+      return out;
+    }
+  }
+}
+
+#endif